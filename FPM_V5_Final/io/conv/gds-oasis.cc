@@ -1361,7 +1361,8 @@ GdsToOasisConverter::GdsToOasisConverter (const char* outfilename,
                                           WarningHandler warner,
                                           const GdsToOasisOptions& options)
   : GdsBuilder(),
-    creator(outfilename, OasisCreatorOptions(options.immediateNames)),
+    creator(outfilename, OasisCreatorOptions(options.immediateNames,
+                                             options.compressThreads)),
     warnHandler(warner),
     placementPos(0, 0),
     textPos(0, 0),
@@ -3217,7 +3218,7 @@ ConvertGdsToOasis (const char* infilename, const char* outfilename,
 {
     GdsToOasisConverter  converter(outfilename, warner, options);
     GdsParser  parser(infilename, options.gdsFileType, warner);
-    parser.parseFile(&converter);
+    parser.parseFile(&converter, options.parseThreads);
 }
 
 
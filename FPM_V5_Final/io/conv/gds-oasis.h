@@ -81,6 +81,14 @@ using Oasis::Validation;
 //      Optimization level.  How much effort to expend to make the
 //      OASIS file small.  Values currently distinguished: 0, 1, >1.
 //      0 is only for testing.
+//
+// compressThreads      Uint
+//      Number of threads to compress cblocks in.  0 means compress
+//      them in the converting thread.  Has no effect on the output.
+//
+// parseThreads         Uint
+//      Number of threads to parse the GDSII structures in.  0 means
+//      parse them in the converting thread.  See GdsParser::parseFile().
 
 
 struct GdsToOasisOptions {
@@ -94,6 +102,8 @@ struct GdsToOasisOptions {
     bool        transformTexts;
     bool        verbose;
     Uint        optLevel;
+    Uint        compressThreads;
+    Uint        parseThreads;
 };
 
 
@@ -12,6 +12,7 @@
 // equivalent to oasis-file.  See the usage message below for the options.
 
 #include <cctype>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <exception>
@@ -27,7 +28,8 @@ using namespace GdsiiOasis;
 namespace {
 
 const char  UsageMessage[] =
-"usage:  %s [-c none|crc|checksum] [-O opt] [-Dnprtvz] infile outfile\n"
+"usage:  %s [-c none|crc|checksum] [-j threads] [-J threads] [-O opt]\n"
+"            [-Dnprtvz] infile outfile\n"
 "Options:\n"
 "    -c none|crc|checksum\n"
 "        The validation scheme to use for the OASIS file.\n"
@@ -36,6 +38,15 @@ const char  UsageMessage[] =
 "    -D  Preserve duplicate elements.  Normally duplicates are deleted\n"
 "        because they are redundant.\n"
 "\n"
+"    -j threads\n"
+"        With -z, compress the cells in this many threads in addition\n"
+"        to the one converting.  The output is the same; only the time\n"
+"        changes.  The default is 0.\n"
+"\n"
+"    -J threads\n"
+"        Parse the GDSII structures in this many threads in addition\n"
+"        to the one converting.  The default is 0.\n"
+"\n"
 "    -n  Write each name record before it is referenced.\n"
 "        The default is to collect all the name records in strict-mode\n"
 "        name tables at the end of the file.  That is normally preferred,\n"
@@ -121,6 +132,20 @@ ParseOptLevel (const char* arg, /*out*/ Uint* pOptLevel)
 }
 
 
+bool
+ParseThreadCount (const char* arg, /*out*/ Uint* pThreads)
+{
+    char*  end;
+    errno = 0;
+    unsigned long  n = strtoul(arg, &end, 10);
+    if (!isdigit(static_cast<Uchar>(*arg))  ||  *end != Cnul
+            ||  errno != 0  ||  n > 256)
+        return false;
+    *pThreads = n;
+    return true;
+}
+
+
 } // unnamed namespace
 
 
@@ -142,12 +167,14 @@ main (int argc, char* argv[])
     options.transformTexts  = false;
     options.verbose         = false;
     options.optLevel        = 1;
+    options.compressThreads = 0;
+    options.parseThreads    = 0;
 
     // Parse the command line.
 
     int  opt;
     opterr = 0;
-    while ((opt = getopt(argc, argv, "c:DnO:prtvz")) != EOF) {
+    while ((opt = getopt(argc, argv, "c:Dj:J:nO:prtvz")) != EOF) {
         switch (opt) {
             case 'c':
                 if (! ParseValidationScheme(optarg, &options.valScheme)) {
@@ -158,6 +185,18 @@ main (int argc, char* argv[])
             case 'D':
                 options.deleteDuplicates = false;
                 break;
+            case 'j':
+                if (! ParseThreadCount(optarg, &options.compressThreads)) {
+                    Error("invalid thread count '%s'", optarg);
+                    UsageError();
+                }
+                break;
+            case 'J':
+                if (! ParseThreadCount(optarg, &options.parseThreads)) {
+                    Error("invalid thread count '%s'", optarg);
+                    UsageError();
+                }
+                break;
             case 'n':
                 options.immediateNames = true;
                 break;
@@ -92,6 +92,7 @@ GdsToAsciiConverter::convertFile()
 {
     GdsRecord   rec;
 
+    scanner.adviseSequential(true);
     writer.beginFile();
     do {
         scanner.getNextRecord(&rec);
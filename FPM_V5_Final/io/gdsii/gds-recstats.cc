@@ -106,6 +106,7 @@ AnalyzeFile (const char* fname)
     CodeTimer   timer;
     GdsRecord   rec;
     GdsScanner  scanner(fname, FileHandle::FileTypeAuto);
+    scanner.adviseSequential(true);
 
     do {
         scanner.getNextRecord(&rec);
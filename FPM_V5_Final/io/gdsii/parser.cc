@@ -10,10 +10,15 @@
 #include <cstdarg>
 #include <cstdio>
 #include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <pthread.h>
 
 #include "misc/utils.h"
 #include "glimits.h"
 #include "parser.h"
+#include "struct-buffer.h"
 
 
 namespace Gdsii {
@@ -60,6 +65,7 @@ GdsGraphBuilder::GdsGraphBuilder() { }
 GdsParser::GdsParser (const char* fname, FileHandle::FileType ftype,
                       WarningHandler warner)
   : scanner(fname, ftype),
+    fileType(ftype),
     warnHandler(warner),
     strPool(65536),
     locator(fname)
@@ -219,13 +225,34 @@ GdsParser::copyStringFromRecord (/*inout*/ GdsRecord& rec)
 // parseFile -- parse file sequentially from beginning to end.
 //   builder    its methods are invoked each time a
 //              structure/element/property etc. is parsed
+//   numThreads if > 0, parse the structures in this many worker threads
 // See the GdsBuilder class comments in builder.h for the order in which
 // the builder's callbacks are invoked.
+//
+// With worker threads the parser first scans the file for the offsets
+// of all the structures.  The workers then parse the structures, each
+// into a GdsStructureBuffer, while this thread replays the buffers to
+// the builder in file order.  The builder and warnHandler are invoked
+// only in this thread, with the same calls as in a sequential parse,
+// so they need not be thread-safe.  The only difference is that
+// errors found by the first scan, e.g., a record with an invalid
+// length, are reported before the builder is called at all.
+//
+// The input must be seekable for a parallel parse.  Each worker opens
+// the file for itself, so a gzipped file is decompressed by every
+// worker; FileHandle's index of the file keeps that from costing much
+// more than decompressing it once.
 
 void
-GdsParser::parseFile (GdsBuilder* builder)
+GdsParser::parseFile (GdsBuilder* builder, Uint numThreads)
 {
     this->builder = builder;
+    scanner.adviseSequential(true);
+
+    vector<off_t>  strOffsets;
+    off_t       endOffset = 0;
+    if (numThreads > 0)
+        endOffset = findStructures(&strOffsets);
 
     // Return to the beginning of the file and discard strings
     // accumulated in the previous parse, if any.  Note that we leave
@@ -250,18 +277,23 @@ GdsParser::parseFile (GdsBuilder* builder)
     // <structure> begins with BGNSTR and ends with ENDSTR.
 
     parseLibraryHeader();               // eats everything up to UNITS
-    for (;;) {
-        readNextRecord(&rec);
-        if (rec.getRecordType() == GRT_ENDLIB)
-            break;
-        verifyRecordType(GRT_BGNSTR, rec);
-        parseStructure(rec);            // eats everything up to ENDSTR
+    if (numThreads > 0)
+        parseStructuresInThreads(strOffsets, numThreads);
+    else {
+        for (;;) {
+            readNextRecord(&rec);
+            if (rec.getRecordType() == GRT_ENDLIB)
+                break;
+            verifyRecordType(GRT_BGNSTR, rec);
+            parseStructure(rec);        // eats everything up to ENDSTR
+        }
+        endOffset = scanner.currByteOffset();
     }
 
-    // Ignore everything after ENDLIB.  The current offset, which is the
-    // logical file size, is the locator's offset for endLibrary().
+    // Ignore everything after ENDLIB.  The offset following it, which
+    // is the logical file size, is the locator's offset for endLibrary().
 
-    locator.setOffset(scanner.currByteOffset());
+    locator.setOffset(endOffset);
     builder->endLibrary();
 
     // Whether or not the index was built before we began the parse,
@@ -293,6 +325,7 @@ GdsParser::parseStructure (const char* sname, GdsBuilder* builder)
     off_t  offset = structIndex.getOffset(sname);
     if (offset < 0)
         return false;
+    scanner.adviseSequential(false);
     scanner.seekTo(offset);
 
     GdsRecord  rec;
@@ -322,6 +355,7 @@ GdsParser::makeIndex()
     // BGNSTR's offset in the index.
 
     GdsRecord   rec;
+    scanner.adviseSequential(true);
     scanner.seekTo(0);
 
     for (;;) {
@@ -364,6 +398,7 @@ GdsParser::buildStructureGraph (GdsGraphBuilder* gbuilder)
     // Look for LIBNAME before the main loop to ensure that
     // beginLibrary() is called first.
 
+    scanner.adviseSequential(true);
     scanner.seekTo(0);
     do {
         readNextRecord(&rec);
@@ -1342,6 +1377,382 @@ GdsParser::parseMaskRecord (/*in*/ GdsRecord& rec)
 
 
 
+//----------------------------------------------------------------------
+// Parsing structures in worker threads
+
+
+const Uint  StructuresPerThread = 4;
+    // How far the workers of a parallel parse may run ahead of the
+    // replay, in structures per worker.  It bounds the memory held by
+    // the GdsStructureBuffers that are waiting to be replayed.
+
+
+
+// StructureParsePool -- parse the structures of a file in worker threads
+// Each worker has its own GdsParser for the file and takes structures
+// in file order.  It parses each into a new GdsStructureBuffer that it
+// stores in the structure's slot.  The parser's own thread waits for
+// the slots in order with wait(), replays the buffers, and hands them
+// back with release().  A worker does not take structure j until
+// structure j - StructuresPerThread*numThreads has been released.
+//
+// Exceptions must not escape a thread, so the message of any
+// exception thrown while parsing a structure, or while creating the
+// worker's parser, is stored in the slot.  The buffer in the slot then
+// has the calls made before the error, so that replaying it and
+// throwing the message looks to the builder like a sequential parse
+// failing at the same place.
+//
+// The constructor throws runtime_error if it cannot create the threads.
+// The destructor stops the workers after the structures they are
+// parsing and deletes the buffers not yet released.
+
+class StructureParsePool {
+    struct Slot {
+        GdsStructureBuffer*  buffer;    // Null until the worker is done
+        string      error;              // empty if the parse succeeded
+        bool        done;               // guarded by mutex
+        Slot() : buffer(Null), done(false) { }
+    };
+
+    // WarningCollector -- a worker's WarningHandler target
+    // It saves each warning in the buffer being filled, to be given to
+    // the application's WarningHandler when the buffer is replayed.
+
+    struct WarningCollector {
+        GdsStructureBuffer*  buffer;
+        void        addWarning (const char* msg) { buffer->addWarning(msg); }
+    };
+
+    string              filename;
+    FileHandle::FileType  fileType;
+    bool                wantWarnings;   // the application has a warnHandler
+    const vector<off_t>&  offsets;      // BGNSTR offsets of the structures
+    vector<Slot>        slots;          // one for each structure
+    size_t              window;         // StructuresPerThread * numThreads
+    vector<pthread_t>   workers;
+    pthread_mutex_t     mutex;          // guards the variables below
+    pthread_cond_t      slotFree;       // signalled by release()
+    pthread_cond_t      slotDone;       // signalled by workers
+    size_t              nextToParse;    // index of next structure to take
+    size_t              parseLimit;     // workers may not take this or later
+    bool                stopping;       // true => workers should exit
+
+public:
+                StructureParsePool (const char* fname,
+                                    FileHandle::FileType ftype,
+                                    bool wantWarnings,
+                                    const vector<off_t>& offsets,
+                                    Uint numThreads);
+                ~StructureParsePool();
+    GdsStructureBuffer*  wait (size_t j, /*out*/ string* error);
+    void        release (size_t j);
+
+private:
+    static void*  runWorker (void* arg);
+    void        workerLoop();
+    void        stopWorkers();
+
+                StructureParsePool (const StructureParsePool&);  // forbidden
+    void        operator= (const StructureParsePool&);           // forbidden
+};
+
+
+
+// constructor
+//   fname          pathname of the input file
+//   ftype          type of the input file
+//   wantWarnings   if false, the workers' parsers ignore minor errors
+//   offsets        offsets of the BGNSTR records of all the structures,
+//                  in file order.  The vector must outlive the pool.
+//   numThreads     number of worker threads.  Must be > 0.
+
+StructureParsePool::StructureParsePool (const char* fname,
+                                        FileHandle::FileType ftype,
+                                        bool wantWarnings,
+                                        const vector<off_t>& offsets,
+                                        Uint numThreads)
+  : filename(fname),
+    fileType(ftype),
+    wantWarnings(wantWarnings),
+    offsets(offsets),
+    slots(offsets.size())
+{
+    assert (numThreads > 0);
+
+    window = StructuresPerThread * numThreads;
+    nextToParse = 0;
+    parseLimit = window;
+    stopping = false;
+    pthread_mutex_init(&mutex, Null);
+    pthread_cond_init(&slotFree, Null);
+    pthread_cond_init(&slotDone, Null);
+
+    // There is no point in starting more workers than structures.
+    // If a thread cannot be created, stop the ones already running
+    // before throwing; the destructor will not be called.
+
+    size_t  numWorkers = min(static_cast<size_t>(numThreads), slots.size());
+    for (size_t j = 0;  j < numWorkers;  ++j) {
+        pthread_t  tid;
+        int  err = pthread_create(&tid, Null, runWorker, this);
+        if (err != 0) {
+            stopWorkers();
+            ThrowRuntimeError("cannot create parser thread: %s",
+                              strerror(err));
+        }
+        workers.push_back(tid);
+    }
+}
+
+
+
+StructureParsePool::~StructureParsePool()
+{
+    stopWorkers();
+    for (size_t j = 0;  j < slots.size();  ++j)
+        delete slots[j].buffer;
+}
+
+
+
+// stopWorkers -- make the workers exit, join them, and destroy the
+// synchronization objects
+
+void
+StructureParsePool::stopWorkers()
+{
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_cond_broadcast(&slotFree);
+    pthread_mutex_unlock(&mutex);
+
+    for (size_t j = 0;  j < workers.size();  ++j)
+        pthread_join(workers[j], Null);
+    workers.clear();
+
+    pthread_cond_destroy(&slotDone);
+    pthread_cond_destroy(&slotFree);
+    pthread_mutex_destroy(&mutex);
+}
+
+
+
+// wait -- block until structure j has been parsed
+//   j          index of the structure in offsets
+//   error      out: empty, or the message of the error that stopped
+//              the parse of the structure
+// Returns the buffer holding the calls for the structure.  It is Null
+// only if the error happened before the buffer could be created.
+// The pool still owns the buffer.
+
+GdsStructureBuffer*
+StructureParsePool::wait (size_t j, /*out*/ string* error)
+{
+    assert (j < slots.size());
+
+    pthread_mutex_lock(&mutex);
+    while (! slots[j].done)
+        pthread_cond_wait(&slotDone, &mutex);
+    pthread_mutex_unlock(&mutex);
+
+    error->swap(slots[j].error);
+    return slots[j].buffer;
+}
+
+
+
+// release -- delete the buffer for structure j and let the workers
+// go one structure further
+
+void
+StructureParsePool::release (size_t j)
+{
+    delete slots[j].buffer;
+    slots[j].buffer = Null;
+
+    pthread_mutex_lock(&mutex);
+    parseLimit = j + 1 + window;
+    pthread_cond_broadcast(&slotFree);
+    pthread_mutex_unlock(&mutex);
+}
+
+
+
+/*static*/ void*
+StructureParsePool::runWorker (void* arg)
+{
+    static_cast<StructureParsePool*>(arg)->workerLoop();
+    return Null;
+}
+
+
+
+// workerLoop -- parse structures until none are left or the pool is
+// destroyed
+
+void
+StructureParsePool::workerLoop()
+{
+    // The worker's parser does not build its own structure index.
+    // The parser that owns the pool has built a complete one.
+
+    WarningCollector  collector;
+    WarningHandler    warner;
+    if (wantWarnings)
+        warner = std::bind1st(std::mem_fun(&WarningCollector::addWarning),
+                              &collector);
+
+    auto_ptr<GdsParser>  parser;
+    string      initError;
+    try {
+        parser.reset(new GdsParser(filename.c_str(), fileType, warner));
+        parser->structIndex.setDone();
+    } catch (const std::exception& exc) {
+        initError = exc.what();
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&mutex);
+        while (! stopping  &&  nextToParse < slots.size()
+                 &&  nextToParse >= parseLimit)
+            pthread_cond_wait(&slotFree, &mutex);
+        if (stopping  ||  nextToParse == slots.size()) {
+            pthread_mutex_unlock(&mutex);
+            return;
+        }
+        size_t  j = nextToParse++;
+        pthread_mutex_unlock(&mutex);
+
+        GdsStructureBuffer*  buffer = Null;
+        string  error;
+        if (parser.get() == Null)
+            error = initError;
+        else {
+            try {
+                buffer = new GdsStructureBuffer;
+                collector.buffer = buffer;
+                parser->parseStructureAt(offsets[j], buffer);
+            } catch (const std::exception& exc) {
+                error = exc.what();
+            }
+        }
+
+        pthread_mutex_lock(&mutex);
+        slots[j].buffer = buffer;
+        slots[j].error.swap(error);
+        slots[j].done = true;
+        pthread_cond_broadcast(&slotDone);
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+
+
+// findStructures -- first pass of a parallel parse
+//   offsets    out: the offsets of the BGNSTR records of all the
+//              structures, in file order
+// Returns the offset following the ENDLIB record.  Like makeIndex(),
+// this only looks at the record types; the structures are checked when
+// they are parsed.  It builds the structure index if that has not been
+// done yet.
+
+off_t
+GdsParser::findStructures (/*out*/ vector<off_t>* offsets)
+{
+    GdsRecord   rec;
+    scanner.seekTo(0);
+    offsets->clear();
+
+    for (;;) {
+        readNextRecord(&rec);
+        switch (rec.getRecordType()) {
+            case GRT_BGNSTR: {
+                off_t  offset = rec.getOffset();
+                offsets->push_back(offset);
+                readNextRecord(GRT_STRNAME, &rec);
+                const char*  sname = parseStrnameRecord(rec);
+                registerStructure(rec, sname, offset);
+                strPool.clear();
+                break;
+            }
+            case GRT_ENDLIB:
+                goto END_LOOP;
+
+            default:            // avoid complaints about unused enumerators
+                break;
+        }
+    }
+  END_LOOP:
+
+    structIndex.setDone();
+    return scanner.currByteOffset();
+}
+
+
+
+// parseStructuresInThreads -- parse all the structures with worker threads
+//   offsets    the offsets of the BGNSTR records, from findStructures()
+//   numThreads number of worker threads
+// Precondition:
+//   The last record read was UNITS, the end of the library header.
+//
+// In a sequential parse each structure must be followed by BGNSTR or
+// ENDLIB.  The workers check that after the structures they parse;
+// this checks it for the library header.
+
+void
+GdsParser::parseStructuresInThreads (const vector<off_t>& offsets,
+                                     Uint numThreads)
+{
+    StructureParsePool  pool(locator.getFileName(), fileType,
+                             warnHandler != Null, offsets, numThreads);
+    GdsRecord  rec;
+    readNextRecord(&rec);
+    if (rec.getRecordType() != GRT_ENDLIB)
+        verifyRecordType(GRT_BGNSTR, rec);
+
+    for (size_t j = 0;  j < offsets.size();  ++j) {
+        string  error;
+        GdsStructureBuffer*  buffer = pool.wait(j, &error);
+        if (buffer != Null)
+            buffer->replay(builder, &locator, warnHandler);
+        pool.release(j);
+        if (! error.empty())
+            throw runtime_error(error);
+    }
+}
+
+
+
+// parseStructureAt -- parse the structure whose BGNSTR is at offset
+//   offset     file offset of the structure's BGNSTR record
+//   builder    builder to invoke for the structure; it is given the
+//              locator first
+// This is what a worker of a parallel parse does with each structure.
+// After the structure it reads the next record to check that it is
+// BGNSTR or ENDLIB, as the loop in parseFile() does.
+
+void
+GdsParser::parseStructureAt (off_t offset, GdsBuilder* builder)
+{
+    this->builder = builder;
+    builder->setLocator(&locator);
+    scanner.adviseSequential(false);
+    scanner.seekTo(offset);
+
+    GdsRecord  rec;
+    readNextRecord(GRT_BGNSTR, &rec);
+    parseStructure(rec);
+    strPool.clear();
+
+    readNextRecord(&rec);
+    if (rec.getRecordType() != GRT_ENDLIB)
+        verifyRecordType(GRT_BGNSTR, rec);
+}
+
+
+
 //----------------------------------------------------------------------
 // Handling errors
 
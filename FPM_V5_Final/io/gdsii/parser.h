@@ -74,6 +74,7 @@
 #include <new>
 #include <cstdarg>
 #include <string>
+#include <vector>
 #include <sys/types.h>          // for off_t
 
 #include "misc/stringpool.h"
@@ -86,6 +87,7 @@
 namespace Gdsii {
 
 using std::bad_alloc;
+using std::vector;
 
 using SoftJin::Ulong;
 using SoftJin::FileHandle;
@@ -165,6 +167,12 @@ property, etc.
 All methods apart from the destructor may throw runtime_error
 or bad_alloc.
 
+fileType        FileHandle::FileType
+
+        Type of the input file as given to the constructor.  Needed
+        to open the file again in the worker threads of a parallel
+        parse.
+
 warnHandler     WarningHandler
 
         Handler for minor errors discovered in the input file.
@@ -218,7 +226,10 @@ locator         GdsLocator
 
 
 class GdsParser {
+    friend class StructureParsePool;
+
     GdsScanner          scanner;
+    FileHandle::FileType  fileType;
     GdsBuilder*         builder;
     WarningHandler      warnHandler;
     FileIndex           structIndex;
@@ -232,7 +243,7 @@ public:
                            WarningHandler);
                 ~GdsParser();
 
-    void        parseFile (GdsBuilder*);
+    void        parseFile (GdsBuilder*, Uint numThreads = 0);
     bool        parseStructure (const char* sname, GdsBuilder*);
     FileIndex*  makeIndex();
     void        buildStructureGraph (GdsGraphBuilder* gbuilder);
@@ -249,6 +260,10 @@ private:
     const char* copyStringFromRecord (/*in*/ GdsRecord& rec);
 
     void        parseLibraryHeader();
+    off_t       findStructures (/*out*/ vector<off_t>* offsets);
+    void        parseStructuresInThreads (const vector<off_t>& offsets,
+                                          Uint numThreads);
+    void        parseStructureAt (off_t offset, GdsBuilder* builder);
     void        parseStructure (/*in*/ GdsRecord& bgnstrRecord);
     void        parseBoundary();
     void        parsePath();
@@ -13,6 +13,8 @@
 #include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <boost/static_assert.hpp>
 
@@ -32,23 +34,68 @@ using namespace SoftJin;
 //   ftype      type of file: normal or compressed
 
 GdsScanner::GdsScanner (const char* fname, FileHandle::FileType ftype)
-  : rbuf(BufferSize),
-    fh(fname, ftype),
+  : fh(fname, ftype),
     filename(fname)
 {
-    fh.open(FileHandle::ReadAccess);
     fileOffset = 0;
+    mapBase = Null;
+    mapSize = 0;
+    mapSequential = false;
+    if (! fh.isGzipped()  &&  mapFile())
+        return;
+
+    rbuf.create(BufferSize);
+    fh.open(FileHandle::ReadAccess);
+    dataStart = curr = dataEnd = rbuf.buffer;
 }
 
 
 
 GdsScanner::~GdsScanner()
 {
+    if (mapBase != Null)
+        munmap(mapBase, mapSize);
     fh.close();
 }
 
 
 
+// mapFile -- try to map the whole input file into memory
+// Returns false if the file is not a non-empty regular file or cannot be
+// mapped, e.g. because it is too big for the address space.  The
+// caller then reads it into rbuf instead.  Throws runtime_error if the
+// file cannot be opened.
+
+bool
+GdsScanner::mapFile()
+{
+    int  fd = OpenFile(filename.c_str(), O_RDONLY);
+    struct stat  st;
+    void*   addr = MAP_FAILED;
+    size_t  len = 0;
+
+    // The second test on the size catches files too big for size_t.
+    if (fstat(fd, &st) == 0  &&  S_ISREG(st.st_mode)  &&  st.st_size > 0) {
+        len = st.st_size;
+        if (static_cast<off_t>(len) == st.st_size)
+            addr = mmap(Null, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);                  // the mapping stays valid
+    if (addr == MAP_FAILED)
+        return false;
+
+    // The mapping gets no advice until the parser says how it is going
+    // to read the file.  See adviseSequential().
+
+    mapBase = static_cast<Uchar*>(addr);
+    mapSize = len;
+    dataStart = curr = mapBase;
+    dataEnd = mapBase + mapSize;
+    return true;
+}
+
+
+
 // getNextRecord -- read the next record from the file.
 // rec->body will be valid only until the next call to this function().
 // Throws runtime_error
@@ -68,16 +115,16 @@ GdsScanner::getNextRecord (/*out*/ GdsRecord* rec)
     // 2-byte length field.  Ensure we have at least the header of the
     // next record in the buffer.
 
-    if (rbuf.availData() < HeaderLength) {
+    if (availData() < HeaderLength) {
         fillBuffer();
-        if (rbuf.availData() < HeaderLength)
+        if (availData() < HeaderLength)
             abortScanner("unexpected EOF");
     }
 
     // Get the length of the record (including the header) and check it.
     // GdsRecord::initialize() ensures that the length is even.
 
-    recLength = (rbuf.curr[0] << 8) + rbuf.curr[1];
+    recLength = (curr[0] << 8) + curr[1];
     if (recLength < HeaderLength) {
         abortScanner("invalid record length %u; must be at least %u",
                      recLength, HeaderLength);
@@ -86,52 +133,59 @@ GdsScanner::getNextRecord (/*out*/ GdsRecord* rec)
     // Now that we know the record's length, ensure that the complete
     // record is in the buffer.
 
-    if (rbuf.availData() < recLength) {
+    if (availData() < recLength) {
         fillBuffer();
-        if (rbuf.availData() < recLength)
+        if (availData() < recLength)
             abortScanner("unexpected EOF");
     }
 
     // Initialize the record's fields.  Ignore the data-type field
     // because the record type determines that.  Note that for speed
     // initRecord() does not copy the record body; it just stores a
-    // pointer into our buffer.  That is why we ensure above that the
-    // complete record is in the buffer.  That is also why we do our own
-    // buffering instead of using stdio.
+    // pointer into our buffer or into the mapped file.  That is why we
+    // ensure above that the complete record is in the buffer.  That is
+    // also why we do our own buffering instead of using stdio.
 
-    Uint  recType = rbuf.curr[2];
+    Uint  recType = curr[2];
     Uint  bodyLength = recLength - HeaderLength;
-    Uchar*  body = rbuf.curr + HeaderLength;
+    const Uchar*  body = curr + HeaderLength;
     initRecord(rec, recType, bodyLength, body, currByteOffset());
 
-    rbuf.curr += recLength;
+    curr += recLength;
 }
 
 
 
 // seekTo -- restart scanning at specified file offset.
 // The argument must be the offset at which a record begins.
-// Note that seeking to the middle of a compressed file is slow.
+// Seeking to the middle of a compressed file costs up to about a
+// megabyte of decompression once FileHandle has indexed the file,
+// and a lot more before that.
 
 void
 GdsScanner::seekTo (off_t offset)
 {
     // If the offset specified is already in the buffer, just adjust
-    // rbuf.curr.  Otherwise seek so that we begin reading at offset and
-    // discard the buffer contents.
+    // curr.  Otherwise seek so that we begin reading at offset and
+    // discard the buffer contents.  A mapped file is always entirely
+    // in the buffer.
     //
     // Note that the second half of the test uses <=, not <.  GdsParser
     // calls seekTo(0) at the start of the parse, when the buffer is
-    // empty (i.e., rbuf.end == rbuf.buffer).  We want that call to have no
+    // empty (i.e., dataEnd == dataStart).  We want that call to have no
     // effect so that it will work even if the input is a pipe.
 
     if (offset >= fileOffset
-            &&  offset <= fileOffset + (rbuf.end - rbuf.buffer))
-        rbuf.curr = rbuf.buffer + (offset - fileOffset);
+            &&  offset <= fileOffset + (dataEnd - dataStart))
+        curr = dataStart + (offset - fileOffset);
+    else if (mapBase != Null)
+        abortScanner("cannot seek to offset %lld: file has only %lu bytes",
+                     static_cast<long long>(offset),
+                     static_cast<Ulong>(mapSize));
     else {
         if (fh.seek(offset, SEEK_SET) != offset)
             abortScanner("file seek failed: %s", strerror(errno));
-        rbuf.refill(0);
+        curr = dataEnd = rbuf.buffer;
         fileOffset = offset;
         // Don't worry about keeping future reads block-aligned.
         // It doesn't seem to slow down the reads.
@@ -139,11 +193,32 @@ GdsScanner::seekTo (off_t offset)
 }
 
 
+// adviseSequential -- say how the file is going to be read
+//   sequential true if the next scan goes through the whole file from
+//              beginning to end, false if it jumps to a structure and
+//              reads only that
+//
+// Only a mapped file cares.  A whole-file scan gets MADV_SEQUENTIAL,
+// which reads far ahead and lets the pages behind go soon.  Anything
+// else gets MADV_NORMAL, not MADV_RANDOM: each structure is read from
+// beginning to end, and the normal readahead helps with big ones.
+
+void
+GdsScanner::adviseSequential (bool sequential)
+{
+    if (mapBase == Null  ||  sequential == mapSequential)
+        return;
+    madvise(mapBase, mapSize, sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+    mapSequential = sequential;
+}
+
+
 //----------------------------------------------------------------------
 // Private methods
 
 
 // fillBuffer -- fill the buffer with data from the file.
+// Does nothing if the file is mapped, since all of it is already there.
 // Throws an exception if a read error occurs.
 // Precondition:
 //     The buffer contains less than MaxRecordLength bytes.
@@ -153,13 +228,16 @@ GdsScanner::fillBuffer()
 {
     BOOST_STATIC_ASSERT (BufferSize >= 1*GLimits::MaxRecordLength);
                                 // The 1* prevents a warning from gcc.
-    assert (rbuf.availData() < GLimits::MaxRecordLength);
+    assert (availData() < GLimits::MaxRecordLength);
+
+    if (mapBase != Null)
+        return;
 
     // Move the remaining bytes in the buffer to the left end.
 
-    size_t  nbytes = rbuf.availData();          // we still have this much
-    memmove(rbuf.buffer, rbuf.curr, nbytes);
-    fileOffset += rbuf.curr - rbuf.buffer;      // new starting offset
+    size_t  nbytes = availData();               // we still have this much
+    memmove(rbuf.buffer, curr, nbytes);
+    fileOffset += curr - rbuf.buffer;           // new starting offset
 
     // Fill the remainder of the buffer.  On a Pentium4 running Linux
     // 2.4.20 there seems to be no advantage in making the read size a
@@ -168,7 +246,8 @@ GdsScanner::fillBuffer()
     ssize_t  nr = fh.read(rbuf.buffer + nbytes, BufferSize - nbytes);
     if (nr < 0)
         abortScanner("read failed: %s", strerror(errno));
-    rbuf.refill(nbytes + nr);
+    curr = rbuf.buffer;
+    dataEnd = rbuf.buffer + nbytes + nr;
 }
 
 
@@ -179,7 +258,8 @@ GdsScanner::fillBuffer()
 //   length     length of record body (length from file minus header length)
 //   body       pointer to record body.  Not NUL-terminated.  The space
 //              is owned by GdsScanner and may be overwritten on the
-//              next call to getNextRecord().
+//              next call to getNextRecord().  If the file is mapped,
+//              it is read-only.
 //   fileOffset  offset in file where record begins
 //
 // initRecord() checks the values to be stored into the record and
@@ -187,7 +267,7 @@ GdsScanner::fillBuffer()
 
 void
 GdsScanner::initRecord (/*out*/ GdsRecord* rec, Uint recType,
-                        Uint length, Uchar* body, off_t fileOffset)
+                        Uint length, const Uchar* body, off_t fileOffset)
 {
     // Don't accept any record type that the GDSII spec says is unused.
     if (! GdsRecordTypeInfo::recTypeIsValid(recType))
@@ -53,11 +53,22 @@ class GdsRecord;
 // uncompressed file.  It is not the actual file offset, which is
 // undefined.
 //
+// An uncompressed regular file is mapped into memory instead of being
+// read into rbuf.  The GdsRecords then point straight into the mapped
+// file, and nothing is copied.  Gzipped files, pipes, and files that
+// cannot be mapped are read into rbuf as before.  adviseSequential()
+// tells the kernel whether the mapping is about to be read from
+// beginning to end or in pieces, so that it can choose how far to read
+// ahead.
+//
 // Any of the methods may throw runtime_error.  The constructor may also
 // throw bad_alloc.
 //
-// Class invariant:
-//     !rbuf.empty() => fileOffset is the file offset of rbuf.buffer
+// Class invariants:
+//     fileOffset is the file offset of dataStart
+//     dataStart <= curr <= dataEnd
+//     mapBase != Null  =>  dataStart == mapBase && fileOffset == 0
+//     mapBase == Null  =>  dataStart == rbuf.buffer
 
 class GdsScanner {
     enum {
@@ -65,8 +76,14 @@ class GdsScanner {
             // Size of scan buffer.  Must be >= GLimits::MaxRecordLength.
     };
 
-    ReadBuffer<Uchar>  rbuf;    // input buffer
-    off_t       fileOffset;     // offset in file of rbuf.buffer
+    ReadBuffer<Uchar>  rbuf;    // input buffer if the file is not mapped
+    Uchar*      mapBase;        // Null or the whole file, mapped read-only
+    size_t      mapSize;        // size of the mapping
+    Uchar*      dataStart;      // rbuf.buffer or mapBase
+    Uchar*      curr;           // next byte to scan
+    Uchar*      dataEnd;        // one past the last byte available
+    bool        mapSequential;  // mapping was last advised MADV_SEQUENTIAL
+    off_t       fileOffset;     // offset in file of dataStart
     FileHandle  fh;             // for reading from input file
     std::string filename;       // pathname of input file
 
@@ -77,11 +94,15 @@ public:
     void        getNextRecord (/*out*/ GdsRecord* rec);
     void        seekTo (off_t offset);
     off_t       currByteOffset() const;
+    void        adviseSequential (bool sequential);
 
 private:
+    bool        mapFile();
+    size_t      availData() const;
     void        fillBuffer();
     void        initRecord (/*out*/ GdsRecord* rec, Uint recType,
-                            Uint length, Uchar* body, off_t fileOffset);
+                            Uint length, const Uchar* body,
+                            off_t fileOffset);
     void        abortScanner (const char* fmt, ...)
                                          SJ_PRINTF_ARGS(2,3)  SJ_NORETURN;
                 GdsScanner (const GdsScanner&);         // forbidden
@@ -96,7 +117,13 @@ private:
 
 inline off_t
 GdsScanner::currByteOffset() const {
-    return (fileOffset + (rbuf.curr - rbuf.buffer));
+    return (fileOffset + (curr - dataStart));
+}
+
+
+/*private*/ inline size_t
+GdsScanner::availData() const {
+    return (dataEnd - curr);
 }
 
 
@@ -111,15 +138,16 @@ GdsScanner::currByteOffset() const {
 // GdsScanner::getNextRecord() returns this in an output parameter.  Use
 // the nextXxx() methods of this class to extract the data items from
 // the record.  The data is available only until the next call to
-// getNextRecord().
+// getNextRecord().  The body is read-only; if the file is mapped it
+// is the file itself.
 
 class GdsRecord {
     friend class GdsScanner;
 
     const GdsRecordTypeInfo*  typeInfo; // info about this record's type
     int         length;         // length of record body (excludes header)
-    Uchar*      body;           // pointer to body of record
-    Uchar*      bp;             // start of next data item to return
+    const Uchar*  body;         // pointer to body of record
+    const Uchar*  bp;           // start of next data item to return
     off_t       fileOffset;     // file offset of record's first header byte
 
 public:
@@ -278,7 +306,7 @@ inline const char*
 GdsRecord::nextString()
 {
     assert (getDataType() == GDATA_STRING);
-    char*  val = reinterpret_cast<char*>(bp);
+    const char*  val = reinterpret_cast<const char*>(bp);
 
     // If itemSize == 0 then the record contains a single variable-length
     // string.  It is the caller's responsibility to ensure that this
@@ -0,0 +1,376 @@
+// gdsii/struct-buffer.cc -- record the builder calls for a structure
+//
+// Not part of the SoftJin distribution.  Added to this copy of the
+// library and may be used under the same terms as the rest of it.
+// See the accompanying file LICENSE for details.
+
+#include <cassert>
+#include "struct-buffer.h"
+
+
+namespace Gdsii {
+
+using namespace std;
+using namespace SoftJin;
+
+
+GdsStructureBuffer::GdsStructureBuffer() {
+    locator = Null;
+}
+
+
+/*virtual*/
+GdsStructureBuffer::~GdsStructureBuffer() { }
+
+
+
+// clear -- forget all the recorded calls
+// The locator stays.  The vectors keep their space for the next
+// structure.
+
+void
+GdsStructureBuffer::clear()
+{
+    calls.clear();
+    chars.clear();
+    points.clear();
+    dates.clear();
+    structOptions.clear();
+    elemOptions.clear();
+    pathOptions.clear();
+    textOptions.clear();
+    transforms.clear();
+}
+
+
+
+// addWarning -- save a warning message to be given to replay()'s warner
+// The warning is replayed between the builder calls that surround it.
+
+void
+GdsStructureBuffer::addWarning (const char* msg)
+{
+    Call&  call = addCall(CallWarning);
+    call.str = saveString(msg);
+}
+
+
+
+// getString -- the string argument of a call
+
+inline const char*
+GdsStructureBuffer::getString (const Call& call) const {
+    return (chars.data() + call.str);
+}
+
+
+
+// replay -- invoke the saved calls on another builder
+//   builder        the builder to invoke
+//   replayLocator  the locator that builder was given.  Its offset and
+//                  structure name are set before each call as the
+//                  recording parser set its own.
+//   warner         if non-Null, invoked with each saved warning
+//
+// The buffer is not cleared.  Exceptions thrown by the builder or
+// the warner propagate to the caller.
+
+void
+GdsStructureBuffer::replay (GdsBuilder* builder, GdsLocator* replayLocator,
+                            WarningHandler warner)
+{
+    for (size_t j = 0;  j < calls.size();  ++j) {
+        const Call&  call = calls[j];
+        replayLocator->setOffset(call.offset);
+
+        switch (call.type) {
+            case CallBeginStructure:
+                replayLocator->setStructureName(getString(call));
+                builder->beginStructure(getString(call),
+                                        dates[call.options*2],
+                                        dates[call.options*2 + 1],
+                                        structOptions[call.options]);
+                break;
+
+            case CallEndStructure:
+                builder->endStructure();
+                replayLocator->setStructureName(Null);
+                break;
+
+            case CallBeginBoundary:
+                builder->beginBoundary(call.args[0], call.args[1],
+                                       getPoints(call),
+                                       elemOptions[call.options]);
+                break;
+
+            case CallBeginPath:
+                builder->beginPath(call.args[0], call.args[1],
+                                   getPoints(call), pathOptions[call.options]);
+                break;
+
+            case CallBeginSref:
+                builder->beginSref(getString(call),
+                                   call.args[0], call.args[1],
+                                   transforms[call.strans],
+                                   elemOptions[call.options]);
+                break;
+
+            case CallBeginAref:
+                builder->beginAref(getString(call),
+                                   static_cast<Uint>(call.args[0]),
+                                   static_cast<Uint>(call.args[1]),
+                                   getPoints(call),
+                                   transforms[call.strans],
+                                   elemOptions[call.options]);
+                break;
+
+            case CallBeginNode:
+                builder->beginNode(call.args[0], call.args[1],
+                                   getPoints(call), elemOptions[call.options]);
+                break;
+
+            case CallBeginBox:
+                builder->beginBox(call.args[0], call.args[1],
+                                  getPoints(call), elemOptions[call.options]);
+                break;
+
+            case CallBeginText:
+                builder->beginText(call.args[0], call.args[1],
+                                   call.args[2], call.args[3],
+                                   getString(call),
+                                   transforms[call.strans],
+                                   textOptions[call.options]);
+                break;
+
+            case CallAddProperty:
+                builder->addProperty(call.args[0], getString(call));
+                break;
+
+            case CallEndElement:
+                builder->endElement();
+                break;
+
+            case CallWarning:
+                if (warner != Null)
+                    warner(getString(call));
+                break;
+        }
+    }
+}
+
+
+
+/*virtual*/ void
+GdsStructureBuffer::setLocator (const GdsLocator* locator) {
+    this->locator = locator;
+}
+
+
+/*virtual*/ void
+GdsStructureBuffer::beginStructure (const char* structureName,
+                                    const GdsDate& createTime,
+                                    const GdsDate& modTime,
+                                    const GdsStructureOptions& options)
+{
+    Call&  call = addCall(CallBeginStructure);
+    call.str = saveString(structureName);
+    call.options = structOptions.size();
+    structOptions.push_back(options);
+    dates.push_back(createTime);
+    dates.push_back(modTime);
+}
+
+
+/*virtual*/ void
+GdsStructureBuffer::endStructure() {
+    addCall(CallEndStructure);
+}
+
+
+/*virtual*/ void
+GdsStructureBuffer::beginBoundary (int layer, int datatype,
+                                   const GdsPointList& points,
+                                   const GdsElementOptions& options)
+{
+    Call&  call = addCall(CallBeginBoundary);
+    call.args[0] = layer;
+    call.args[1] = datatype;
+    savePoints(&call, points);
+    call.options = elemOptions.size();
+    elemOptions.push_back(options);
+}
+
+
+/*virtual*/ void
+GdsStructureBuffer::beginPath (int layer, int datatype,
+                               const GdsPointList& points,
+                               const GdsPathOptions& options)
+{
+    Call&  call = addCall(CallBeginPath);
+    call.args[0] = layer;
+    call.args[1] = datatype;
+    savePoints(&call, points);
+    call.options = pathOptions.size();
+    pathOptions.push_back(options);
+}
+
+
+/*virtual*/ void
+GdsStructureBuffer::beginSref (const char* sname,
+                               int x, int y,
+                               const GdsTransform& strans,
+                               const GdsElementOptions& options)
+{
+    Call&  call = addCall(CallBeginSref);
+    call.str = saveString(sname);
+    call.args[0] = x;
+    call.args[1] = y;
+    call.strans = transforms.size();
+    transforms.push_back(strans);
+    call.options = elemOptions.size();
+    elemOptions.push_back(options);
+}
+
+
+/*virtual*/ void
+GdsStructureBuffer::beginAref (const char* sname,
+                               Uint numCols, Uint numRows,
+                               const GdsPointList& points,
+                               const GdsTransform& strans,
+                               const GdsElementOptions& options)
+{
+    Call&  call = addCall(CallBeginAref);
+    call.str = saveString(sname);
+    call.args[0] = numCols;
+    call.args[1] = numRows;
+    savePoints(&call, points);
+    call.strans = transforms.size();
+    transforms.push_back(strans);
+    call.options = elemOptions.size();
+    elemOptions.push_back(options);
+}
+
+
+/*virtual*/ void
+GdsStructureBuffer::beginNode (int layer, int nodetype,
+                               const GdsPointList& points,
+                               const GdsElementOptions& options)
+{
+    Call&  call = addCall(CallBeginNode);
+    call.args[0] = layer;
+    call.args[1] = nodetype;
+    savePoints(&call, points);
+    call.options = elemOptions.size();
+    elemOptions.push_back(options);
+}
+
+
+/*virtual*/ void
+GdsStructureBuffer::beginBox (int layer, int boxtype,
+                              const GdsPointList& points,
+                              const GdsElementOptions& options)
+{
+    Call&  call = addCall(CallBeginBox);
+    call.args[0] = layer;
+    call.args[1] = boxtype;
+    savePoints(&call, points);
+    call.options = elemOptions.size();
+    elemOptions.push_back(options);
+}
+
+
+/*virtual*/ void
+GdsStructureBuffer::beginText (int layer, int texttype,
+                               int x, int y,
+                               const char* text,
+                               const GdsTransform& strans,
+                               const GdsTextOptions& options)
+{
+    Call&  call = addCall(CallBeginText);
+    call.args[0] = layer;
+    call.args[1] = texttype;
+    call.args[2] = x;
+    call.args[3] = y;
+    call.str = saveString(text);
+    call.strans = transforms.size();
+    transforms.push_back(strans);
+    call.options = textOptions.size();
+    textOptions.push_back(options);
+}
+
+
+/*virtual*/ void
+GdsStructureBuffer::addProperty (int attr, const char* value)
+{
+    Call&  call = addCall(CallAddProperty);
+    call.args[0] = attr;
+    call.str = saveString(value);
+}
+
+
+/*virtual*/ void
+GdsStructureBuffer::endElement() {
+    addCall(CallEndElement);
+}
+
+
+
+//----------------------------------------------------------------------
+// Private methods
+
+
+// addCall -- append a Call of the given type at the locator's offset
+// The other members of the Call are left for the caller to fill in.
+
+GdsStructureBuffer::Call&
+GdsStructureBuffer::addCall (CallType type)
+{
+    assert (locator != Null  ||  type == CallWarning);
+
+    calls.push_back(Call());
+    Call&  call = calls.back();
+    call.type = type;
+    call.offset = (locator != Null ? locator->getOffset() : -1);
+    return call;
+}
+
+
+
+// saveString -- copy a NUL-terminated string into chars
+// Returns the index of the copy.
+
+Uint
+GdsStructureBuffer::saveString (const char* str)
+{
+    Uint  index = chars.size();
+    chars.append(str);
+    chars.push_back(Cnul);
+    return index;
+}
+
+
+
+// savePoints -- copy a point list into points and note where it went
+
+void
+GdsStructureBuffer::savePoints (/*inout*/ Call* call, const GdsPointList& pts)
+{
+    call->firstPoint = points.size();
+    call->numPoints = pts.size();
+    points.insert(points.end(), pts.begin(), pts.end());
+}
+
+
+
+// getPoints -- rebuild the point list of a call in pointList
+
+const GdsPointList&
+GdsStructureBuffer::getPoints (const Call& call)
+{
+    vector<GdsPoint>::const_iterator  first = points.begin() + call.firstPoint;
+    pointList.assign(first, first + call.numPoints);
+    return pointList;
+}
+
+
+}  // namespace Gdsii
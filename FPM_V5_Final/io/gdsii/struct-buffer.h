@@ -0,0 +1,160 @@
+// gdsii/struct-buffer.h -- record the builder calls for a structure
+//
+// Not part of the SoftJin distribution.  Added to this copy of the
+// library and may be used under the same terms as the rest of it.
+// See the accompanying file LICENSE for details.
+//
+// GdsStructureBuffer is a GdsBuilder that stores everything it is
+// given instead of acting on it.  replay() later invokes the same
+// methods of another builder with the same arguments and with the
+// locator positioned as it was for the original calls.
+//
+// GdsParser uses it to parse structures in worker threads.  Each
+// worker parses a structure into its own buffer, and the parser's
+// thread replays the buffers to the application's builder in file
+// order, so the builder sees exactly what a serial parse would show
+// it.  The warnings for the structure are saved in the buffer too,
+// because the application's WarningHandler need not be thread-safe.
+
+
+#ifndef GDSII_STRUCT_BUFFER_H_INCLUDED
+#define GDSII_STRUCT_BUFFER_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <sys/types.h>          // for off_t
+
+#include "misc/utils.h"
+#include "builder.h"
+
+
+namespace Gdsii {
+
+using std::string;
+using std::vector;
+using SoftJin::WarningHandler;
+
+
+// GdsStructureBuffer -- builder that records the calls for structures
+//
+// The calls are kept in the vector 'calls'.  Each Call holds the
+// scalar arguments and indexes into the vectors that hold the rest.
+// Strings are stored NUL-terminated, back to back, in 'chars'; the
+// points of all the XY records are stored back to back in 'points'.
+//
+// Only the structure-level methods are recorded.  A buffer must not be
+// given gdsVersion(), beginLibrary() or endLibrary(); they would be
+// dropped.  setLocator() is needed, because the buffer gets each
+// call's offset from the locator.
+//
+// All methods may throw bad_alloc.
+
+class GdsStructureBuffer : public GdsBuilder {
+    enum CallType {
+        CallBeginStructure,
+        CallEndStructure,
+        CallBeginBoundary,
+        CallBeginPath,
+        CallBeginSref,
+        CallBeginAref,
+        CallBeginNode,
+        CallBeginBox,
+        CallBeginText,
+        CallAddProperty,
+        CallEndElement,
+        CallWarning             // not a builder method; see addWarning()
+    };
+
+    struct Call {
+        CallType    type;
+        off_t       offset;     // locator's offset at the time of the call
+        int         args[4];    // the int and Uint arguments, in order
+        Uint        str;        // index in chars of name, text or value
+        Uint        firstPoint; // index in points of the first point
+        Uint        numPoints;
+        Uint        options;    // index in the vector for the call's options
+        Uint        strans;     // index in transforms
+    };
+
+    const GdsLocator*  locator;         // locator of the parser recording
+    vector<Call>       calls;
+    string             chars;
+    vector<GdsPoint>   points;
+    vector<GdsDate>    dates;           // two for each structure
+    vector<GdsStructureOptions>  structOptions;
+    vector<GdsElementOptions>    elemOptions;
+    vector<GdsPathOptions>       pathOptions;
+    vector<GdsTextOptions>       textOptions;
+    vector<GdsTransform>         transforms;
+    GdsPointList       pointList;       // scratch space for replay()
+
+public:
+                GdsStructureBuffer();
+    virtual     ~GdsStructureBuffer();
+
+    void        clear();
+    bool        empty() const { return calls.empty(); }
+    void        addWarning (const char* msg);
+    void        replay (GdsBuilder* builder, GdsLocator* replayLocator,
+                        WarningHandler warner);
+
+    virtual void  setLocator (const GdsLocator* locator);
+
+    virtual void  beginStructure (const char* structureName,
+                                  const GdsDate& createTime,
+                                  const GdsDate& modTime,
+                                  const GdsStructureOptions& options);
+    virtual void  endStructure();
+
+    virtual void  beginBoundary (int layer, int datatype,
+                                 const GdsPointList& points,
+                                 const GdsElementOptions& options);
+
+    virtual void  beginPath (int layer, int datatype,
+                             const GdsPointList& points,
+                             const GdsPathOptions& options);
+
+    virtual void  beginSref (const char* sname,
+                             int x, int y,
+                             const GdsTransform& strans,
+                             const GdsElementOptions& options);
+
+    virtual void  beginAref (const char* sname,
+                             Uint numCols, Uint numRows,
+                             const GdsPointList& points,
+                             const GdsTransform& strans,
+                             const GdsElementOptions& options);
+
+    virtual void  beginNode (int layer, int nodetype,
+                             const GdsPointList& points,
+                             const GdsElementOptions& options);
+
+    virtual void  beginBox (int layer, int boxtype,
+                            const GdsPointList& points,
+                            const GdsElementOptions& options);
+
+    virtual void  beginText (int layer, int texttype,
+                             int x, int y,
+                             const char* text,
+                             const GdsTransform& strans,
+                             const GdsTextOptions& options);
+
+    virtual void  addProperty (int attr, const char* value);
+
+    virtual void  endElement();
+
+private:
+    Call&       addCall (CallType type);
+    Uint        saveString (const char* str);
+    void        savePoints (/*inout*/ Call* call, const GdsPointList& pts);
+    const GdsPointList&  getPoints (const Call& call);
+    const char* getString (const Call& call) const;
+
+                GdsStructureBuffer (const GdsStructureBuffer&);  // forbidden
+    void        operator= (const GdsStructureBuffer&);           // forbidden
+};
+
+
+}  // namespace Gdsii
+
+#endif  // GDSII_STRUCT_BUFFER_H_INCLUDED
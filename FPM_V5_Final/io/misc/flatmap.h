@@ -0,0 +1,441 @@
+// misc/flatmap.h -- flat hash maps for pointer, string and integer keys
+//
+// Not part of the SoftJin distribution.  Added to this copy of the
+// library and may be used under the same terms as the rest of it.
+// See the accompanying file LICENSE for details.
+//
+// HashMap allocates a node for each entry and, with string keys, hashes
+// and compares string objects that live somewhere else in the free
+// store.  That is too slow and too big for tables with millions of
+// entries that are only ever added to, like the OASIS name tables.  The
+// class templates here store their entries in a single array instead.
+//
+// PointerMap<ValueT>   open addressing, keys are non-null pointers
+// StringMap<ValueT>    open addressing, the map copies its keys into
+//                      a StringPool
+// IndexMap<T>          pointers to T indexed by small integers, with a
+//                      HashMap for the integers too large to index
+//
+// None of them supports deletion, and none of them can be iterated.
+// Entries stay put only until the next insertion.
+
+
+#ifndef MISC_FLATMAP_H_INCLUDED
+#define MISC_FLATMAP_H_INCLUDED
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "port/hash-table.h"
+#include "globals.h"
+#include "stringpool.h"
+
+
+namespace SoftJin {
+
+using std::string;
+using std::vector;
+
+
+
+// Both open-addressing maps use linear probing in a table whose size is
+// a power of 2 and keep the table at most half full.  The table starts
+// with MinFlatMapSlots slots the first time something is inserted.
+
+const size_t  MinFlatMapSlots = 16;
+
+
+
+//======================================================================
+//                              PointerMap
+//======================================================================
+
+// PointerMap -- open-addressing map from non-null pointers to ValueT
+// A slot whose key is Null is empty.  ValueT must be default
+// constructible and copyable.
+
+template <typename ValueT>
+class PointerMap {
+    struct Slot {
+        const void*  key;
+        ValueT       value;
+        Slot() : key(Null), value() { }
+    };
+
+    vector<Slot>  slots;        // size is 0 or a power of 2
+    size_t        count;        // number of slots in use
+
+public:
+                PointerMap() : count(0) { }
+
+    ValueT*     find (const void* key);
+    const ValueT*  find (const void* key) const;
+    ValueT&     operator[] (const void* key);
+    size_t      size() const  { return count;      }
+    bool        empty() const { return count == 0; }
+
+private:
+    static size_t  hashKey (const void* key);
+    size_t      probe (const void* key) const;
+    void        grow();
+};
+
+
+
+// hashKey -- scramble the bits of a pointer
+// The low bits of a heap pointer are mostly zero and the high bits
+// mostly the same, so mix them before masking.
+
+template <typename ValueT>
+/*static*/ inline size_t
+PointerMap<ValueT>::hashKey (const void* key)
+{
+    size_t  h = reinterpret_cast<size_t>(key) >> 3;
+    h ^= h >> 15;
+    h *= 2654435761U;
+    h ^= h >> 13;
+    return h;
+}
+
+
+
+// probe -- index of the slot holding key, or of the empty slot for it
+// Precondition:
+//     slots is not empty
+
+template <typename ValueT>
+inline size_t
+PointerMap<ValueT>::probe (const void* key) const
+{
+    size_t  mask = slots.size() - 1;
+    size_t  j = hashKey(key) & mask;
+    while (slots[j].key != key  &&  slots[j].key != Null)
+        j = (j+1) & mask;
+    return j;
+}
+
+
+
+// find -- locate the value for key
+// Returns Null if the map has no entry for key.
+
+template <typename ValueT>
+inline ValueT*
+PointerMap<ValueT>::find (const void* key)
+{
+    if (count == 0)
+        return Null;
+    Slot&  slot = slots[probe(key)];
+    return (slot.key != Null ? &slot.value : Null);
+}
+
+
+template <typename ValueT>
+inline const ValueT*
+PointerMap<ValueT>::find (const void* key) const
+{
+    return const_cast<PointerMap*>(this)->find(key);
+}
+
+
+
+// operator[] -- locate the value for key, inserting a default one if needed
+
+template <typename ValueT>
+ValueT&
+PointerMap<ValueT>::operator[] (const void* key)
+{
+    assert (key != Null);
+    if (2*(count+1) > slots.size())
+        grow();
+    Slot&  slot = slots[probe(key)];
+    if (slot.key == Null) {
+        slot.key = key;
+        ++count;
+    }
+    return slot.value;
+}
+
+
+
+// grow -- double the table and reinsert everything
+
+template <typename ValueT>
+void
+PointerMap<ValueT>::grow()
+{
+    vector<Slot>  old(slots.empty() ? MinFlatMapSlots : 2*slots.size());
+    old.swap(slots);
+    for (size_t j = 0;  j < old.size();  ++j) {
+        if (old[j].key != Null)
+            slots[probe(old[j].key)] = old[j];
+    }
+}
+
+
+
+//======================================================================
+//                              StringMap
+//======================================================================
+
+// StringMap -- open-addressing map from strings to ValueT
+// The map copies each key into its own StringPool when the key is
+// inserted, so the caller's string need not outlive the entry.  Keys
+// may contain NULs.  Each slot caches the key's hash so that most
+// probes for a missing key are rejected without touching the key.
+// The length and hash are 32 bits wide to keep a slot at three words;
+// no OASIS name comes near 4 GB.
+// A slot whose key is Null is empty; an empty string still gets a
+// non-null key from the pool.
+
+template <typename ValueT>
+class StringMap {
+    struct Slot {
+        const char*  key;       // NUL-terminated copy in keyPool
+        Uint         len;       // length of key, not counting the NUL
+        Uint         hash;      // hashKey() of key
+        ValueT       value;
+        Slot() : key(Null), len(0), hash(0), value() { }
+    };
+
+    vector<Slot>  slots;        // size is 0 or a power of 2
+    size_t        count;        // number of slots in use
+    StringPool    keyPool;      // storage for the keys
+
+public:
+                StringMap() : count(0) { }
+
+    ValueT*     find (const char* str, size_t len);
+    ValueT*     find (const string& str) {
+                    return find(str.data(), str.size());
+                }
+    ValueT&     operator[] (const string& str);
+    size_t      size() const  { return count;      }
+    bool        empty() const { return count == 0; }
+
+private:
+    static Uint    hashKey (const char* str, size_t len);
+    size_t      probe (const char* str, size_t len, Uint hash) const;
+    void        grow();
+};
+
+
+
+// hashKey -- FNV-1a hash of a string
+// Unlike HashString() in utils.cc, this leaves the low bits well mixed,
+// which linear probing needs because it masks off the high bits.
+
+template <typename ValueT>
+/*static*/ inline Uint
+StringMap<ValueT>::hashKey (const char* str, size_t len)
+{
+    Uint  h = 2166136261U;
+    const char*  end = str + len;
+    for ( ;  str != end;  ++str)
+        h = (h ^ static_cast<unsigned char>(*str)) * 16777619U;
+    return h;
+}
+
+
+
+// probe -- index of the slot holding the key, or of the empty slot for it
+// Precondition:
+//     slots is not empty
+
+template <typename ValueT>
+inline size_t
+StringMap<ValueT>::probe (const char* str, size_t len, Uint hash) const
+{
+    size_t  mask = slots.size() - 1;
+    size_t  j = hash & mask;
+    for (;;) {
+        const Slot&  slot = slots[j];
+        if (slot.key == Null)
+            return j;
+        if (slot.hash == hash  &&  slot.len == len
+                &&  std::memcmp(slot.key, str, len) == 0)
+            return j;
+        j = (j+1) & mask;
+    }
+}
+
+
+
+// find -- locate the value for a key
+// Returns Null if the map has no entry for the key.
+
+template <typename ValueT>
+inline ValueT*
+StringMap<ValueT>::find (const char* str, size_t len)
+{
+    if (count == 0)
+        return Null;
+    Slot&  slot = slots[probe(str, len, hashKey(str, len))];
+    return (slot.key != Null ? &slot.value : Null);
+}
+
+
+
+// operator[] -- locate the value for a key, inserting a default one if needed
+
+template <typename ValueT>
+ValueT&
+StringMap<ValueT>::operator[] (const string& str)
+{
+    assert (str.size() == static_cast<Uint>(str.size()));
+    if (2*(count+1) > slots.size())
+        grow();
+    Uint  hash = hashKey(str.data(), str.size());
+    Slot&  slot = slots[probe(str.data(), str.size(), hash)];
+    if (slot.key == Null) {
+        slot.key = keyPool.newString(str.data(), str.size());
+        slot.len = str.size();
+        slot.hash = hash;
+        ++count;
+    }
+    return slot.value;
+}
+
+
+
+// grow -- double the table and reinsert everything
+// The keys stay where they are in keyPool; only the slots move.
+
+template <typename ValueT>
+void
+StringMap<ValueT>::grow()
+{
+    vector<Slot>  old(slots.empty() ? MinFlatMapSlots : 2*slots.size());
+    old.swap(slots);
+    size_t  mask = slots.size() - 1;
+    for (size_t j = 0;  j < old.size();  ++j) {
+        if (old[j].key == Null)
+            continue;
+        size_t  k = old[j].hash & mask;
+        while (slots[k].key != Null)
+            k = (k+1) & mask;
+        slots[k] = old[j];
+    }
+}
+
+
+
+//======================================================================
+//                              IndexMap
+//======================================================================
+
+// IndexMap -- map from unsigned integers to T*
+// Reference-numbers in OASIS files are usually 0, 1, 2, ... in some
+// order, so IndexMap keeps a vector indexed by the integer as long as
+// that vector would be at least half full, counting the entries it
+// would hold.  Integers too large for the vector go into a HashMap.
+// When the vector grows, entries of the HashMap that now fit are moved
+// into the vector.  A Null value means that there is no entry.
+//
+// dense        vector<T*>
+//      dense[n] is the value for n, for n < dense.size()
+//
+// sparse       HashMap<Ulong, T*>
+//      Values for n >= dense.size()
+//
+// count        size_t
+//      Number of entries in both containers together.
+
+template <typename T>
+class IndexMap {
+    typedef HashMap<Ulong, T*>  SparseMap;
+
+    vector<T*>  dense;
+    SparseMap   sparse;
+    size_t      count;
+
+public:
+                IndexMap() : count(0) { }
+
+    T*          find (Ulong n) const;
+    void        insert (Ulong n, T* ptr);
+    size_t      size() const { return count; }
+
+private:
+    void        growDense (Ulong n);
+};
+
+
+
+// find -- get the value for n, or Null if there is none
+
+template <typename T>
+inline T*
+IndexMap<T>::find (Ulong n) const
+{
+    if (n < dense.size())
+        return dense[n];
+    if (sparse.empty())
+        return Null;
+    typename SparseMap::const_iterator  iter = sparse.find(n);
+    return (iter != sparse.end() ? iter->second : Null);
+}
+
+
+
+// insert -- set the value for n, replacing any earlier value
+//   n          key
+//   ptr        value; must not be Null
+
+template <typename T>
+void
+IndexMap<T>::insert (Ulong n, T* ptr)
+{
+    assert (ptr != Null);
+
+    // Use the vector if n fits or if growing it to hold n keeps it at
+    // least half full.  The 64 lets small tables start densely even
+    // when their first refnum is not 0.
+
+    if (n >= dense.size()  &&  n < 2*count + 64)
+        growDense(n);
+    if (n < dense.size()) {
+        if (dense[n] == Null)
+            ++count;
+        dense[n] = ptr;
+    } else {
+        T*&  slot = sparse[n];
+        if (slot == Null)
+            ++count;
+        slot = ptr;
+    }
+}
+
+
+
+// growDense -- grow the vector to hold at least n+1 entries
+// Moves the entries of sparse that fit into the grown vector.
+
+template <typename T>
+void
+IndexMap<T>::growDense (Ulong n)
+{
+    dense.resize(std::max(static_cast<size_t>(n) + 1, 2*dense.size()),
+                 static_cast<T*>(Null));
+    if (sparse.empty())
+        return;
+
+    vector<Ulong>  moved;
+    typename SparseMap::iterator  iter = sparse.begin();
+    for ( ;  iter != sparse.end();  ++iter) {
+        if (iter->first < dense.size()) {
+            dense[iter->first] = iter->second;
+            moved.push_back(iter->first);
+        }
+    }
+    for (size_t j = 0;  j < moved.size();  ++j)
+        sparse.erase(moved[j]);
+}
+
+
+}  // namespace SoftJin
+
+#endif  // MISC_FLATMAP_H_INCLUDED
@@ -6,10 +6,17 @@
 // This software may be used only under the terms of the SoftJin
 // Source License.  See the accompanying file LICENSE for details.
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>               // for rename
 #include <cstring>
 #include <new>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <zlib.h>
+#include <boost/scoped_array.hpp>
 
 #include "gzfile.h"
 #include "utils.h"
@@ -17,6 +24,7 @@
 namespace SoftJin {
 
 using namespace std;
+using boost::scoped_array;
 
 
 // FileImpl -- virtual base class for the implementation classes.
@@ -90,26 +98,354 @@ NormalFile::seek (off_t offset, int whence) {
 }
 
 
+//----------------------------------------------------------------------
+//                              GzipIndex
+//----------------------------------------------------------------------
+// Reading a gzipped file normally means decompressing it from the
+// beginning, so a backward seek restarts decompression from the start
+// and a forward seek decompresses everything it skips.  GzipFile
+// instead remembers checkpoints as it decompresses, in the manner of
+// zran.c in the zlib distribution.  A checkpoint is a place at a
+// deflate block boundary about every GzipIndexSpan uncompressed bytes,
+// together with the 32 KB of output that precedes it.  Decompression
+// can restart at any checkpoint, so a seek costs at most GzipIndexSpan
+// bytes of decompression once the checkpoints before it are known.
+//
+// When a reader reaches the end of the file, it has seen all the
+// checkpoints.  It then saves them in a cache file next to the gzipped
+// file, whose name has GzipIndexSuffix appended.  Later readers load
+// the cache when they open the file, so that seeks anywhere are fast
+// from the beginning.  The cache records the size and modification
+// time of the gzipped file and is ignored if they do not match.  It
+// ends with a CRC-32 of everything before it, so that a cache damaged
+// after it was written is ignored too.  Cache files are only an
+// optimization: errors in reading or writing them are ignored.
+//
+// The checkpoint windows are kept deflated, in memory and in the cache,
+// because they are usually much more compressible than the data.
+//
+// Cache file format.  All integers are little-endian.
+//     magic            8 bytes, GzipIndexMagic
+//     file size        8 bytes
+//     file mtime       8 bytes
+//     span             8 bytes, GzipIndexSpan
+//     count            8 bytes, number of checkpoints
+//     count checkpoints, each:
+//         uncompOffset     8 bytes
+//         compOffset       8 bytes
+//         bits             1 byte
+//         window size      4 bytes
+//         window           that many bytes
+//     checksum         4 bytes, crc32() of all the bytes above
+
+
+const Uint   GzipWindowSize = 32*1024;
+    // Size of deflate's history.  A checkpoint must save this much
+    // output to restart decompression.
+
+const Uint   GzipInputSize = 64*1024;
+    // GzipFile reads the compressed file in pieces of this size.
+
+const off_t  GzipIndexSpan = 1024*1024;
+    // Approximate distance in uncompressed bytes between checkpoints.
+
+const char   GzipIndexSuffix[] = ".gzi";
+const char   GzipIndexMagic[8] = { 'S', 'J', 'G', 'Z', 'I', 'D', 'X', '2' };
+
+
+
+// GzipCheckpoint -- a place where decompression can restart
+//   uncompOffset   offset in the uncompressed data
+//   compOffset     offset in the gzipped file of the first byte with
+//                  bits of the next deflate block.  If bits is not 0,
+//                  the block begins in the byte before.
+//   bits           number of bits of the block in the byte before
+//                  compOffset
+//   window         deflated copy of the GzipWindowSize bytes of output
+//                  that precede uncompOffset
+
+struct GzipCheckpoint {
+    off_t       uncompOffset;
+    off_t       compOffset;
+    int         bits;
+    string      window;
+};
+
+
+
+// GzipIndex -- the checkpoints of one gzipped file
+//   points     the checkpoints in order of offset
+//   complete   true if points has all the checkpoints in the file,
+//              i.e., some reader has reached the end of the file or
+//              the points were loaded from the cache
+
+class GzipIndex {
+public:
+    vector<GzipCheckpoint>  points;
+    bool        complete;
+
+                GzipIndex() : complete(false) { }
+    const GzipCheckpoint*  findPoint (off_t offset) const;
+    bool        load (const string& cacheName, off_t fileSize,
+                      time_t mtime);
+    void        save (const string& cacheName, off_t fileSize,
+                      time_t mtime) const;
+};
+
+
+
+// findPoint -- the last checkpoint at or before an uncompressed offset
+// Returns Null if there is none.
+
+const GzipCheckpoint*
+GzipIndex::findPoint (off_t offset) const
+{
+    size_t  lo = 0, hi = points.size();
+    while (lo < hi) {
+        size_t  mid = lo + (hi - lo)/2;
+        if (points[mid].uncompOffset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo == 0 ? Null : &points[lo-1]);
+}
+
+
+
+static void
+AppendLittleEndian (/*inout*/ string* str, Ullong val, Uint nbytes)
+{
+    for (Uint j = 0;  j < nbytes;  ++j) {
+        str->push_back(static_cast<char>(val & 0xff));
+        val >>= 8;
+    }
+}
+
+
+// ReadLittleEndian -- read an integer from a cache, advancing *pos
+// Returns false if the cache ends first.
+
+static bool
+ReadLittleEndian (const string& str, /*inout*/ size_t* pos, Uint nbytes,
+                  /*out*/ Ullong* val)
+{
+    if (str.size() - *pos < nbytes)
+        return false;
+    *val = 0;
+    for (Uint j = nbytes;  j-- > 0;  )
+        *val = (*val << 8) | static_cast<Uchar>(str[*pos + j]);
+    *pos += nbytes;
+    return true;
+}
+
+
+
+// load -- read the checkpoints from a cache file
+// Returns true if the cache exists, is intact, and is for this version
+// of the file.
+
+bool
+GzipIndex::load (const string& cacheName, off_t fileSize, time_t mtime)
+{
+    int  fd = ::open(cacheName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat  st;
+    string  cache;
+    bool  ok = (fstat(fd, &st) == 0);
+    if (ok) {
+        cache.resize(st.st_size);
+        ok = (ReadNBytes(fd, &cache[0], cache.size())
+                  == static_cast<ssize_t>(cache.size()));
+    }
+    ::close(fd);
+
+    // Check and then drop the checksum at the end.
+
+    Ullong  checksum;
+    size_t  pos = sizeof GzipIndexMagic;
+    size_t  sumPos = cache.size() - 4;
+    ok = ok  &&  cache.size() >= pos + 4
+             &&  ReadLittleEndian(cache, &sumPos, 4, &checksum)
+             &&  checksum == crc32(0L, reinterpret_cast<const Bytef*>(
+                                           cache.data()),
+                                   cache.size() - 4);
+    if (! ok)
+        return false;
+    cache.resize(cache.size() - 4);
+
+    Ullong  size, time, span, count;
+    ok = memcmp(cache.data(), GzipIndexMagic, pos) == 0
+             &&  ReadLittleEndian(cache, &pos, 8, &size)
+             &&  ReadLittleEndian(cache, &pos, 8, &time)
+             &&  ReadLittleEndian(cache, &pos, 8, &span)
+             &&  ReadLittleEndian(cache, &pos, 8, &count)
+             &&  size == static_cast<Ullong>(fileSize)
+             &&  time == static_cast<Ullong>(mtime)
+             &&  span == static_cast<Ullong>(GzipIndexSpan);
+    if (! ok)
+        return false;
+
+    vector<GzipCheckpoint>  newPoints;
+    for (Ullong j = 0;  j < count;  ++j) {
+        Ullong  uncompOffset, compOffset, bits, winSize;
+        if (! ReadLittleEndian(cache, &pos, 8, &uncompOffset)
+                ||  ! ReadLittleEndian(cache, &pos, 8, &compOffset)
+                ||  ! ReadLittleEndian(cache, &pos, 1, &bits)
+                ||  ! ReadLittleEndian(cache, &pos, 4, &winSize)
+                ||  bits > 7  ||  cache.size() - pos < winSize
+                ||  compOffset > static_cast<Ullong>(fileSize)
+                ||  (! newPoints.empty()  &&  static_cast<off_t>(uncompOffset)
+                                    <= newPoints.back().uncompOffset))
+            return false;
+        newPoints.push_back(GzipCheckpoint());
+        GzipCheckpoint&  point = newPoints.back();
+        point.uncompOffset = uncompOffset;
+        point.compOffset = compOffset;
+        point.bits = bits;
+        point.window.assign(cache, pos, winSize);
+        pos += winSize;
+    }
+    if (pos != cache.size())
+        return false;
+    points.swap(newPoints);
+    complete = true;
+    return true;
+}
+
+
+
+// save -- write the checkpoints to a cache file
+// Writes a temporary file and renames it so that concurrent readers
+// never see a partial cache.
+
+void
+GzipIndex::save (const string& cacheName, off_t fileSize, time_t mtime) const
+{
+    string  cache(GzipIndexMagic, sizeof GzipIndexMagic);
+    AppendLittleEndian(&cache, fileSize, 8);
+    AppendLittleEndian(&cache, mtime, 8);
+    AppendLittleEndian(&cache, GzipIndexSpan, 8);
+    AppendLittleEndian(&cache, points.size(), 8);
+    for (size_t j = 0;  j < points.size();  ++j) {
+        const GzipCheckpoint&  point = points[j];
+        AppendLittleEndian(&cache, point.uncompOffset, 8);
+        AppendLittleEndian(&cache, point.compOffset, 8);
+        AppendLittleEndian(&cache, point.bits, 1);
+        AppendLittleEndian(&cache, point.window.size(), 4);
+        cache += point.window;
+    }
+    AppendLittleEndian(&cache, crc32(0L, reinterpret_cast<const Bytef*>(
+                                             cache.data()),
+                                     cache.size()),
+                       4);
+
+    char  suffix[64];
+    SNprintf(suffix, sizeof suffix, ".%ld.%p", static_cast<long>(getpid()),
+             static_cast<const void*>(this));
+    string  tmpName = cacheName + suffix;
+    int  fd = ::open(tmpName.c_str(), O_WRONLY|O_CREAT|O_EXCL, 0666);
+    if (fd < 0)
+        return;
+    bool  ok = (WriteNBytes(fd, cache.data(), cache.size()) >= 0);
+    ok = (::close(fd) == 0)  &&  ok;
+    if (! ok  ||  rename(tmpName.c_str(), cacheName.c_str()) != 0)
+        unlink(tmpName.c_str());
+}
+
+
+
 //----------------------------------------------------------------------
 //                              GzipFile
 //----------------------------------------------------------------------
 
+// GzipFile -- implementation class for gzipped files
+// In write mode this uses zlib's gzFile.  In read mode it does its own
+// decompression so that it can use a GzipIndex for seeks.  It reads the
+// file with pread(), so several GzipFiles may read the same file at the
+// same time, each from its own place.
+//
+// gzf          zlib's file handle.  Used only in write mode.
+//
+// The rest are used only in read mode.
+//
+// fd           the gzipped file
+// fname        its pathname, for the cache file's name
+// fileSize, fileTime   size and modification time of the file, to
+//              validate the cache
+// strm         the decompressor.  Valid only if inflating is true.
+// rawDeflate   true if strm was started at a checkpoint and is reading
+//              raw deflate data rather than a gzip member.  The gzip
+//              trailer must then be skipped by hand.
+// atEof        the last gzip member has been decompressed
+// inbuf        compressed input
+// inEnd        file offset just past the data read into inbuf
+// window       decompressed output.  inflate() writes into this circular
+//              buffer, and read() copies from it, so that the last
+//              GzipWindowSize bytes of output are available when a
+//              checkpoint is made.
+// winHave      number of bytes in window written by inflate() since it
+//              last wrapped around
+// pendBegin    window[pendBegin, winHave) has not yet been returned by
+//              read().  Invariant: pendBegin <= winHave
+// outTotal     uncompressed offset of window[winHave]
+// index        checkpoints known so far
+// indexSaved   index is complete and need not be saved again
+
 class GzipFile : public FileImpl {
-    gzFile      gzf;            // zlib's file handle
+    gzFile      gzf;            // zlib's file handle (write mode)
+
+    int         fd;
+    string      fname;
+    off_t       fileSize;
+    time_t      fileTime;
+    z_stream    strm;
+    bool        inflating;
+    bool        rawDeflate;
+    bool        atEof;
+    scoped_array<Bytef>  inbuf;
+    off_t       inEnd;
+    scoped_array<Bytef>  window;
+    Uint        winHave;
+    Uint        pendBegin;
+    off_t       outTotal;
+    GzipIndex   index;
+    bool        indexSaved;
+
 public:
                     GzipFile();
-    virtual         ~GzipFile() { }
+    virtual         ~GzipFile();
     virtual void    open (const char* fname, FileHandle::AccessMode accMode);
     virtual int     close();
     virtual ssize_t read (/*out*/ void* buf, size_t nbytes);
     virtual ssize_t write (const void* buf, size_t nbytes);
     virtual off_t   seek (off_t offset, int whence);
+
+private:
+    off_t       currOffset() const;
+    void        endInflate();
+    bool        restartAt (const GzipCheckpoint* point);
+    bool        ensureInput (Uint nbytes);
+    ssize_t     decompressMore();
+    bool        beginNextMember();
+    void        addCheckpoint();
+    void        finishIndex();
 };
 
 
 
 GzipFile::GzipFile() {
     gzf = Null;
+    fd = -1;
+    inflating = false;
+}
+
+
+
+/*virtual*/
+GzipFile::~GzipFile() {
+    endInflate();
 }
 
 
@@ -120,9 +456,31 @@ GzipFile::open (const char* fname, FileHandle::AccessMode accMode)
     // Instead of using gzopen() to open the file, use OpenFile() and
     // then gzdopen().  We get better error messages that way.
 
-    const char*  gzMode = (accMode == FileHandle::ReadAccess) ? "rb" : "wb";
-    int  fd = OpenFile(fname, accMode);
-    if ((gzf = gzdopen(fd, gzMode)) == Null) {
+    if (accMode != FileHandle::ReadAccess) {
+        int  fd = OpenFile(fname, accMode);
+        if ((gzf = gzdopen(fd, "wb")) == Null) {
+            ::close(fd);
+            throw bad_alloc();
+        }
+        return;
+    }
+
+    fd = OpenFile(fname, accMode);
+    struct stat  st;
+    if (fstat(fd, &st) < 0) {
+        int  err = errno;
+        ::close(fd);
+        ThrowRuntimeError("cannot stat '%s': %s", fname, strerror(err));
+    }
+    this->fname = fname;
+    fileSize = st.st_size;
+    fileTime = st.st_mtime;
+
+    inbuf.reset(new Bytef[GzipInputSize]);
+    window.reset(new Bytef[GzipWindowSize]);
+    indexSaved = index.load(this->fname + GzipIndexSuffix, fileSize,
+                            fileTime);
+    if (! restartAt(Null)) {
         ::close(fd);
         throw bad_alloc();
     }
@@ -133,13 +491,37 @@ GzipFile::open (const char* fname, FileHandle::AccessMode accMode)
 int
 GzipFile::close()
 {
-    return (gzclose(gzf) == Z_OK ? 0 : -1);
+    if (gzf != Null)
+        return (gzclose(gzf) == Z_OK ? 0 : -1);
+    endInflate();
+    return (::close(fd));
 }
 
 
+
+// read -- copy decompressed data to buf
+// Returns the number of bytes copied, which is less than nbytes only at
+// the end of the file, or -1 on error.
+
 ssize_t
-GzipFile::read (/*out*/ void* buf, size_t nbytes) {
-    return (gzread(gzf, buf, nbytes));
+GzipFile::read (/*out*/ void* buf, size_t nbytes)
+{
+    char*   dest = static_cast<char*>(buf);
+    size_t  ncopied = 0;
+    while (ncopied < nbytes) {
+        if (pendBegin == winHave) {
+            ssize_t  nout = decompressMore();
+            if (nout < 0)
+                return -1;
+            if (nout == 0)
+                break;
+        }
+        size_t  n = min<size_t>(nbytes - ncopied, winHave - pendBegin);
+        memcpy(dest + ncopied, window.get() + pendBegin, n);
+        pendBegin += n;
+        ncopied += n;
+    }
+    return ncopied;
 }
 
 
@@ -150,9 +532,310 @@ GzipFile::write (const void* buf, size_t nbytes) {
 }
 
 
+
+// seek -- move to an offset in the uncompressed data
+// In write mode this is gzseek().  In read mode SEEK_SET and SEEK_CUR
+// are allowed in either direction.  Returns -1 and sets errno to EINVAL
+// if the offset is negative or beyond the end of the data.
+
 off_t
-GzipFile::seek (off_t offset, int whence) {
-    return (gzseek(gzf, offset, whence));
+GzipFile::seek (off_t offset, int whence)
+{
+    if (gzf != Null)
+        return (gzseek(gzf, offset, whence));
+
+    off_t  pos = currOffset();
+    if (whence == SEEK_CUR)
+        offset += pos;
+    else if (whence != SEEK_SET)
+        offset = -1;
+    if (offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // If the target is in the window, no decompression is needed.
+    // window[0, winHave) holds the latest output in order.
+
+    if (offset <= outTotal  &&  pos - offset <= static_cast<off_t>(pendBegin)) {
+        pendBegin += offset - pos;
+        return offset;
+    }
+
+    // Restart at the last checkpoint before the target if that saves
+    // decompressing anything.  Going backward we must restart, at the
+    // beginning of the file if there is no checkpoint.
+
+    // A checkpoint that cannot be used means the cache was bad.  Forget
+    // all the checkpoints and rebuild them from the beginning; the new
+    // index replaces the cache when it is complete.
+
+    const GzipCheckpoint*  point = index.findPoint(offset);
+    if (offset < pos  ||  (point != Null  &&  point->uncompOffset > pos)) {
+        bool  ok = restartAt(point);
+        if (! ok  &&  point != Null) {
+            index = GzipIndex();
+            indexSaved = false;
+            ok = restartAt(Null);
+        }
+        if (! ok) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    // Decompress and discard up to the target.
+
+    while (currOffset() < offset) {
+        if (pendBegin == winHave) {
+            ssize_t  nout = decompressMore();
+            if (nout < 0)
+                return -1;
+            if (nout == 0) {
+                errno = EINVAL;
+                return -1;
+            }
+        }
+        pendBegin += min<off_t>(offset - currOffset(), winHave - pendBegin);
+    }
+    return offset;
+}
+
+
+
+// currOffset -- uncompressed offset of the next byte read() returns
+
+inline off_t
+GzipFile::currOffset() const {
+    return (outTotal - (winHave - pendBegin));
+}
+
+
+
+void
+GzipFile::endInflate()
+{
+    if (inflating)
+        inflateEnd(&strm);
+    inflating = false;
+}
+
+
+
+// restartAt -- restart decompression at a checkpoint
+//   point      the checkpoint, or Null to start at the beginning
+// Returns false if zlib runs out of memory, or if the checkpoint is
+// bad: the byte holding the first bits of its block cannot be read, or
+// its window does not decompress to GzipWindowSize bytes.  The caller
+// should then drop the index and restart at the beginning.
+
+bool
+GzipFile::restartAt (const GzipCheckpoint* point)
+{
+    endInflate();
+    memset(&strm, 0, sizeof strm);
+    atEof = false;
+    strm.next_in = inbuf.get();
+    strm.avail_in = 0;
+
+    // At the beginning of the file, let zlib handle the gzip header.
+    // 16 added to windowBits selects the gzip format.
+
+    if (point == Null) {
+        if (inflateInit2(&strm, 15+16) != Z_OK)
+            return false;
+        inflating = true;
+        rawDeflate = false;
+        inEnd = 0;
+        winHave = pendBegin = 0;
+        outTotal = 0;
+        return true;
+    }
+
+    // At a checkpoint, the input is raw deflate data.  If the block
+    // begins in the middle of a byte, give inflate the bits of it that
+    // belong to the block.  Then give it the window as its history.
+
+    if (inflateInit2(&strm, -15) != Z_OK)
+        return false;
+    inflating = true;
+    rawDeflate = true;
+    inEnd = point->compOffset - (point->bits != 0 ? 1 : 0);
+    if (point->bits != 0) {
+        if (! ensureInput(1))
+            return false;
+        int  byte = *strm.next_in;
+        ++strm.next_in;
+        --strm.avail_in;
+        inflatePrime(&strm, point->bits, byte >> (8 - point->bits));
+    }
+
+    uLongf  winSize = GzipWindowSize;
+    if (uncompress(window.get(), &winSize,
+                   reinterpret_cast<const Bytef*>(point->window.data()),
+                   point->window.size()) != Z_OK
+            ||  winSize != GzipWindowSize
+            ||  inflateSetDictionary(&strm, window.get(), GzipWindowSize)
+                    != Z_OK)
+        return false;
+
+    // The window is full of history, none of it pending.
+    winHave = pendBegin = GzipWindowSize;
+    outTotal = point->uncompOffset;
+    return true;
+}
+
+
+
+// ensureInput -- make sure that strm has at least nbytes of input
+// Returns false if the file ends first.  nbytes must be small.
+
+bool
+GzipFile::ensureInput (Uint nbytes)
+{
+    assert (nbytes <= GzipInputSize);
+    if (strm.avail_in >= nbytes)
+        return true;
+
+    memmove(inbuf.get(), strm.next_in, strm.avail_in);
+    strm.next_in = inbuf.get();
+    while (strm.avail_in < nbytes) {
+        ssize_t  nr = pread(fd, inbuf.get() + strm.avail_in,
+                            GzipInputSize - strm.avail_in, inEnd);
+        if (nr < 0  &&  errno == EINTR)
+            continue;
+        if (nr <= 0)
+            return false;
+        strm.avail_in += nr;
+        inEnd += nr;
+    }
+    return true;
+}
+
+
+
+// decompressMore -- decompress some data into window
+// Returns the number of bytes added, 0 at the end of the file, or -1
+// on error.  Precondition: pendBegin == winHave
+
+ssize_t
+GzipFile::decompressMore()
+{
+    assert (pendBegin == winHave);
+    if (atEof  ||  ! inflating)
+        return 0;
+    if (winHave == GzipWindowSize)
+        winHave = pendBegin = 0;
+
+    // Z_BLOCK makes inflate() stop at the end of each deflate block, so
+    // that checkpoints can be made there.  Bit 7 of data_type is then
+    // set; bit 6 says the block was the last one in the member.
+
+    // inflate() may have input left in its own state even when strm
+    // has none, so the file is truncated only if inflate() can make no
+    // progress without more input.
+
+    for (;;) {
+        (void) ensureInput(1);
+        strm.next_out = window.get() + winHave;
+        strm.avail_out = GzipWindowSize - winHave;
+        int  zstat = inflate(&strm, Z_BLOCK);
+        Uint  nout = (GzipWindowSize - winHave) - strm.avail_out;
+        winHave += nout;
+        outTotal += nout;
+
+        if (zstat == Z_STREAM_END) {
+            if (! beginNextMember()) {
+                atEof = true;
+                finishIndex();
+            }
+        } else if ((zstat != Z_OK  &&  zstat != Z_BUF_ERROR)
+                   ||  (zstat == Z_BUF_ERROR  &&  strm.avail_in == 0)) {
+            errno = EIO;
+            return -1;
+        } else if ((strm.data_type & 128)  &&  !(strm.data_type & 64))
+            addCheckpoint();
+
+        if (nout > 0  ||  atEof)
+            return nout;
+    }
+}
+
+
+
+// beginNextMember -- after a gzip member, get ready for the next one
+// Returns false if there is no next member.  As with gzread(),
+// anything after the last member that is not a gzip header is ignored.
+
+bool
+GzipFile::beginNextMember()
+{
+    // When decompressing raw deflate data, skip the CRC and length
+    // that end the member.  inflate() checks them otherwise.
+
+    if (rawDeflate) {
+        if (! ensureInput(8))
+            return false;
+        strm.next_in += 8;
+        strm.avail_in -= 8;
+    }
+    if (! ensureInput(2)  ||  strm.next_in[0] != 0x1f
+            ||  strm.next_in[1] != 0x8b)
+        return false;
+    if (inflateReset2(&strm, 15+16) != Z_OK)
+        return false;
+    rawDeflate = false;
+    return true;
+}
+
+
+
+// addCheckpoint -- make a checkpoint at the current block boundary
+// Only one every GzipIndexSpan bytes beyond the last one known.
+// Decompression always restarts at a known checkpoint or at the
+// beginning, so checkpoints are found in order.
+
+void
+GzipFile::addCheckpoint()
+{
+    if (index.complete)
+        return;
+    off_t  last = index.points.empty() ? 0 : index.points.back().uncompOffset;
+    if (outTotal - last < GzipIndexSpan)
+        return;
+
+    // Unroll the circular window so that the oldest byte comes first.
+
+    Bytef  history[GzipWindowSize];
+    memcpy(history, window.get() + winHave, GzipWindowSize - winHave);
+    memcpy(history + GzipWindowSize - winHave, window.get(), winHave);
+
+    uLongf  compSize = compressBound(GzipWindowSize);
+    scoped_array<Bytef>  comp(new Bytef[compSize]);
+    if (compress(comp.get(), &compSize, history, GzipWindowSize) != Z_OK)
+        return;
+
+    index.points.push_back(GzipCheckpoint());
+    GzipCheckpoint&  point = index.points.back();
+    point.uncompOffset = outTotal;
+    point.compOffset = inEnd - strm.avail_in;
+    point.bits = strm.data_type & 7;
+    point.window.assign(reinterpret_cast<const char*>(comp.get()), compSize);
+}
+
+
+
+// finishIndex -- note that the index is complete and cache it
+// Small files have no checkpoints; there is no point caching them.
+
+void
+GzipFile::finishIndex()
+{
+    index.complete = true;
+    if (indexSaved  ||  index.points.empty())
+        return;
+    index.save(fname + GzipIndexSuffix, fileSize, fileTime);
+    indexSaved = true;
 }
 
 
@@ -161,6 +844,22 @@ GzipFile::seek (off_t offset, int whence) {
 //                              FileHandle
 //----------------------------------------------------------------------
 
+// HasGzipMagic -- true if the file begins with the gzip magic bytes
+// A file that cannot be opened or read counts as gzipped, so that
+// GzipFile::open() reports the error.
+
+static bool
+HasGzipMagic (const string& fname)
+{
+    int  fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+        return true;
+    Uchar    magic[2];
+    ssize_t  nr = ReadNBytes(fd, magic, sizeof magic);
+    ::close(fd);
+    return (nr < 0  ||  (nr == 2  &&  magic[0] == 0x1f  &&  magic[1] == 0x8b));
+}
+
 // FileHandle constructor
 //   fname      pathname of file to read or create
 //   ftype      type of file: compressed or uncompressed
@@ -181,6 +880,7 @@ FileHandle::FileHandle (const char* fname, FileType ftype)
             ftype = FileTypeNormal;
     }
 
+    gzipped = (ftype == FileTypeGzip);
     switch (ftype) {
         case FileTypeNormal: impl = new NormalFile();   break;
         case FileTypeGzip:   impl = new GzipFile();     break;
@@ -195,8 +895,19 @@ FileHandle::~FileHandle() {
 }
 
 
+// open -- open the file for reading or writing
+// A file to be read as gzipped that does not begin with the gzip magic
+// bytes is read as it is, as gzread() does.  isGzipped() then returns
+// false.
+
 void
-FileHandle::open (AccessMode accMode) {
+FileHandle::open (AccessMode accMode)
+{
+    if (gzipped  &&  accMode == ReadAccess  &&  ! HasGzipMagic(fname)) {
+        delete impl;
+        impl = new NormalFile();
+        gzipped = false;
+    }
     impl->open(fname.c_str(), accMode);
     isOpen = true;
 }
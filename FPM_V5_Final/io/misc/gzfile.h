@@ -31,10 +31,25 @@ namespace SoftJin {
 // permissions are 0666 modified by the umask.  open() throws
 // runtime_error if it fails.
 //
+// isGzipped() tells whether the file is treated as gzipped, after
+// FileTypeAuto has been resolved.  It may be called before open().  A
+// gzipped file opened for reading that does not begin with the gzip
+// magic bytes is read as it is, like gzread() does, and isGzipped()
+// returns false after open().
+//
 // close(), read(), and write() have the same semantics as the system
 // calls.  seek() is also like the system call, but with the
 // restrictions of gzseek() in <zlib.h>: SEEK_END is not allowed, and in
-// write mode only forward seeks are allowed.
+// write mode only forward seeks are allowed.  In read mode a seek
+// beyond the end of the data fails with EINVAL.
+//
+// Seeks in gzipped files being read are fast.  The reader saves
+// checkpoints as it decompresses and restarts at the nearest one.  The
+// first reader to reach the end of the file caches the checkpoints in
+// a file with the suffix '.gzi' next to it, so that later readers can
+// seek anywhere without decompressing the file first.  Each FileHandle
+// reads with pread(), so several of them can read different parts of
+// the same file at once, in different threads.  See gzfile.cc.
 
 class FileHandle {
 public:
@@ -52,6 +67,7 @@ private:
     std::string      fname;
     class FileImpl*  impl;      // instance of appropriate body class
     bool             isOpen;    // true => file is open
+    bool             gzipped;   // true => impl is for a gzipped file
 
 public:
                 FileHandle (const char* fname, FileType ftype);
@@ -61,6 +77,7 @@ public:
     ssize_t     read (/*out*/ void* buf, size_t nbytes);
     ssize_t     write (const void* buf, size_t nbytes);
     off_t       seek (off_t offset, int whence);
+    bool        isGzipped() const  { return gzipped; }
 };
 
 
@@ -89,6 +89,40 @@ OasisBuilder::beginXGeometry (Ulong, Ulong,
 /*virtual*/ void
 OasisBuilder::endElement()  { }
 
+/*virtual*/ bool
+OasisBuilder::wantBatches()  { return false; }
+
+
+// addElements -- default: pass each element of the batch separately.
+// A builder that wants batches but does not override this gets the
+// same calls it would have got without batching.
+
+/*virtual*/ void
+OasisBuilder::addElements (const ElementBatch& batch)
+{
+    PointList  ptlist;
+    size_t  n = batch.size();
+    for (size_t i = 0;  i < n;  ++i) {
+        Ulong  ri = batch.repIndex[i];
+        const Repetition*  rep = (ri == ElementBatch::NoRepetition)
+                                    ? Null : &batch.reps[ri];
+        if (batch.kind == ElementBatch::Rectangles) {
+            const long*  c = &batch.coords[4*i];
+            beginRectangle(batch.layer, batch.datatype,
+                           c[0], c[1], c[2], c[3], rep);
+        } else {
+            ptlist.init(batch.listTypes[i]);
+            for (size_t k = batch.pointStart[i];  k < batch.pointStart[i+1];
+                    ++k)
+                ptlist.addPoint(batch.points[k]);
+            beginPolygon(batch.layer, batch.datatype,
+                         batch.coords[2*i], batch.coords[2*i+1], ptlist, rep);
+        }
+        endElement();
+    }
+}
+
+
 /*virtual*/ void
 OasisBuilder::addCellProperty (Property*)  { }
 
@@ -117,4 +151,84 @@ OasisBuilder::registerLayerName  (LayerName*)  { }
 OasisBuilder::registerXName      (XName*)  { }
 
 
+
+//----------------------------------------------------------------------
+// ElementBatch
+
+const Ulong  ElementBatch::NoRepetition;
+
+
+// init -- empty the batch and set the kind, layer and datatype of the
+// elements that follow.  The vectors keep their capacity and the
+// Repetitions in reps are kept for reuse.
+
+void
+ElementBatch::init (Kind kind, Ulong layer, Ulong datatype)
+{
+    this->kind = kind;
+    this->layer = layer;
+    this->datatype = datatype;
+
+    coords.clear();
+    points.clear();
+    pointStart.assign(1, 0);
+    listTypes.clear();
+    repIndex.clear();
+    numReps = 0;
+}
+
+
+
+void
+ElementBatch::addRectangle (long x, long y, long width, long height,
+                            const Repetition* rep, bool reused)
+{
+    coords.push_back(x);
+    coords.push_back(y);
+    coords.push_back(width);
+    coords.push_back(height);
+    addRepetition(rep, reused);
+}
+
+
+
+void
+ElementBatch::addPolygon (long x, long y, const PointList& ptlist,
+                          const Repetition* rep, bool reused)
+{
+    coords.push_back(x);
+    coords.push_back(y);
+    points.insert(points.end(), ptlist.begin(), ptlist.end());
+    pointStart.push_back(points.size());
+    listTypes.push_back(ptlist.getType());
+    addRepetition(rep, reused);
+}
+
+
+
+// addRepetition -- set repIndex for the element just added.
+//   rep        the element's repetition, or Null if it has none
+//   reused     true if the file reused the previous repetition
+
+void
+ElementBatch::addRepetition (const Repetition* rep, bool reused)
+{
+    if (rep == Null) {
+        repIndex.push_back(NoRepetition);
+        return;
+    }
+    // Assign to a Repetition left over from an earlier batch if there
+    // is one so that its vector of deltas is reused.
+
+    if (! reused  ||  numReps == 0) {
+        if (numReps == reps.size())
+            reps.push_back(*rep);
+        else
+            reps[numReps] = *rep;
+        ++numReps;
+    }
+    repIndex.push_back(numReps - 1);
+}
+
+
 }  // namespace Oasis
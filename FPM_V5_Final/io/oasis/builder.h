@@ -26,6 +26,7 @@
 #define OASIS_BUILDER_H_INCLUDED
 
 #include <string>
+#include <vector>
 #include "names.h"
 #include "oasis.h"
 #include "trapezoid.h"
@@ -33,6 +34,74 @@
 namespace Oasis {
 
 using SoftJin::Ulong;
+using std::vector;
+
+
+// ElementBatch -- run of rectangles or polygons passed to addElements()
+// All elements in a batch have the same kind, layer and datatype.
+// Element i of the batch is described by
+//
+//   coords[C*i .. C*i+C-1]
+//          For rectangles C is 4 and the values are x, y, width and
+//          height.  For polygons C is 2 and the values are x and y.
+//
+//   points[pointStart[i] .. pointStart[i+1]-1], listTypes[i]
+//          Polygons only.  The points and type of the polygon's
+//          PointList as they would be passed to beginPolygon().  The
+//          points are relative to (x,y).  pointStart has one entry
+//          more than the number of elements.
+//
+//   repIndex[i]
+//          Index in reps of the element's repetition, or NoRepetition.
+//          Elements whose repetition was reused from the previous
+//          element in the file get the same index, so a client that
+//          expands repetitions need expand each distinct one only once.
+//          reps may have more entries than the batch refers to.
+//
+// The vectors are public so that clients can walk them directly.  The
+// parser reuses one ElementBatch for all batches, so the vectors and the
+// Repetitions in reps keep their capacity, and a batch is valid only
+// during addElements().
+
+class ElementBatch {
+public:
+    enum Kind { Rectangles, Polygons };
+
+    static const Ulong  NoRepetition = ~0UL;
+
+    Kind        kind;
+    Ulong       layer;
+    Ulong       datatype;
+
+    vector<long>                coords;
+    vector<Delta>               points;
+    vector<size_t>              pointStart;
+    vector<PointList::ListType> listTypes;
+    vector<Ulong>               repIndex;
+    vector<Repetition>          reps;
+
+public:
+                ElementBatch() { init(Rectangles, 0, 0); }
+
+    void        init (Kind kind, Ulong layer, Ulong datatype);
+    size_t      size() const  { return repIndex.size();  }
+    bool        empty() const { return repIndex.empty(); }
+    bool        accepts (Kind kind, Ulong layer, Ulong datatype) const {
+                    return (empty()  ||  (kind == this->kind
+                                          &&  layer == this->layer
+                                          &&  datatype == this->datatype));
+                }
+
+    void        addRectangle (long x, long y, long width, long height,
+                              const Repetition* rep, bool reused);
+    void        addPolygon (long x, long y, const PointList& ptlist,
+                            const Repetition* rep, bool reused);
+
+private:
+    size_t      numReps;        // entries of reps used by this batch
+
+    void        addRepetition (const Repetition* rep, bool reused);
+};
 
 
 // OasisBuilder -- callbacks for OasisParser.
@@ -87,6 +156,19 @@ using SoftJin::Ulong;
 // records before parsing anything else, so you are guaranteed that the
 // names referenced in the other methods have been resolved.
 //
+// Batches
+//
+// A builder that wants RECTANGLE and POLYGON records in bulk overrides
+// wantBatches() to return true.  The parser then collects runs of
+// rectangles or polygons that have the same layer and datatype and no
+// properties into an ElementBatch and passes each run to addElements()
+// instead of invoking beginRectangle()/beginPolygon() and endElement()
+// for each element.  In the grammar above, a batch can appear wherever
+// <element> can.  Elements with properties are still passed one at a
+// time.  The default addElements() unpacks the batch into the
+// per-element calls, so filters that do not know about batches work
+// unchanged if they pass wantBatches() through.
+//
 // Filters
 //
 // OasisBuilders can be linked to form something like a Unix pipeline.
@@ -179,6 +261,11 @@ public:
 
     virtual void  endElement();
 
+    virtual bool  wantBatches();
+    virtual void  addElements (const ElementBatch& batch);
+        // See Batches above.  wantBatches() is called once at the
+        // start of each parse.
+
     virtual void  addFileProperty (Property* prop);
     virtual void  addCellProperty (Property* prop);
     virtual void  addElementProperty (Property* prop);
@@ -7,6 +7,10 @@
 // Source License.  See the accompanying file LICENSE for details.
 
 #include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <memory>
 #include <zlib.h>
 #include "misc/utils.h"
 #include "compressor.h"
@@ -272,4 +276,206 @@ ZlibInflater::signalZlibError (int zstat, const char* msg)
 }
 
 
+
+//======================================================================
+//                              DeflatePool
+//======================================================================
+
+const Uint  DeflateInputSize = 128*1024;
+    // A worker gives each cblock's input to its deflater in pieces of
+    // this size, the size of OasisWriter's cblock buffer
+    // (CblockBufferSize in writer.cc).  deflate() with Z_NO_FLUSH does
+    // not make its output depend on how the input is split, but there
+    // is no reason to rely on that.
+
+const Uint  DeflateOutputSize = 64*1024;
+    // Size of each worker's buffer for the deflater's output.
+
+
+
+// constructor
+//   numThreads         number of worker threads.  Must be > 0.
+
+DeflatePool::DeflatePool (Uint numThreads)
+{
+    assert (numThreads > 0);
+
+    stopping = false;
+    pthread_mutex_init(&mutex, Null);
+    pthread_cond_init(&jobQueued, Null);
+    pthread_cond_init(&jobDone, Null);
+
+    // If a thread cannot be created, stop the ones already running
+    // before throwing; the destructor will not be called.
+
+    for (Uint j = 0;  j < numThreads;  ++j) {
+        pthread_t  tid;
+        int  err = pthread_create(&tid, Null, runWorker, this);
+        if (err != 0) {
+            stopWorkers();
+            ThrowRuntimeError("cannot create compression thread: %s",
+                              strerror(err));
+        }
+        workers.push_back(tid);
+    }
+}
+
+
+
+DeflatePool::~DeflatePool() {
+    stopWorkers();
+}
+
+
+
+// stopWorkers -- let the workers finish the queue, join them, and
+// destroy the synchronization objects
+
+void
+DeflatePool::stopWorkers()
+{
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_cond_broadcast(&jobQueued);
+    pthread_mutex_unlock(&mutex);
+
+    for (size_t j = 0;  j < workers.size();  ++j)
+        pthread_join(workers[j], Null);
+    workers.clear();
+
+    pthread_cond_destroy(&jobDone);
+    pthread_cond_destroy(&jobQueued);
+    pthread_mutex_destroy(&mutex);
+}
+
+
+
+// submit -- queue a job for compression
+// The caller must have filled in job->context and job->input.
+
+void
+DeflatePool::submit (CblockJob* job)
+{
+    job->done = false;
+    pthread_mutex_lock(&mutex);
+    queue.push_back(job);
+    pthread_cond_signal(&jobQueued);
+    pthread_mutex_unlock(&mutex);
+}
+
+
+
+// isDone -- true if the job has been compressed (or has failed)
+
+bool
+DeflatePool::isDone (CblockJob* job)
+{
+    pthread_mutex_lock(&mutex);
+    bool  done = job->done;
+    pthread_mutex_unlock(&mutex);
+    return done;
+}
+
+
+
+// wait -- block until the job has been compressed (or has failed)
+
+void
+DeflatePool::wait (CblockJob* job)
+{
+    pthread_mutex_lock(&mutex);
+    while (! job->done)
+        pthread_cond_wait(&jobDone, &mutex);
+    pthread_mutex_unlock(&mutex);
+}
+
+
+
+/*static*/ void*
+DeflatePool::runWorker (void* arg)
+{
+    static_cast<DeflatePool*>(arg)->workerLoop();
+    return Null;
+}
+
+
+
+// CompressJob -- compress one cblock with the Compressor protocol
+//   compressor a compressor owned by the calling worker
+//   job        the cblock to compress
+//   outbuf     scratch buffer of DeflateOutputSize bytes
+
+static void
+CompressJob (Compressor* compressor, CblockJob* job, char* outbuf)
+{
+    compressor->beginBlock(job->context.c_str());
+
+    char*  inbuf = const_cast<char*>(job->input.data());
+    size_t  insize = job->input.size();
+    size_t  pos = 0;
+    do {
+        Uint  inbytes = min(insize - pos, static_cast<size_t>(DeflateInputSize));
+        pos += inbytes;
+        compressor->giveInput(inbuf + pos - inbytes, inbytes, pos == insize);
+
+        Uint  outbytes;
+        while ((outbytes = compressor->getOutput(outbuf, DeflateOutputSize))
+                > 0)
+            job->output.append(outbuf, outbytes);
+    } while (pos < insize);
+
+    // The writer keeps the job until it can write the cblock, which may
+    // be a while.  Don't make it hold the uncompressed bytes too.
+    string().swap(job->input);
+}
+
+
+
+// workerLoop -- compress jobs until the pool is destroyed
+// Exceptions must not escape a thread, so any error, including failure
+// to create the deflater, is stored in the job for the writer to
+// report.
+
+void
+DeflatePool::workerLoop()
+{
+    auto_ptr<ZlibDeflater>  deflater;
+    string      initError;
+    try {
+        deflater.reset(new ZlibDeflater);
+    } catch (const std::exception& exc) {
+        initError = exc.what();
+    }
+    vector<char>  outbuf(DeflateOutputSize);
+
+    for (;;) {
+        pthread_mutex_lock(&mutex);
+        while (queue.empty()  &&  ! stopping)
+            pthread_cond_wait(&jobQueued, &mutex);
+        if (queue.empty()) {
+            pthread_mutex_unlock(&mutex);
+            return;
+        }
+        CblockJob*  job = queue.front();
+        queue.pop_front();
+        pthread_mutex_unlock(&mutex);
+
+        if (deflater.get() == Null)
+            job->error = initError;
+        else {
+            try {
+                CompressJob(deflater.get(), job, &outbuf[0]);
+            } catch (const std::exception& exc) {
+                job->error = exc.what();
+            }
+        }
+
+        pthread_mutex_lock(&mutex);
+        job->done = true;
+        pthread_cond_broadcast(&jobDone);
+        pthread_mutex_unlock(&mutex);
+    }
+}
+
+
 }  // namespace Oasis
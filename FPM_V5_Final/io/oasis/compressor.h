@@ -12,12 +12,18 @@
 // defined later.  Hence we define abstract base classes for compression
 // and decompression and specify the protocol for invoking their virtual
 // methods.
+//
+// DeflatePool lets OasisWriter compress several cblocks at once, each
+// in a worker thread with its own ZlibDeflater.
 
 
 #ifndef OASIS_COMPRESSOR_H_INCLUDED
 #define OASIS_COMPRESSOR_H_INCLUDED
 
+#include <deque>
 #include <string>
+#include <vector>
+#include <pthread.h>
 #include "misc/globals.h"
 
 struct z_stream_s;      // from <zlib.h>
@@ -25,7 +31,9 @@ struct z_stream_s;      // from <zlib.h>
 
 namespace Oasis {
 
+using std::deque;
 using std::string;
+using std::vector;
 using SoftJin::Uint;
 using SoftJin::Ulong;
 
@@ -217,6 +225,74 @@ private:
 };
 
 
+//----------------------------------------------------------------------
+
+
+// CblockJob -- contents of one cblock to be compressed by a DeflatePool
+//
+// context      prefix for the error message if compression fails
+// input        the uncompressed contents of the cblock.  The worker
+//              empties it after compressing it.
+// output       the compressed contents.  Valid only after
+//              DeflatePool::wait() returns for the job.
+// error        empty, or the message of the exception thrown while
+//              compressing.  Valid only after wait() returns.
+// done         true when the worker has finished with the job.
+//              Guarded by the pool's mutex; use DeflatePool::isDone().
+
+struct CblockJob {
+    string      context;
+    string      input;
+    string      output;
+    string      error;
+    bool        done;
+
+                CblockJob() : done(false) { }
+};
+
+
+
+// DeflatePool -- compress cblocks in worker threads
+// Each worker has its own ZlibDeflater and takes jobs from a queue in
+// the order they were submitted.  A worker gives the deflater the
+// input in the same pieces that OasisWriter would give it when
+// compressing in its own thread, and each deflater is reset for every
+// cblock, so the output is exactly what the serial writer would write.
+//
+// The pool does not own the jobs.  A job must not be touched after
+// submit() until wait() returns for it, and must not be deleted while
+// the pool may still be working on it.  The destructor finishes the
+// jobs still queued before joining the workers.
+//
+// The constructor throws runtime_error if it cannot create the threads.
+// Errors while compressing are reported through CblockJob::error, not
+// by throwing, because they happen in a worker thread.
+
+class DeflatePool {
+    vector<pthread_t>  workers;
+    deque<CblockJob*>  queue;           // submitted, not yet taken
+    pthread_mutex_t    mutex;           // guards queue, done, stopping
+    pthread_cond_t     jobQueued;       // signalled by submit(), ~DeflatePool()
+    pthread_cond_t     jobDone;         // signalled by workers
+    bool               stopping;        // true => workers should exit
+
+public:
+    explicit            DeflatePool (Uint numThreads);
+                        ~DeflatePool();
+    void                submit (CblockJob* job);
+    bool                isDone (CblockJob* job);
+    void                wait (CblockJob* job);
+
+private:
+    static void*        runWorker (void* arg);
+    void                workerLoop();
+    void                stopWorkers();
+
+                        DeflatePool (const DeflatePool&);       // forbidden
+    void                operator= (const DeflatePool&);         // forbidden
+};
+
+
 }  // namespace Oasis
 
 #endif  // OASIS_COMPRESSOR_H_INCLUDED
@@ -282,7 +282,7 @@ OasisCreator::XNameTable::empty() const {
 
 OasisCreator::OasisCreator (const char* fname,
                             const OasisCreatorOptions& options)
-  : writer(fname),
+  : writer(fname, options.compressThreads),
     s_cell_offset(S_CELL_OFFSET),
     options(options),
 
@@ -461,9 +461,11 @@ OasisCreator::writeTableInfo (const NameTable* ntab)
 OasisCreator::beginCell (CellName* cellName)
 {
     // Save the cell's offset for use when writing the cellName's
-    // S_CELL_OFFSET property.
+    // S_CELL_OFFSET property.  The writer may fill it in later if the
+    // previous cells are still being compressed; that's all right
+    // because HashMap entries don't move.
 
-    cellOffsets[cellName] = writer.currFileOffset();
+    writer.noteFileOffset(&cellOffsets[cellName]);
 
     // If the cellName has been registered, use the refnum form of the
     // CELL record.  Otherwise use the name form and mark the table as
@@ -57,13 +57,25 @@ using SoftJin::HashPointer;
 //      spec.  That is because setting it to true will make OasisParser
 //      parse the file twice, once for the name records and once for the
 //      rest.
+//
+// compressThreads      Uint
+//
+//      Number of threads to compress cblocks in when compression is on.
+//      If this is 0, each cblock is compressed as it is written.
+//      Otherwise each cell's cblock is compressed in the background
+//      while the application goes on to the next cell.  The file is the
+//      same either way; only the time taken to write it changes.  Worth
+//      setting only for large files with compression on.  The default
+//      is 0.
 
 
 struct OasisCreatorOptions {
     bool        immediateNames;
+    Uint        compressThreads;
 
-    OasisCreatorOptions (bool immediateNames) {
+    OasisCreatorOptions (bool immediateNames, Uint compressThreads = 0) {
         this->immediateNames = immediateNames;
+        this->compressThreads = compressThreads;
     }
 };
 
@@ -150,7 +162,9 @@ struct OasisCreatorOptions {
 //      Contains the starting file offset of each cell written.
 //      The key is the CellName* for the cell.  beginCell() stores the
 //      offset here and writeCellName() uses it to to set the value of
-//      the property S_CELL_OFFSET.
+//      the property S_CELL_OFFSET.  With compression threads the
+//      offset is filled in only when the cblocks before the cell are
+//      written, which is before the name tables are written.
 //
 // cellNameTable        auto_ptr<CellNameTable>
 // textStringTable      auto_ptr<TextStringTable>
@@ -91,9 +91,9 @@ RefNameDict::lookupName (const string& name, bool create)
 {
     assert (uniqueNames);
 
-    StringToNameMap::iterator  iter = stringToName.find(&name);
-    if (iter != stringToName.end())
-        return iter->second;
+    OasisName**  onamep = stringToName.find(name);
+    if (onamep != Null)
+        return *onamep;
     if (! create)
         return Null;
 
@@ -103,15 +103,11 @@ RefNameDict::lookupName (const string& name, bool create)
     // is safely in allNames.  It should be removed from the auto_ptr
     // before being inserted in stringToName because there shouldn't be
     // two owners if operator[] throws an exception.
-    //
-    // Note that the key (a const string*) in the map stringToName should
-    // point to the string in the OasisName to ensure that it lives as
-    // long as the OasisName.
 
     auto_ptr<OasisName>  aon(new OasisName(name));
     allNames.push_back(aon.get());
     OasisName*  oname = aon.release();
-    stringToName[&oname->getName()] = oname;
+    stringToName[name] = oname;
     return oname;
 }
 
@@ -126,16 +122,14 @@ RefNameDict::lookupName (const string& name, bool create)
 OasisName*
 RefNameDict::lookupRefnum (Ulong refnum, bool create)
 {
-    RefnumToNameMap::iterator  iter = refnumToName.find(refnum);
-    if (iter != refnumToName.end())
-        return iter->second;
-    if (! create)
-        return Null;
+    OasisName*  oname = refnumToName.find(refnum);
+    if (oname != Null  ||  ! create)
+        return oname;
 
     auto_ptr<OasisName>  aon(new OasisName);
     allNames.push_back(aon.get());
-    OasisName*  oname = aon.release();
-    refnumToName[refnum] = oname;
+    oname = aon.release();
+    refnumToName.insert(refnum, oname);
     nameToRefnum[oname] = refnum;
     return oname;
 }
@@ -181,7 +175,7 @@ RefNameDict::doAdd (const string& name, Ulong refnum)
             return Null;        // new name already in use
         oname->setName(name);
         if (uniqueNames)
-            stringToName[&oname->getName()] = oname;
+            stringToName[name] = oname;
         return oname;
     }
 
@@ -193,12 +187,12 @@ RefNameDict::doAdd (const string& name, Ulong refnum)
         // we have now because the lookup for the new refnum failed
         // above.  So return Null to indicate a collision.
         //
-        if (nameToRefnum.find(oname) != nameToRefnum.end())
+        if (nameToRefnum.find(oname) != Null)
             return Null;
 
         // Set oname's refnum to the given value.
         nameToRefnum[oname] = refnum;
-        refnumToName[refnum] = oname;
+        refnumToName.insert(refnum, oname);
         return oname;
     }
 
@@ -209,9 +203,9 @@ RefNameDict::doAdd (const string& name, Ulong refnum)
     allNames.push_back(aon.get());
     oname = aon.release();
     if (uniqueNames)
-        stringToName[&oname->getName()] = oname;
+        stringToName[name] = oname;
     nameToRefnum[oname] = refnum;
-    refnumToName[refnum] = oname;
+    refnumToName.insert(refnum, oname);
     return oname;
 }
 
@@ -237,11 +231,11 @@ RefNameDict::doAdd (const string& name, Ulong refnum)
 bool
 RefNameDict::getRefnum (OasisName* oname, /*out*/ Ulong* refnump) const
 {
-    NameToRefnumMap::const_iterator  iter = nameToRefnum.find(oname);
-    if (iter == nameToRefnum.end())
+    const Ulong*  refp = nameToRefnum.find(oname);
+    if (refp == Null)
         return false;
 
-    *refnump = iter->second;
+    *refnump = *refp;
     return true;
 }
 
@@ -335,8 +329,7 @@ XNameDict::add (const string& name, Ulong refnum)
 XName*
 XNameDict::lookupRefnum (Ulong refnum)
 {
-    RefnumToNameMap::iterator  iter = refnumToName.find(refnum);
-    return (iter != refnumToName.end() ? iter->second : Null);
+    return refnumToName.find(refnum);
 }
 
 
@@ -366,7 +359,7 @@ XNameDict::doAdd (const string& name, Ulong refnum)
     auto_ptr<XName>  axn(new XName(name, refnum));
     allNames.push_back(axn.get());
     xname = axn.release();
-    refnumToName[refnum] = xname;
+    refnumToName.insert(refnum, xname);
     return xname;
 }
 
@@ -389,9 +382,9 @@ CellDict::~CellDict() { }
 Cell*
 CellDict::lookup (const CellName* cellName, bool create)
 {
-    CellMap::iterator  iter = nameToCell.find(cellName);
-    if (iter != nameToCell.end())
-        return iter->second;
+    Cell**  cellp = nameToCell.find(cellName);
+    if (cellp != Null)
+        return *cellp;
     if (! create)
         return Null;
 
@@ -31,7 +31,7 @@
 #include <string>
 #include <vector>
 
-#include "port/hash-table.h"
+#include "misc/flatmap.h"
 #include "misc/utils.h"
 #include "names.h"
 #include "oasis.h"
@@ -43,11 +43,9 @@ using std::string;
 using std::vector;
 using SoftJin::Uint;
 using SoftJin::Ulong;
-using SoftJin::HashMap;
-using SoftJin::hash;
-using SoftJin::HashCppStringPtr;
-using SoftJin::HashPointer;
-using SoftJin::CppStringPtrEqual;
+using SoftJin::IndexMap;
+using SoftJin::PointerMap;
+using SoftJin::StringMap;
 
 
 
@@ -191,16 +189,19 @@ OasisDict::containsPosition (OFilePos pos) const
 //
 // stringToName         StringToNameMap
 //      Used only when uniqueNames is true.  Used to locate an
-//      OasisName object given its name.  For speed we use a plain char*
-//      as the key, not a string object.  Because the characters in the
-//      key should last as long as the OasisName, the key should point
-//      to the contents of the string in the OasisName.
+//      OasisName object given its name.  This is an open-addressing
+//      table that keeps its own copy of each name in a StringPool, so
+//      a lookup compares against bytes stored next to one another
+//      instead of chasing a pointer to each candidate's string.
 //
 // refnumToName         RefnumToNameMap
-//      Used to get the OasisName object with a given refnum
+//      Used to get the OasisName object with a given refnum.  Refnums
+//      are usually numbered from 0 without gaps, so this is mostly a
+//      vector indexed by the refnum.  See IndexMap in misc/flatmap.h.
 //
 // nameToRefnum         NameToRefnumMap
-//      Used to get the refnum for a given OasisName.
+//      Used to get the refnum for a given OasisName.  An
+//      open-addressing table keyed by the OasisName pointer.
 //
 // Every name in the dictionary will be in allNames and in one or more
 // of the maps.  Note that an OasisName object may be temporarily
@@ -222,10 +223,9 @@ OasisDict::containsPosition (OFilePos pos) const
 
 class RefNameDict : public OasisDict {
 protected:
-    typedef  HashMap<Ulong, OasisName*>   RefnumToNameMap;
-    typedef  HashMap<OasisName*, Ulong, HashPointer>   NameToRefnumMap;
-    typedef  HashMap<const string*, OasisName*,
-                     HashCppStringPtr, CppStringPtrEqual>  StringToNameMap;
+    typedef  IndexMap<OasisName>        RefnumToNameMap;
+    typedef  PointerMap<Ulong>          NameToRefnumMap;
+    typedef  StringMap<OasisName*>      StringToNameMap;
 
 private:
     bool        uniqueNames;            // true for CellName, PropName
@@ -356,7 +356,7 @@ public:
 // nameToRefnum map because the refnums are stored in the XName objects.
 
 class XNameDict : public OasisDict {
-    typedef  HashMap<Ulong, XName*>   RefnumToNameMap;
+    typedef  IndexMap<XName>   RefnumToNameMap;
 
     bool        autoNumber;
     Ulong       nextRefnum;
@@ -394,7 +394,7 @@ private:
 // references a CELLNAME further down the file.
 
 class CellDict {
-    typedef HashMap<const CellName*, Cell*, HashPointer>  CellMap;
+    typedef PointerMap<Cell*>  CellMap;
 
     CellMap              nameToCell;
     PointerVector<Cell>  allCells;
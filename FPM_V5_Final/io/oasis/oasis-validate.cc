@@ -6,8 +6,12 @@
 // This software may be used only under the terms of the SoftJin
 // Source License.  See the accompanying file LICENSE for details.
 //
-// usage:  oasis-validate oasis-file
+// usage:  oasis-validate [-j threads] oasis-file
+//
+// With -j the CRC or checksum is computed in that many threads.  The
+// default is one thread per processor.
 
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <exception>
@@ -23,7 +27,7 @@ using namespace Oasis;
 
 static void
 UsageError() {
-    fprintf(stderr, "%s oasis-file\n", GetProgramName());
+    fprintf(stderr, "usage:  %s [-j threads] oasis-file\n", GetProgramName());
     exit(1);
 }
 
@@ -34,17 +38,44 @@ DisplayWarning (const char* msg) {
 }
 
 
+// DefaultThreadCount -- one validation thread per online processor
+
+static Uint
+DefaultThreadCount()
+{
+    long  ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return (ncpus > 1 ? (ncpus < 64 ? ncpus : 64) : 1);
+}
+
+
+
 int
 main (int argc, char* argv[])
 {
     SetProgramName(argv[0]);
-    if (argc != 2)
+
+    Uint  numThreads = DefaultThreadCount();
+    int  opt;
+    opterr = 0;
+    while ((opt = getopt(argc, argv, "j:")) != EOF) {
+        switch (opt) {
+            case 'j':
+                if (! isdigit(static_cast<Uchar>(*optarg)))
+                    UsageError();
+                numThreads = strtoul(optarg, Null, 10);
+                break;
+            default:
+                UsageError();
+        }
+    }
+    if (argc - optind != 1)
         UsageError();
 
     try {
         OasisParserOptions  parserOptions;
         parserOptions.strictConformance = false;
-        OasisParser  parser(argv[1], DisplayWarning, parserOptions);
+        parserOptions.validationThreads = numThreads;
+        OasisParser  parser(argv[optind], DisplayWarning, parserOptions);
         parser.validateFile();
 
         // validateFile() throws runtime_error if the validation fails.
@@ -40,6 +40,20 @@ using namespace SoftJin;
 const Ulong  MaxLong = LONG_MAX;
 
 
+// NeedsTwoPasses -- thrown when a single-pass parse cannot go on
+// parseCellName() throws this in single-pass mode if a CELLNAME record
+// names a cell that the file has already referred to both by name and
+// by reference-number.  The builder has seen both CellNames, so they
+// cannot be merged.  OasisParser::parseFile() catches it and parses the
+// file again with a name pass first.
+
+struct NeedsTwoPasses { };
+
+// Largest number of elements in an ElementBatch.  Bounds the memory
+// used for a batch while keeping the per-batch overhead negligible.
+const size_t  MaxBatchElements = 4096;
+
+
 // PropertyContext -- context in which PROPERTY record appears
 //
 // Appendix 2 of the spec defines some standard properties.  Each of
@@ -130,6 +144,19 @@ modvars             ModalVars
 
         The values of the modal variables.
 
+batching            bool
+
+        True if the builder's wantBatches() returned true at the start
+        of the parse.  parseRectangle() and parsePolygon() then collect
+        elements without properties in batch instead of invoking the
+        builder for each one.
+
+batch               ElementBatch
+
+        The elements collected but not yet passed to the builder.  It
+        is flushed by flushBatch() when an element that cannot join it
+        is seen, when it is full, and at the end of each cell.
+
 cellDict            CellDict
 
         Dictionary mapping CellName objects to Cell objects.  There is a
@@ -207,6 +234,14 @@ allNamesParsed      bool
         phase of parsing, in which only <name> records (and possibly
         CELL records) are parsed.  When this is true, encountering a
         record with an undefined reference-number is a fatal error.
+        In single-pass mode it remains false until parseFile() reaches
+        the END record, so that all records may make forward references.
+
+namesInline         bool
+
+        True while parseFile() parses the <name> records along with the
+        cells instead of in a separate first phase.  See the singlePass
+        option in parser.h.
 
 haveAllCellOffsets  bool
 
@@ -230,16 +265,19 @@ haveTableOffsets    bool
         dictionaries.  The START record has been parsed if this is true,
         regardless of which record contains the field.
 
-propValuesToCheck   vector<PropValue*>
+propValuesToCheck   vector<PendingPropValue>
 
         Property values that contain unresolved references to PROPSTRING
         records.  Property values of types 13, 14, and 15 contain a
         propstring-reference-number, where the propstring referred to is
         implied to be an a-string, b-string, or n-string respectively.
         But we can check the string only if the PROPSTRING record has
-        already been parsed.  If it hasn't, we append the PropValue
-        object to propValuesToCheck so that we can check the string
-        after all <name> records have been parsed.
+        already been parsed.  If it hasn't, we append the PropString
+        and the type of the value to propValuesToCheck so that we can
+        check the string after all <name> records have been parsed.
+        We do not keep the PropValue itself because in single-pass mode
+        it may belong to an element property that is deleted as soon as
+        the builder has seen it.
 
         Note that even if the PROPSTRING table is strict we cannot avoid
         forward references by parsing all PROPSTRING records first.  The
@@ -284,6 +322,8 @@ class ParserImpl {
     WarningHandler      warnHandler;    // callback for warning messages
     OasisBuilder*       builder;
     ModalVars           modvars;        // store all modal variables
+    bool                batching;       // builder wants ElementBatches
+    ElementBatch        batch;          // elements not yet passed to builder
 
     // Dictionaries for cells and the six types of names.
     CellDict            cellDict;       // map from CellName* to Cell*
@@ -307,10 +347,12 @@ class ParserImpl {
     OasisRecord*        currRecord;             // current record being parsed
     bool                rereadCurrRecord;       // T => record was unread
     bool                allNamesParsed;         // all <name> records parsed
+    bool                namesInline;            // single-pass parse active
     bool                haveAllCellOffsets;     // all CELL records parsed
     bool                haveValidation;         // parsed validation in END
     bool                haveTableOffsets;       // parsed table-offsets
-    vector<PropValue*>  propValuesToCheck;
+    typedef pair<PropString*, PropValueType>  PendingPropValue;
+    vector<PendingPropValue>  propValuesToCheck;
     string              filename;
     Ullong              fileSize;
     PropName*           separatorPropName;
@@ -323,6 +365,7 @@ public:
     Validation  parseValidation();
     void        parseFile (OasisBuilder* builder);
     bool        parseCell (const char* cellName, OasisBuilder* builder);
+    ParserImpl* makeTwoPassParser() const;
 
 private:
     // Low-level utility methods
@@ -348,6 +391,8 @@ private:
     // Name-parsing phase
 
     void        parseAllNames();
+    void        finishAllNames();
+    bool        canParseNamesInline();
     bool        canParseNamesDirectly();
     void        parseAllNamesDirectly();
     void        parseAllNamesSequentially();
@@ -402,6 +447,9 @@ private:
     void        parseCircle (const CircleRecord* recp);
     void        parseXElement (const XElementRecord* recp);
     void        parseXGeometry (const XGeometryRecord* recp);
+    bool        startBatchElement (ElementBatch::Kind kind,
+                                   Ulong layer, Ulong datatype);
+    void        flushBatch();
 
     // Parsing PROPERTY records
 
@@ -500,9 +548,11 @@ ParserImpl::ParserImpl (const char* fname, WarningHandler warner,
 {
     scanner.verifyMagic();      // abort unless file begins with magic string
     builder = Null;
+    batching = false;
     currRecord = Null;
     rereadCurrRecord = false;
     allNamesParsed = false;     // set by parseAllNames()
+    namesInline = false;        // set by parseFile() in single-pass mode
     haveAllCellOffsets = false;
     haveTableOffsets = false;   // set by parseTableOffsets()
     haveValidation = false;     // set by parseEndRecord(), but not always
@@ -518,6 +568,20 @@ ParserImpl::ParserImpl (const char* fname, WarningHandler warner,
 ParserImpl::~ParserImpl() { }
 
 
+
+// makeTwoPassParser -- a new parser for the same file without singlePass
+// OasisParser::parseFile() switches to it when this parser throws
+// NeedsTwoPasses.
+
+ParserImpl*
+ParserImpl::makeTwoPassParser() const
+{
+    OasisParserOptions  options = parserOptions;
+    options.singlePass = false;
+    return (new ParserImpl(filename.c_str(), warnHandler, options));
+}
+
+
 //----------------------------------------------------------------------
 //                       Low-level private methods
 //----------------------------------------------------------------------
@@ -693,7 +757,7 @@ ParserImpl::validateFile()
 
     recReader.setValidationWanted(true);
     parseStartAndEndRecords();
-    scanner.validateFile(fileValidation);
+    scanner.validateFile(fileValidation, parserOptions.validationThreads);
 }
 
 
@@ -728,10 +792,25 @@ ParserImpl::parseFile (OasisBuilder* builder)
     // See the entry on parser architecture in DesignNotes for why we
     // use two passes.  The offsets of the name tables are in either
     // the START record or the END record, so parse those first.
+    // In single-pass mode, skip the first pass if we would have to
+    // scan the whole file for it, and parse the <name> records as they
+    // come instead.
 
     this->builder = builder;
     parseStartAndEndRecords();
-    parseAllNames();
+
+    // If asked to, check the CRC/checksum in other threads while we
+    // parse.  fileValidation.scheme is None unless wantValidation is
+    // true, so beginValidation() does nothing then.
+
+    if (parserOptions.validationThreads > 0)
+        scanner.beginValidation(fileValidation,
+                                parserOptions.validationThreads);
+    namesInline = canParseNamesInline();
+    if (! namesInline)
+        parseAllNames();
+    batching = builder->wantBatches();
+    batch.init(ElementBatch::Rectangles, 0, 0);
 
     // Return to the beginning of the file for the second (main) pass,
     // in which we parse all the cells.
@@ -741,9 +820,11 @@ ParserImpl::parseFile (OasisBuilder* builder)
     builder->beginFile(fileVersion, fileUnit, fileValidation.scheme);
 
     // Pass all registered names in all the dictionaries to the builder
-    // by invoking its different registerFooName() methods.
+    // by invoking its different registerFooName() methods.  In
+    // single-pass mode we do not know the names yet.
 
-    registerAllNamesWithBuilder();
+    if (! namesInline)
+        registerAllNamesWithBuilder();
 
     // Parse the file-level properties, if any.  These must directly
     // follow the START record (spec 31.8).
@@ -765,42 +846,66 @@ ParserImpl::parseFile (OasisBuilder* builder)
             // parseAllNames() already parsed them.  But we still need to
             // detect stray records if we used the table strictness to
             // jump directly to the table to parse it (13.10).
+            // In single-pass mode this is the only time we see them.
 
             case RID_CELLNAME:
             case RID_CELLNAME_R:
-                checkStrayNameRecord(cellNameDict, orecp);
+                if (namesInline)
+                    parseCellName(static_cast<NameRecord*>(orecp));
+                else
+                    checkStrayNameRecord(cellNameDict, orecp);
                 break;
 
             case RID_TEXTSTRING:
             case RID_TEXTSTRING_R:
-                if (parserOptions.wantText)
+                if (! parserOptions.wantText)
+                    break;
+                if (namesInline)
+                    parseTextString(static_cast<NameRecord*>(orecp));
+                else
                     checkStrayNameRecord(textStringDict, orecp);
                 break;
 
             case RID_PROPNAME:
             case RID_PROPNAME_R:
-                checkStrayNameRecord(propNameDict, orecp);
+                if (namesInline)
+                    parsePropName(static_cast<NameRecord*>(orecp));
+                else
+                    checkStrayNameRecord(propNameDict, orecp);
                 break;
 
             case RID_PROPSTRING:
             case RID_PROPSTRING_R:
-                checkStrayNameRecord(propStringDict, orecp);
+                if (namesInline)
+                    parsePropString(static_cast<NameRecord*>(orecp));
+                else
+                    checkStrayNameRecord(propStringDict, orecp);
                 break;
 
             case RID_LAYERNAME_GEOMETRY:
             case RID_LAYERNAME_TEXT:
-                if (parserOptions.wantLayerName)
+                if (! parserOptions.wantLayerName)
+                    break;
+                if (namesInline)
+                    parseLayerName(static_cast<LayerNameRecord*>(orecp));
+                else
                     checkStrayNameRecord(layerNameDict, orecp);
                 break;
 
             case RID_XNAME:
             case RID_XNAME_R:
-                if (parserOptions.wantExtensions)
+                if (! parserOptions.wantExtensions)
+                    break;
+                if (namesInline)
+                    parseXName(static_cast<XNameRecord*>(orecp));
+                else
                     checkStrayNameRecord(xnameDict, orecp);
                 break;
 
             // Ignore PROPERTY records seen here.  They can belong only
-            // to <name> records, so we have already parsed them.
+            // to <name> records, so we have already parsed them.  (In
+            // single-pass mode, the parseFooName() methods above parse
+            // them.  Those we see here belong to ignored <name> records.)
 
             case RID_PROPERTY:
             case RID_PROPERTY_REPEAT:
@@ -811,7 +916,18 @@ ParserImpl::parseFile (OasisBuilder* builder)
         }
     }
     haveAllCellOffsets = true;
+
+    // In single-pass mode we now have all the names.  Do the checks we
+    // would have done at the end of the first pass and give the
+    // builder the names.
+
+    if (namesInline) {
+        finishAllNames();
+        namesInline = false;
+        registerAllNamesWithBuilder();
+    }
     builder->endFile();
+    scanner.endValidation();
 }
 
 
@@ -876,6 +992,8 @@ ParserImpl::parseCell (const char* name, OasisBuilder* builder)
         abortParser("cell %s does not begin with CELL record", name);
 
     this->builder = builder;
+    batching = builder->wantBatches();
+    batch.init(ElementBatch::Rectangles, 0, 0);
     parseCell(static_cast<CellRecord*>(orecp));
     return true;
 }
@@ -1098,7 +1216,18 @@ ParserImpl::parseAllNames()
         parseAllNamesDirectly();
     else
         parseAllNamesSequentially();
+    finishAllNames();
+}
+
+
 
+// finishAllNames -- checks to make after all <name> records are parsed.
+// Called at the end of the first phase, or at the END record when
+// parseFile() parses the names along with everything else.
+
+void
+ParserImpl::finishAllNames()
+{
     // Reset currRecord and rereadCurrRecord.  We don't want
     // abortParser() to print some random record as the context if any
     // of the calls below results in an abort.
@@ -1131,6 +1260,24 @@ ParserImpl::parseAllNames()
 
 
 
+// canParseNamesInline -- true if parseFile() should not make a name pass.
+// We parse <name> records along with the cells only if the application
+// asked for it and the first pass would have to scan the whole file.
+// The first pass is also needed for strictConformance, because
+// parsePropertiesForBuilder() checks standard properties by name as
+// soon as it parses them, and the name may not be known yet.
+
+bool
+ParserImpl::canParseNamesInline()
+{
+    return (parserOptions.singlePass
+            &&  ! parserOptions.strictConformance
+            &&  ! allNamesParsed
+            &&  ! canParseNamesDirectly());
+}
+
+
+
 // canParseNamesDirectly -- true iff all name tables we care about are strict
 
 bool
@@ -1319,6 +1466,19 @@ ParserImpl::verifyAllNamesDefined()
                         propStringDict.getRefnum(propString));
     }
 
+    // Verify that every TextString has been defined by a TEXTSTRING
+    // record.  Only TEXT records parsed in single-pass mode can make
+    // forward references to TEXTSTRINGs.
+
+    TextStringDict::iterator  textIter = textStringDict.begin();
+    TextStringDict::iterator  textEnd  = textStringDict.end();
+    for ( ;  textIter != textEnd;  ++textIter) {
+        TextString*  textString = *textIter;
+        if (! textString->hasName())
+            abortParser("TEXTSTRING reference-number %lu not defined",
+                        textStringDict.getRefnum(textString));
+    }
+
     // Verify that every CellName has been defined by a CELLNAME record.
 
     CellNameDict::iterator  cellNameIter = cellNameDict.begin();
@@ -1467,16 +1627,16 @@ ParserImpl::checkStdNameProperties (const OasisName* oname,
 void
 ParserImpl::checkPropertyValues()
 {
-    vector<PropValue*>::iterator  valIter = propValuesToCheck.begin();
-    vector<PropValue*>::iterator  valEnd  = propValuesToCheck.end();
+    vector<PendingPropValue>::iterator  valIter = propValuesToCheck.begin();
+    vector<PendingPropValue>::iterator  valEnd  = propValuesToCheck.end();
     for ( ;  valIter != valEnd;  ++valIter) {
-        PropValue*  propval = *valIter;
-        switch (propval->getType()) {
+        const PropString*  propString = valIter->first;
+        switch (valIter->second) {
             case PV_Ref_AsciiString:
-                verifyStringIsAscii(propval->getStringValue());
+                verifyStringIsAscii(propString->getName());
                 break;
             case PV_Ref_NameString:
-                verifyStringIsName(propval->getStringValue());
+                verifyStringIsName(propString->getName());
                 break;
             default:    // avoid complaints from gcc about unused enumerators
                 break;
@@ -1486,7 +1646,7 @@ ParserImpl::checkPropertyValues()
     // The contents of propValuesToCheck are no longer needed.
     // Clear it and free the vector's internal array.
 
-    vector<PropValue*>().swap(propValuesToCheck);
+    vector<PendingPropValue>().swap(propValuesToCheck);
 }
 
 
@@ -1724,15 +1884,26 @@ ParserImpl::parseCellName (NameRecord* recp)
     // This check is needed only when the refnum is explicit, because
     // only then can different CELLNAME records refer to the same name.
 
+    // In single-pass mode add() also fails if the cell was referred to
+    // both by name and by the refnum earlier.  Start over with two
+    // passes; if the name really is a duplicate, the second parse says
+    // so.
+
     CellName*  cellName;
     verifyStringIsName(recp->name);
     if (recp->recID == RID_CELLNAME) {
-        if ((cellName = cellNameDict.add(recp->name)) == Null)
+        if ((cellName = cellNameDict.add(recp->name)) == Null) {
+            if (namesInline)
+                throw NeedsTwoPasses();
             abortParser("duplicate name '%s'", recp->name.c_str());
+        }
     } else {
-        if ((cellName = cellNameDict.add(recp->name, recp->refnum)) == Null)
+        if ((cellName = cellNameDict.add(recp->name, recp->refnum)) == Null) {
+            if (namesInline)
+                throw NeedsTwoPasses();
             abortParser("duplicate name '%s' or reference-number %lu",
                         recp->name.c_str(), recp->refnum);
+        }
         if (! cellName->getPropertyList().empty()) {
             auto_ptr<Property>  sep(new Property(separatorPropName, false));
             sep->addValue(PV_UnsignedInteger, 0ull);    // dummy
@@ -1989,10 +2160,15 @@ ParserImpl::parseCell (CellRecord* recp)
     //                CTRAPEZOID | CIRCLE | XGEOMETRY
 
     // The parsing function for each element also parses the property
-    // records that follow the element record.
+    // records that follow the element record.  When batching, pending
+    // rectangles and polygons must reach the builder before anything
+    // that follows them.
 
     for (;;) {
         OasisRecord*  orecp = readNextRecord();
+        if (! batch.empty()  &&  orecp->recID != RID_RECTANGLE
+                             &&  orecp->recID != RID_POLYGON)
+            flushBatch();
         switch (orecp->recID) {
             case RID_XYABSOLUTE:  xyRelative(false);    break;
             case RID_XYRELATIVE:  xyRelative(true);     break;
@@ -2407,6 +2583,12 @@ ParserImpl::parseRectangle (const RectangleRecord* recp)
     long  y        = getGeometryY      (infoByte & YBit,      recp->y);
     const Repetition* rep = getRepetition (infoByte & RepBit, recp->rawrep);
 
+    if (batching
+          &&  startBatchElement(ElementBatch::Rectangles, layer, datatype)) {
+        batch.addRectangle(x, y, width, height, rep,
+                           recp->rawrep.repType == Rep_ReusePrevious);
+        return;
+    }
     builder->beginRectangle(layer, datatype, x, y, width, height, rep);
     parsePropertiesForBuilder(PC_Element);
     builder->endElement();
@@ -2438,6 +2620,12 @@ ParserImpl::parsePolygon (const PolygonRecord* recp)
     long  y         = getGeometryY (infoByte & YBit,        recp->y);
     const Repetition* rep = getRepetition (infoByte & RepBit, recp->rawrep);
 
+    if (batching
+          &&  startBatchElement(ElementBatch::Polygons, layer, datatype)) {
+        batch.addPolygon(x, y, ptlist, rep,
+                         recp->rawrep.repType == Rep_ReusePrevious);
+        return;
+    }
     builder->beginPolygon(layer, datatype, x, y, ptlist, rep);
     parsePropertiesForBuilder(PC_Element);
     builder->endElement();
@@ -2445,6 +2633,50 @@ ParserImpl::parsePolygon (const PolygonRecord* recp)
 
 
 
+// startBatchElement -- prepare to add the element just parsed to batch
+//   kind, layer, datatype      describe the element
+// Returns true if the caller should add the element to batch, false if
+// the element has properties and must be passed to the builder by
+// itself.  Flushes the batch if the element cannot join it.
+//
+// The element's properties, if any, are in the following records.  We
+// peek at the next record to find out.  The caller has already fetched
+// everything it needs from its own record.
+
+bool
+ParserImpl::startBatchElement (ElementBatch::Kind kind,
+                               Ulong layer, Ulong datatype)
+{
+    if (! batch.accepts(kind, layer, datatype)
+            ||  batch.size() >= MaxBatchElements)
+        flushBatch();
+
+    bool  hasProperties = IsPropertyRecord(readNextRecord());
+    unreadLastRecord();
+    if (hasProperties) {
+        flushBatch();
+        return false;
+    }
+    if (batch.empty())
+        batch.init(kind, layer, datatype);
+    return true;
+}
+
+
+
+// flushBatch -- pass the collected elements, if any, to the builder.
+
+void
+ParserImpl::flushBatch()
+{
+    if (batch.empty())
+        return;
+    builder->addElements(batch);
+    batch.init(batch.kind, batch.layer, batch.datatype);
+}
+
+
+
 void
 ParserImpl::parsePath (const PathRecord* recp)
 {
@@ -2960,7 +3192,7 @@ ParserImpl::fixPropValue (/*inout*/ PropValue* propval)
             // If we know the string (the PROPSTRING record has been
             // parsed), verify that it really is an a-string or an
             // n-string if the type of property value indicates that it
-            // is.  Otherwise save propval in propValuesToCheck; we will
+            // is.  Otherwise note the value in propValuesToCheck; we will
             // check it after we have parsed all <name> records.
 
             if (propString->hasName()) {
@@ -2969,7 +3201,8 @@ ParserImpl::fixPropValue (/*inout*/ PropValue* propval)
                 else if (valType == PV_Ref_NameString)
                     verifyStringIsName(propString->getName());
             } else {
-                propValuesToCheck.push_back(propval);
+                propValuesToCheck.push_back(PendingPropValue(propString,
+                                                             valType));
             }
             break;
         }
@@ -3859,7 +4092,9 @@ ParserImpl::getPlacementCell (bool isExplicit, bool isRefnum,
 
     if (isExplicit) {
         if (isRefnum) {
-            if ((cellName = cellNameDict.lookupRefnum(refnum, false)) == Null)
+            // Forward references are possible only in single-pass mode.
+            cellName = cellNameDict.lookupRefnum(refnum, !allNamesParsed);
+            if (cellName == Null)
                 abortParser("reference-number %lu not defined", refnum);
         } else {
             // 13.10
@@ -3903,9 +4138,10 @@ ParserImpl::getTextString (bool isExplicit, bool isRefnum,
 
     // If the TEXT record has a refnum, we must have a TextString object
     // with that refnum.  There cannot be forward references because
-    // TEXT records are parsed only after all names have been parsed.
-    // Hence the `false' argument to lookupRefnum(), meaning "if it
-    // doesn't exist, don't create it".
+    // TEXT records are parsed only after all names have been parsed,
+    // except in single-pass mode.  Hence the `!allNamesParsed' argument
+    // to lookupRefnum(), meaning "if it doesn't exist, don't create it"
+    // except when a placeholder is needed for a forward reference.
     //
     // If the TEXT record has a string, and it's okay to have one,
     // create an unregistered TextString object.  This object will not
@@ -3915,7 +4151,7 @@ ParserImpl::getTextString (bool isExplicit, bool isRefnum,
 
     if (isExplicit) {
         if (isRefnum) {
-            textString = textStringDict.lookupRefnum(refnum, false);
+            textString = textStringDict.lookupRefnum(refnum, !allNamesParsed);
             if (textString == Null)
                 abortParser("reference-number %lu not defined", refnum);
         } else {
@@ -4329,9 +4565,21 @@ OasisParser::parseValidation() {
 }
 
 
+// parseFile -- parse the whole file
+// If a single-pass parse gives up, replace impl by a parser that makes
+// two passes and parse the file again with that.
+
 void
-OasisParser::parseFile (OasisBuilder* builder) {
-    impl->parseFile(builder);
+OasisParser::parseFile (OasisBuilder* builder)
+{
+    try {
+        impl->parseFile(builder);
+    } catch (const NeedsTwoPasses&) {
+        ParserImpl*  twoPass = impl->makeTwoPassParser();
+        delete impl;
+        impl = twoPass;
+        impl->parseFile(builder);
+    }
 }
 
 
@@ -14,6 +14,7 @@
 
 namespace Oasis {
 
+using SoftJin::Uint;
 using SoftJin::WarningHandler;
 
 
@@ -52,6 +53,16 @@ using SoftJin::WarningHandler;
 // exactly 256 bytes before the end of the file as the spec requires,
 // and need not contain anything but the record ID.
 //
+// validationThreads is the number of threads used to compute the file's
+// CRC or checksum.  If it is 0, validateFile() computes the signature
+// in the calling thread and parseFile() does not check it.  If it is
+// positive, validateFile() splits the file among that many threads,
+// and if wantValidation is also true, parseFile() checks the signature
+// too: it starts the threads before parsing and waits for them at the
+// END record, so that on a multi-core machine the check costs little
+// extra time.  parseFile() throws runtime_error if the signature is
+// wrong, but only after passing the whole file to the builder.
+//
 // The flags wantText, wantLayerName, and wantExtensions specify whether
 // the parser should parse TEXT, TEXTSTRING, LAYERNAME, and extension
 // records (and any following PROPERTY records).  Applications that are
@@ -65,6 +76,22 @@ using SoftJin::WarningHandler;
 // corresponding table is strict because it is going to ignore those
 // records.  The name-parsing pass can thus be avoided in some cases.
 //
+// The flag singlePass lets the parser skip the preliminary pass for
+// <name> records.  Set it only if the builder does not need names
+// during the parse.  In this mode forward references to CELLNAME,
+// TEXTSTRING, PROPNAME and PROPSTRING records are passed to the
+// builder as nameless placeholders.  The names are filled in when the
+// <name> records are parsed, and the registerFooName() methods are
+// invoked just before endFile() rather than before the first cell.
+// The parser ignores the flag and makes two passes anyway if the name
+// tables it needs are strict or if strictConformance is true.  It also
+// ignores the flag in parseCell().  A file that refers to a cell by name
+// and also by a reference-number defined later cannot be parsed in a
+// single pass.  When the parser finds such a cell it starts over from
+// the beginning with the name pass.  The builder then gets beginFile()
+// a second time, and must discard everything it was given before that.
+// See DesignNotes.
+//
 // If any of the wantFoo flags is false, most validity checks on the
 // corresponding records are dropped, even if strictConformance is true.
 // For example, if wantText is false the parser does not verify that at
@@ -81,6 +108,8 @@ struct OasisParserOptions {
     bool  wantText;             // false => ignore TEXT and TEXTSTRING
     bool  wantLayerName;        // false => ignore LAYERNAME
     bool  wantExtensions;       // false => ignore XNAME, XELEMENT, XGEOMETRY
+    bool  singlePass;           // true => no separate pass for <name> records
+    Uint  validationThreads;    // > 0 => compute CRC/checksum in threads
 
 public:
     OasisParserOptions() {
@@ -89,6 +118,8 @@ public:
         wantText = true;
         wantLayerName = true;
         wantExtensions = true;
+        singlePass = false;
+        validationThreads = 0;
     }
 
     void
@@ -98,6 +129,8 @@ public:
         wantText = false;
         wantLayerName = false;
         wantExtensions = false;
+        singlePass = false;
+        validationThreads = 0;
     }
 };
 
@@ -6,6 +6,7 @@
 // This software may be used only under the terms of the SoftJin
 // Source License.  See the accompanying file LICENSE for details.
 
+#include <algorithm>            // for min
 #include <cassert>
 #include <cstdarg>
 #include <cstdio>
@@ -1064,24 +1065,44 @@ OasisRecordReader::readPointList (/*out*/ PointList* ptlist)
 
     // Then come the deltas for the points.  The form of the delta (1-delta,
     // 2-delta, etc.) depends on the list type.
+    //
+    // 1-deltas, 2-deltas and 3-deltas are single integers.  Read them in
+    // chunks with the scanner's run readers, which convert runs of
+    // one-byte integers 8 at a time, and then decode each chunk.
+
+    const Ulong  ChunkSize = 64;
+    long   svals[ChunkSize];
+    Ulong  uvals[ChunkSize];
 
     switch (ltype) {
         case PointList::ManhattanHorizFirst:
         case PointList::ManhattanVertFirst:
             // In the raw point-list, store 1-deltas in the x member
             // regardless of whether it's an X offset or Y offset.
-            for (Ulong j = 0;  j < numDeltas;  ++j)
-                ptlist->addPoint(Delta(scanner.readOneDelta(), 0));
+            for (Ulong j = 0;  j < numDeltas;  j += ChunkSize) {
+                Ulong  n = min(ChunkSize, numDeltas - j);
+                scanner.readSignedIntegers(svals, n);
+                for (Ulong k = 0;  k < n;  ++k)
+                    ptlist->addPoint(Delta(svals[k], 0));
+            }
             break;
 
         case PointList::Manhattan:
-            for (Ulong j = 0;  j < numDeltas;  ++j)
-                ptlist->addPoint(scanner.readTwoDelta());
+            for (Ulong j = 0;  j < numDeltas;  j += ChunkSize) {
+                Ulong  n = min(ChunkSize, numDeltas - j);
+                scanner.readUnsignedIntegers(uvals, n);
+                for (Ulong k = 0;  k < n;  ++k)
+                    ptlist->addPoint(OasisScanner::decodeTwoDelta(uvals[k]));
+            }
             break;
 
         case PointList::Octangular:
-            for (Ulong j = 0;  j < numDeltas;  ++j)
-                ptlist->addPoint(scanner.readThreeDelta());
+            for (Ulong j = 0;  j < numDeltas;  j += ChunkSize) {
+                Ulong  n = min(ChunkSize, numDeltas - j);
+                scanner.readUnsignedIntegers(uvals, n);
+                for (Ulong k = 0;  k < n;  ++k)
+                    ptlist->addPoint(OasisScanner::decodeThreeDelta(uvals[k]));
+            }
             break;
 
         // Both AllAngle and AllAngleDoubleDelta have a sequence of
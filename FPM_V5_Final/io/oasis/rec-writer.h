@@ -39,7 +39,7 @@ public:
     void        endFile();
     void        endCblock();
     void        writeRecord (const OasisRecord* orecp);
-    off_t       currFileOffset() const;
+    off_t       currFileOffset();
 
 private:
     void        writeSInt (long val);
@@ -93,7 +93,7 @@ private:
 // Precondition: the writer is not in a cblock.
 
 inline off_t
-OasisRecordWriter::currFileOffset() const {
+OasisRecordWriter::currFileOffset() {
     return writer.currFileOffset();
 }
 
@@ -119,6 +119,7 @@ OasisScanner::OasisScanner (const char* fname, WarningHandler warner)
     fileOffset = 0;
     inflater = Null;
     decompressor = Null;
+    fileSignature = Null;
 
     // decompressBlock() allocates cblockBuf's buffer when the first
     // cblock is seen.  The following members are defined only in a
@@ -130,6 +131,7 @@ OasisScanner::OasisScanner (const char* fname, WarningHandler warner)
 
 OasisScanner::~OasisScanner()
 {
+    delete fileSignature;       // stops its threads before fdin is closed
     close(fdin);
     delete inflater;
 }
@@ -153,14 +155,6 @@ OasisScanner::setBuffer (ReadBuffer<char>& buf) {
 }
 
 
-// availData -- return number of characters remaining in the current buffer
-
-inline size_t
-OasisScanner::availData() const {
-    return (dataEnd - data);
-}
-
-
 // bufferIsEmpty -- true if the current buffer is empty (availData() == 0)
 
 inline bool
@@ -318,16 +312,25 @@ OasisScanner::eof()
 
 // validateFile -- compute validation signature and check against input value.
 //   val        validation scheme and signature stored in file
+//   numThreads number of threads to compute the signature in.
+//              0 means compute it in this thread.
 // Aborts the scanner if the computed signature does not match the input
-// value.  Leaves the file pointer at the end of the file.
+// value.  If numThreads is 0, leaves the file pointer at the end of the
+// file; otherwise leaves it where it was.
 
 void
-OasisScanner::validateFile (const Validation& val)
+OasisScanner::validateFile (const Validation& val, Uint numThreads)
 {
     // Nothing to do if the file has no validation.
     if (val.scheme == Validation::None)
         return;
 
+    if (numThreads > 0) {
+        beginValidation(val, numThreads);
+        endValidation();
+        return;
+    }
+
     // Instantiate the appropriate strategy class for the validation
     // scheme.  We delegate computing the signature to this class.
 
@@ -369,6 +372,58 @@ OasisScanner::validateFile (const Validation& val)
 }
 
 
+// beginValidation -- start computing validation signature in other threads
+//   val        validation scheme and signature stored in file
+//   numThreads number of threads to use; must be positive
+//
+// The threads read the file independently of the scanner, so the
+// caller may go on scanning while they work.  endValidation() waits
+// for them and checks the signature.  If endValidation() is never
+// called, the destructor stops the threads.
+
+void
+OasisScanner::beginValidation (const Validation& val, Uint numThreads)
+{
+    assert (numThreads > 0);
+
+    // Forget any validation left over from a parse that was aborted.
+    delete fileSignature;
+    fileSignature = Null;
+    if (val.scheme == Validation::None)
+        return;
+
+    // The signature covers everything except its own 4 bytes at the
+    // end of the file.  See validateFile() above.
+
+    expectedValidation = val;
+    fileSignature = new FileSignature(fdin, getFileSize() - 4, val.scheme,
+                                      numThreads, filename.c_str());
+}
+
+
+
+// endValidation -- finish the validation started by beginValidation()
+// Aborts the scanner if the computed signature does not match the input
+// value.  Does nothing if beginValidation() was not called or if the
+// file has no validation.
+
+void
+OasisScanner::endValidation()
+{
+    if (fileSignature == Null)
+        return;
+
+    auto_ptr<FileSignature>  fsig(fileSignature);
+    fileSignature = Null;
+    uint32_t  sig = fsig->getSignature();
+    if (sig != expectedValidation.signature) {
+        abortScanner("file is corrupted: %s is 0x%08x; should be 0x%08x",
+                     expectedValidation.schemeName(), sig,
+                     expectedValidation.signature);
+    }
+}
+
+
 //----------------------------------------------------------------------
 // CBLOCKs
 
@@ -644,11 +699,13 @@ OasisScanner::verifyMagic()
 
 
 
-// readUnsignedInteger -- read an unsigned-integer
+// readUnsignedIntegerSlow -- read an unsigned-integer a byte at a time
 // Spec paragraph 7.2.1
+// This is the readUnsignedInteger() path for integers the word-at-a-time
+// fast path in scanner.h does not take.
 
 Ulong
-OasisScanner::readUnsignedInteger()
+OasisScanner::readUnsignedIntegerSlow()
 {
     const Uint  MaxShift = numeric_limits<Ulong>::digits - 1;
         // Shifting by more than this is undefined.  E.g., on a 32-bit
@@ -713,11 +770,13 @@ OasisScanner::readUnsignedInteger()
 
 
 
-// readSignedInteger -- read a signed-integer
+// readSignedIntegerSlow -- read a signed-integer a byte at a time
 // Spec paragraph 7.2.2
+// Like readUnsignedIntegerSlow(), this is the fallback for the fast
+// path of readSignedInteger().
 
 long
-OasisScanner::readSignedInteger()
+OasisScanner::readSignedIntegerSlow()
 {
     const Uint  MaxShift       = numeric_limits<Ulong>::digits - 1;
     const Uint  SafeShiftLimit = numeric_limits<Ulong>::digits - 7;
@@ -776,6 +835,69 @@ OasisScanner::readSignedInteger()
 }
 
 
+//----------------------------------------------------------------------
+// Read runs of integers.
+//
+// readUnsignedIntegers() and readSignedIntegers() read count integers
+// into vals.  They are used for the deltas of point-lists.  In
+// Manhattan point-lists with short edges most deltas fit in one byte,
+// so before falling back to readUnsignedInteger() or
+// readSignedInteger() they check whether the next 8 bytes are 8
+// one-byte integers, i.e., whether none of them has its continuation
+// bit set, and if so convert all 8 at once.
+
+
+void
+OasisScanner::readUnsignedIntegers (/*out*/ Ulong* vals, size_t count)
+{
+    while (count > 0) {
+#ifdef SJ_LITTLE_ENDIAN
+        if (count >= 8  &&  availData() >= 8) {
+            Ullong  word;
+            memcpy(&word, data, 8);
+            if ((word & 0x8080808080808080ULL) == 0) {
+                for (int j = 0;  j < 8;  ++j, word >>= 8)
+                    vals[j] = word & 0x7f;
+                data += 8;
+                vals += 8;
+                count -= 8;
+                continue;
+            }
+        }
+#endif
+        *vals++ = readUnsignedInteger();
+        --count;
+    }
+}
+
+
+
+void
+OasisScanner::readSignedIntegers (/*out*/ long* vals, size_t count)
+{
+    while (count > 0) {
+#ifdef SJ_LITTLE_ENDIAN
+        if (count >= 8  &&  availData() >= 8) {
+            Ullong  word;
+            memcpy(&word, data, 8);
+            if ((word & 0x8080808080808080ULL) == 0) {
+                for (int j = 0;  j < 8;  ++j, word >>= 8) {
+                    long  val = (word & 0x7f) >> 1;
+                    vals[j] = (word & 0x1) ? -val : val;
+                }
+                data += 8;
+                vals += 8;
+                count -= 8;
+                continue;
+            }
+        }
+#endif
+        *vals++ = readSignedInteger();
+        --count;
+    }
+}
+
+
 //----------------------------------------------------------------------
 // Read unsigned and signed integers with at least 64 bits.
 //
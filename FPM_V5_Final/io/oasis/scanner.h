@@ -13,8 +13,13 @@
 #define OASIS_SCANNER_H_INCLUDED
 
 #include <inttypes.h>           // for uint32_t
+#include <cstring>              // for memcpy
+#include <limits>
 #include <string>
 #include <sys/types.h>          // for off_t
+#ifdef __BMI2__
+#  include <immintrin.h>        // for _pext_u64
+#endif
 
 #include "port/compiler.h"
 #include "misc/buffer.h"
@@ -36,6 +41,7 @@ using SoftJin::WarningHandler;
 
 class ZlibInflater;             // from compressor.h
 class Decompressor;             // from compressor.h
+class FileSignature;            // from validator.h
 
 
 
@@ -114,6 +120,15 @@ Data members
         we have yet to get from the decompressor.
 
 
+    fileSignature       FileSignature*
+        Null, or the owning pointer to the threads computing the file's
+        validation signature.  beginValidation() creates it and
+        endValidation() deletes it.
+
+    expectedValidation  Validation
+        The validation passed to beginValidation().  Defined only
+        when fileSignature != Null.
+
     fdin                int
         File descriptor opened for reading from the input file.
 
@@ -158,6 +173,10 @@ class OasisScanner {
     Ullong      uncompBytesLeft;        // num bytes decompressor yet to give
     Ullong      compBytesLeft;          // num bytes yet to give decompressor
 
+    // Validation in other threads
+    FileSignature*  fileSignature;      // Null or threads computing CRC
+    Validation  expectedValidation;     // from END record
+
     int         fdin;                   // file descriptor opened for reading
     string      filename;               // pathname of file being read
     WarningHandler  warnHandler;        // callback for warning messages
@@ -170,7 +189,9 @@ public:
     void        seekTo (off_t offset);
     off_t       getFileSize();
     bool        eof();
-    void        validateFile (const Validation& val);
+    void        validateFile (const Validation& val, Uint numThreads);
+    void        beginValidation (const Validation& val, Uint numThreads);
+    void        endValidation();
     void        decompressBlock (Ulong compType,
                                  Ullong uncomBytes, Ullong compBytes);
     int         peekByte();
@@ -181,6 +202,8 @@ public:
     void        verifyMagic();
     Ulong       readUnsignedInteger();
     long        readSignedInteger();
+    void        readUnsignedIntegers (/*out*/ Ulong* vals, size_t count);
+    void        readSignedIntegers (/*out*/ long* vals, size_t count);
     Ullong      readUnsignedInteger64();
     llong       readSignedInteger64();
     uint32_t    readValidationSignature();
@@ -194,6 +217,9 @@ public:
     Delta       readThreeDelta();
     Delta       readGDelta();
 
+    static Delta  decodeTwoDelta (Ulong val);
+    static Delta  decodeThreeDelta (Ulong val);
+
 private:
     bool        readingFromCblock() const;
     void        setBuffer (ReadBuffer<char>& buf);
@@ -203,6 +229,10 @@ private:
     void        fillFileBuffer();
     void        fillBuffer();
     void        fillCblockBuffer();
+    bool        fetchShortInteger (/*out*/ Ulong* bits);
+    static Ullong  gatherIntegerBits (Ullong word);
+    Ulong       readUnsignedIntegerSlow();
+    long        readSignedIntegerSlow();
     void        getCurrBytePosition (/*out*/ OFilePos* bytePos) const;
     Uint        formatContext (/*out*/ char* buf, Uint bufsize);
     void        warn (const char* fmt, ...)  SJ_PRINTF_ARGS(2,3);
@@ -215,6 +245,120 @@ private:
 
 
 
+// availData -- return number of characters remaining in the current buffer
+
+inline size_t
+OasisScanner::availData() const {
+    return (dataEnd - data);
+}
+
+
+
+//----------------------------------------------------------------------
+// Reading integers a word at a time
+//
+// Most integers in an OASIS file -- coordinates, deltas, counts and
+// reference numbers -- take only a few bytes.  When at least 8 bytes
+// are left in the buffer, fetchShortInteger() copies them into a 64-bit
+// word, finds the first byte whose continuation bit is clear, and
+// gathers the 7-bit groups of the bytes up to it with a fixed sequence
+// of masks and shifts (or one pext instruction when compiled for BMI2).
+// There is no loop, and no check for an empty buffer per byte.
+//
+// Longer integers and integers at the end of the buffer are left to
+// readUnsignedIntegerSlow() and readSignedIntegerSlow(), which read
+// them a byte at a time and check for overflow.  The fast path takes
+// at most 8 bytes (4 if Ulong has 32 bits), which cannot overflow a
+// Ulong, or a long once the sign bit of a signed-integer is removed.
+
+
+// gatherIntegerBits -- pack the low 7 bits of each byte of word
+// The bits of byte i end up in bits 7i..7i+6 of the result.
+
+inline Ullong
+OasisScanner::gatherIntegerBits (Ullong word)
+{
+#ifdef __BMI2__
+    return _pext_u64(word, 0x7f7f7f7f7f7f7f7fULL);
+#else
+    word &= 0x7f7f7f7f7f7f7f7fULL;
+    word = (word & 0x007f007f007f007fULL) | ((word & 0x7f007f007f007f00ULL) >> 1);
+    word = (word & 0x00003fff00003fffULL) | ((word & 0x3fff00003fff0000ULL) >> 2);
+    word = (word & 0x000000000fffffffULL) | ((word & 0x0fffffff00000000ULL) >> 4);
+    return word;
+#endif
+}
+
+
+
+// fetchShortInteger -- try to read an integer's data bits from one word
+// Returns false without consuming anything if the integer cannot be
+// read by the fast path.  Otherwise stores in *bits the concatenated
+// 7-bit groups of the integer, which for a signed-integer still include
+// the sign bit, and returns true.
+
+inline bool
+OasisScanner::fetchShortInteger (/*out*/ Ulong* bits)
+{
+#ifdef SJ_LITTLE_ENDIAN
+    const Uint  FastIntegerBytes =
+                (std::numeric_limits<Ulong>::digits >= 64 ? 8 : 4);
+
+    if (availData() < 8)
+        return false;
+    Ullong  word;
+    memcpy(&word, data, 8);
+
+    // The integer ends at the first byte with its high bit clear.
+    Ullong  stops = ~word & 0x8080808080808080ULL;
+    if (stops == 0)
+        return false;
+    Uint  nbytes = SJ_CTZ64(stops)/8 + 1;
+    if (nbytes > FastIntegerBytes)
+        return false;
+
+    data += nbytes;
+    *bits = gatherIntegerBits(word & (~0ULL >> (64 - 8*nbytes)));
+    return true;
+#else
+    (void) bits;
+    return false;
+#endif
+}
+
+
+
+// readUnsignedInteger -- read an unsigned-integer
+// Spec paragraph 7.2.1
+
+inline Ulong
+OasisScanner::readUnsignedInteger()
+{
+    Ulong  val;
+    if (fetchShortInteger(&val))
+        return val;
+    return (readUnsignedIntegerSlow());
+}
+
+
+
+// readSignedInteger -- read a signed-integer
+// Spec paragraph 7.2.2
+// Bit 0 of the data bits is the sign bit and the rest are the magnitude.
+
+inline long
+OasisScanner::readSignedInteger()
+{
+    Ulong  bits;
+    if (fetchShortInteger(&bits)) {
+        long  val = bits >> 1;
+        return ((bits & 0x1) ? -val : val);
+    }
+    return (readSignedIntegerSlow());
+}
+
+
+
 inline void
 OasisScanner::readReal (/*out*/ Oreal* retval)
 {
@@ -241,37 +385,57 @@ OasisScanner::readOneDelta() {
 
 
 
-// readTwoDelta -- read a 2-delta
+// decodeTwoDelta -- convert the unsigned-integer of a 2-delta to a Delta
 // A 2-delta is a Manhattan displacement.  It is represented by an
 // unsigned integer whose lowest 2 bits give the direction -- 00 East,
 // 01 North, 10 West, and 11 South -- and remaining bits give the
 // magnitude of the displacement.
+//
+// This and decodeThreeDelta() are separate from the read functions so
+// that OasisRecordReader can decode deltas read in batches by
+// readUnsignedIntegers().
 
-inline Delta
-OasisScanner::readTwoDelta()
+/*static*/ inline Delta
+OasisScanner::decodeTwoDelta (Ulong val)
 {
-    Ulong  val = readUnsignedInteger();
     Delta::Direction  dirn = static_cast<Delta::Direction>(val & 0x3);
     return Delta(dirn, val >> 2);
 }
 
 
 
-// readThreeDelta -- read a 3-delta
+// decodeThreeDelta -- convert the unsigned-integer of a 3-delta to a Delta
 // A 3-delta is an octangular displacement.  It is represented by an
 // unsigned integer whose lowest 3 bits give the direction of the
 // displacement (see Delta::Direction) and remaining bits give the
 // X and/or Y value of the displacement.
 
-inline Delta
-OasisScanner::readThreeDelta()
+/*static*/ inline Delta
+OasisScanner::decodeThreeDelta (Ulong val)
 {
-    Ulong  val = readUnsignedInteger();
     Delta::Direction  dirn = static_cast<Delta::Direction>(val & 0x7);
     return Delta(dirn, val >> 3);
 }
 
 
+
+// readTwoDelta -- read a 2-delta
+
+inline Delta
+OasisScanner::readTwoDelta() {
+    return (decodeTwoDelta(readUnsignedInteger()));
+}
+
+
+
+// readThreeDelta -- read a 3-delta
+
+inline Delta
+OasisScanner::readThreeDelta() {
+    return (decodeThreeDelta(readUnsignedInteger()));
+}
+
+
 } // namespace Oasis
 
 #endif  // OASIS_SCANNER_H_INCLUDED
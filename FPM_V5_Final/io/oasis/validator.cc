@@ -6,12 +6,26 @@
 // This software may be used only under the terms of the SoftJin
 // Source License.  See the accompanying file LICENSE for details.
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <unistd.h>
 #include <zlib.h>
+#include <boost/scoped_array.hpp>
 #include "validator.h"
 
 namespace Oasis {
 
+using std::min;
+using boost::scoped_array;
 using SoftJin::Uchar;
+using SoftJin::ThrowRuntimeError;
+
+
+const Uint  SliceReadSize = 1024*1024;
+    // Each FileSignature thread reads its slice of the file in pieces
+    // of this size.
 
 
 Validator::Validator() { }
@@ -41,6 +55,15 @@ Crc32Validator::getSignature() {
 }
 
 
+// append -- zlib can combine two CRCs given the length of the second.
+
+/*virtual*/ void
+Crc32Validator::append (const Validator& next, off_t nbytes) {
+    crc = crc32_combine(crc, static_cast<const Crc32Validator&>(next).crc,
+                        nbytes);
+}
+
+
 //----------------------------------------------------------------------
 
 
@@ -69,4 +92,201 @@ Checksum32Validator::getSignature() {
 }
 
 
+// append -- a checksum is a sum, so the order of the bytes does not matter.
+
+/*virtual*/ void
+Checksum32Validator::append (const Validator& next, off_t /*nbytes*/) {
+    checksum += static_cast<const Checksum32Validator&>(next).checksum;
+}
+
+
+//----------------------------------------------------------------------
+
+
+// constructor
+//   fd         file descriptor opened for reading
+//   nbytes     number of bytes at the beginning of the file to include
+//   scheme     CRC32 or Checksum32
+//   numThreads number of threads to use.  Must be positive.
+//   ctxt       prefix for error messages, e.g., the file name
+//
+// If a thread cannot be created, the slices not yet started are done
+// by getSignature() in the calling thread.
+
+FileSignature::FileSignature (int fd, off_t nbytes, Validation::Scheme scheme,
+                              Uint numThreads, const char* ctxt)
+  : fdin(fd),
+    context(ctxt)
+{
+    assert (scheme == Validation::CRC32  ||  scheme == Validation::Checksum32);
+    assert (numThreads > 0);
+
+    stopping = false;
+    joined = false;
+    pthread_mutex_init(&mutex, Null);
+
+    // Don't bother with slices smaller than a read.
+    Uint  numSlices = numThreads;
+    if (nbytes / SliceReadSize < numSlices)
+        numSlices = nbytes/SliceReadSize + 1;
+
+    slices.resize(numSlices);
+    off_t  offset = 0;
+    for (Uint j = 0;  j < numSlices;  ++j) {
+        Slice&  slice = slices[j];
+        off_t  end = nbytes / numSlices * (j+1);
+        if (j == numSlices - 1)
+            end = nbytes;
+        slice.owner = this;
+        slice.offset = offset;
+        slice.nbytes = end - offset;
+        slice.started = false;
+        slice.validator = Null;
+        offset = end;
+    }
+
+    try {
+        for (Uint j = 0;  j < numSlices;  ++j) {
+            if (scheme == Validation::CRC32)
+                slices[j].validator = new Crc32Validator;
+            else
+                slices[j].validator = new Checksum32Validator;
+        }
+    } catch (...) {
+        deleteValidators();
+        pthread_mutex_destroy(&mutex);
+        throw;
+    }
+
+    for (Uint j = 0;  j < numSlices;  ++j) {
+        Slice&  slice = slices[j];
+        if (pthread_create(&slice.thread, Null, runSlice, &slice) != 0)
+            break;
+        slice.started = true;
+    }
+}
+
+
+
+FileSignature::~FileSignature()
+{
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_mutex_unlock(&mutex);
+
+    joinThreads();
+    deleteValidators();
+    pthread_mutex_destroy(&mutex);
+}
+
+
+
+// getSignature -- wait for the threads and return the file's signature
+// Throws runtime_error if any part of the file could not be read.
+// Must be called at most once.
+
+uint32_t
+FileSignature::getSignature()
+{
+    joinThreads();
+    for (size_t j = 0;  j < slices.size();  ++j) {
+        Slice&  slice = slices[j];
+        if (! slice.started)
+            readSlice(&slice);
+        if (! slice.error.empty())
+            ThrowRuntimeError("%s: %s", context.c_str(), slice.error.c_str());
+    }
+
+    Validator*  validator = slices[0].validator;
+    for (size_t j = 1;  j < slices.size();  ++j)
+        validator->append(*slices[j].validator, slices[j].nbytes);
+    return validator->getSignature();
+}
+
+
+
+/*static*/ void*
+FileSignature::runSlice (void* arg)
+{
+    Slice*  slice = static_cast<Slice*>(arg);
+    slice->owner->readSlice(slice);
+    return Null;
+}
+
+
+
+// readSlice -- compute the signature of one slice of the file
+// Runs in the slice's thread, or in the caller's thread if the thread
+// could not be created.  Exceptions must not escape a thread, so
+// errors are stored in the slice.
+
+void
+FileSignature::readSlice (Slice* slice)
+{
+    try {
+        scoped_array<char>  buf(new char[SliceReadSize]);
+        off_t  offset = slice->offset;
+        off_t  end = slice->offset + slice->nbytes;
+        while (offset < end) {
+            if (isStopping()) {
+                slice->error = "validation cancelled";
+                return;
+            }
+            size_t  nbytes = min<off_t>(end - offset, SliceReadSize);
+            ssize_t  nread = pread(fdin, buf.get(), nbytes, offset);
+            if (nread < 0) {
+                if (errno == EINTR)
+                    continue;
+                slice->error = string("read failed: ") + strerror(errno);
+                return;
+            }
+            if (nread == 0) {
+                slice->error = "unexpected end of file";
+                return;
+            }
+            slice->validator->add(buf.get(), nread);
+            offset += nread;
+        }
+    } catch (const std::exception& exc) {
+        slice->error = exc.what();
+    }
+}
+
+
+
+bool
+FileSignature::isStopping()
+{
+    pthread_mutex_lock(&mutex);
+    bool  ret = stopping;
+    pthread_mutex_unlock(&mutex);
+    return ret;
+}
+
+
+
+void
+FileSignature::joinThreads()
+{
+    if (joined)
+        return;
+    for (size_t j = 0;  j < slices.size();  ++j) {
+        if (slices[j].started)
+            pthread_join(slices[j].thread, Null);
+    }
+    joined = true;
+}
+
+
+
+void
+FileSignature::deleteValidators()
+{
+    for (size_t j = 0;  j < slices.size();  ++j) {
+        delete slices[j].validator;
+        slices[j].validator = Null;
+    }
+}
+
+
 }  // namespace Oasis
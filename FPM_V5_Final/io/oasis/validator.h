@@ -11,17 +11,29 @@
 // subclasses, Crc32Validator and Checksum32Validator.  OasisScanner and
 // OasisWriter instantiate the appropriate concrete subclass to compute
 // the signature.
+//
+// FileSignature computes the signature of a file in several threads,
+// each with its own Validator for one slice of the file, and combines
+// the slices' signatures at the end.  OasisScanner uses it to validate
+// a file while the parser is reading it.
 
 
 #ifndef OASIS_VALIDATOR_H_INCLUDED
 #define OASIS_VALIDATOR_H_INCLUDED
 
 #include <inttypes.h>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sys/types.h>          // for off_t
 #include "misc/globals.h"
+#include "oasis.h"
 
 
 namespace Oasis {
 
+using std::string;
+using std::vector;
 using SoftJin::Uint;
 using SoftJin::Ulong;
 
@@ -37,6 +49,13 @@ using SoftJin::Ulong;
 // uint32_t  getSignature()
 //
 //      Returns the current value of the validation signature.
+//
+// void  append (const Validator& next, off_t nbytes)
+//
+//      Adjusts the validation signature as if the nbytes bytes given
+//      to next had been given to this validator after its own.  next
+//      must be of the same class.  This lets the signature of a file be
+//      computed in separate pieces.
 
 class Validator {
 public:
@@ -44,6 +63,7 @@ public:
     virtual             ~Validator();
     virtual void        add (const char* buf, Uint nbytes) = 0;
     virtual uint32_t    getSignature() = 0;
+    virtual void        append (const Validator& next, off_t nbytes) = 0;
 };
 
 
@@ -60,6 +80,7 @@ public:
     virtual             ~Crc32Validator();
     virtual void        add (const char* buf, Uint nbytes);
     virtual uint32_t    getSignature();
+    virtual void        append (const Validator& next, off_t nbytes);
 };
 
 
@@ -73,6 +94,66 @@ public:
     virtual             ~Checksum32Validator();
     virtual void        add (const char* buf, Uint nbytes);
     virtual uint32_t    getSignature();
+    virtual void        append (const Validator& next, off_t nbytes);
+};
+
+
+
+// FileSignature -- compute the validation signature of a file in threads
+// The constructor divides the first nbytes bytes of the file into one
+// slice per thread and starts the threads.  They read the file with
+// pread(), so the caller may go on reading the same descriptor.
+// getSignature() waits for the threads and combines their signatures.
+// The destructor tells the threads to stop early if getSignature() was
+// not called, and waits for them.
+//
+// Slice                one thread's part of the file
+//      owner           the FileSignature
+//      offset, nbytes  the part of the file the thread reads
+//      validator       signature of the bytes read
+//      error           empty, or why the thread failed
+//      thread, started the thread, and whether it was created
+//
+// fdin                 the file to read.  The caller must keep it open.
+// context              prefix for error messages, e.g., the file name
+// mutex, stopping      stopping is set by the destructor; the threads
+//                      check it between reads
+// joined               the threads have been waited for
+
+class FileSignature {
+    struct Slice {
+        FileSignature*  owner;
+        off_t           offset;
+        off_t           nbytes;
+        Validator*      validator;
+        string          error;
+        pthread_t       thread;
+        bool            started;
+    };
+
+    vector<Slice>       slices;
+    int                 fdin;
+    string              context;
+    pthread_mutex_t     mutex;
+    bool                stopping;
+    bool                joined;
+
+public:
+                        FileSignature (int fd, off_t nbytes,
+                                       Validation::Scheme scheme,
+                                       Uint numThreads, const char* ctxt);
+                        ~FileSignature();
+    uint32_t            getSignature();
+
+private:
+    static void*        runSlice (void* arg);
+    void                readSlice (Slice* slice);
+    bool                isStopping();
+    void                joinThreads();
+    void                deleteValidators();
+
+                        FileSignature (const FileSignature&);   // forbidden
+    void                operator= (const FileSignature&);       // forbidden
 };
 
 
@@ -12,6 +12,9 @@
 #include <cstdlib>
 #include <fcntl.h>
 #include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
 #include <boost/scoped_array.hpp>
 #include <boost/static_assert.hpp>
 
@@ -52,14 +55,44 @@ const Uint  BytesForUllong = (numeric_limits<Ullong>::digits+6) / 7;
     // format, with 7 data bits per byte.
 
 
+const size_t  PendingCblocksPerThread = 4;
+    // With compression threads, endCblock() lets this many cblocks per
+    // thread wait to be written before it blocks.  Enough to keep the
+    // threads busy when cells vary in size, small enough to bound the
+    // memory used.
+
+
+
+// PendingCblock -- a cblock given to deflatePool, and what follows it
+//   job        the uncompressed and (later) compressed contents
+//   uncompBytes size of the uncompressed contents.  The pool frees
+//              job.input once it is compressed.
+//   trailer    bytes written outside cblocks after this cblock, up to
+//              the next pending cblock.  Includes the next cblock's
+//              record-id and comp-type.
+//   offsets    noteFileOffset() requests made while writing trailer:
+//              where to store the offset, and the offset relative to
+//              the start of trailer.
+
+struct OasisWriter::PendingCblock {
+    CblockJob   job;
+    Ullong      uncompBytes;
+    string      trailer;
+    vector< pair<off_t*, size_t> >  offsets;
+};
+
+
 //----------------------------------------------------------------------
 //                      Initialization and termination
 //----------------------------------------------------------------------
 
 // constructor
-//   fname      pathname of file to write
+//   fname              pathname of file to write
+//   compressThreads    number of threads to compress cblocks in.
+//                      0 means compress them in this thread as they
+//                      are written.  The file is the same either way.
 
-OasisWriter::OasisWriter (const char* fname)
+OasisWriter::OasisWriter (const char* fname, Uint compressThreads)
   : fileBuf(FileBufferSize),
     filename(fname)
 {
@@ -72,12 +105,25 @@ OasisWriter::OasisWriter (const char* fname)
     deflater = Null;
     validator = Null;
     valScheme = Validation::None;
+
+    currCblock = Null;
+    deflatePool = Null;
+    maxPendingCblocks = compressThreads * PendingCblocksPerThread;
+    if (compressThreads > 0)
+        deflatePool = new DeflatePool(compressThreads);
 }
 
 
 
 OasisWriter::~OasisWriter()
 {
+    // Destroy the pool first.  Its destructor finishes the jobs it
+    // still has, which point into the pending cblocks.
+
+    delete deflatePool;
+    DeleteContainerElements(pendingCblocks);
+    delete currCblock;
+
     delete validator;
     delete deflater;
 
@@ -158,15 +204,6 @@ OasisWriter::bufferIsFull() const {
 
 
 
-// writingToCblock -- true if the writer is in a cblock.
-
-inline bool
-OasisWriter::writingToCblock() const {
-    return (compressor != Null);
-}
-
-
-
 // flushBuffer -- flush the current buffer
 // Postcondition:
 //   The current buffer is not full (i.e., bufptr != bufend)
@@ -180,10 +217,20 @@ OasisWriter::flushBuffer()
     // in the buffer.  Those functions may leave some data in the buffer,
     // so copy the updated buffer.curr back to bufptr.
 
+    // While cblocks are pending, bytes outside cblocks are held in
+    // cblockBuf.  Move them to the last pending cblock's trailer, then
+    // write whatever cblocks have been compressed.  If that writes all
+    // of them, writePendingCblocks() switches back to fileBuf.
+
     if (writingToCblock()) {
         cblockBuf.curr = bufptr;
         flushCblockBuffer(false);
         bufptr = cblockBuf.curr;
+    } else if (! pendingCblocks.empty()) {
+        cblockBuf.curr = bufptr;
+        holdCblockBuffer();
+        bufptr = cblockBuf.curr;
+        writePendingCblocks(maxPendingCblocks);
     } else {
         fileBuf.curr = bufptr;
         flushFileBuffer();
@@ -255,10 +302,11 @@ OasisWriter::updateValidationSignature (off_t offset, const char* data,
     // If the bytes being flushed to disk include any of the filler
     // bytes that beginCompression() put for the CBLOCK byte-counts,
     // suspend CRC computation because those bytes will be overwritten
-    // later by the real counts.
+    // later by the real counts.  Cblocks compressed by deflatePool
+    // have no filler bytes.
 
     off_t  endOffset = offset + nbytes;
-    if (writingToCblock()  &&  endOffset > cblockCountOffset)
+    if (compressor != Null  &&  endOffset > cblockCountOffset)
         return;
 
     validator->add(data, nbytes);
@@ -337,6 +385,15 @@ OasisWriter::beginCblock (Ulong compType)
     writeUnsignedInteger(RID_CBLOCK);
     writeUnsignedInteger(compType);
 
+    // With compression threads, the cblock is written only when it has
+    // been compressed.  Skip all the business with byte-counts below.
+
+    assert (compType == DeflateCompression);
+    if (deflatePool != Null) {
+        beginPooledCblock();
+        return;
+    }
+
     // Free as much space in the file buffer as possible.  When the
     // cblock ends we have to fill in the uncomp-byte-count and
     // comp-byte-count that precede the compressed data.  If the part of
@@ -374,7 +431,6 @@ OasisWriter::beginCblock (Ulong compType)
     // type, but that may not be true in the future.  If this is the
     // first DEFLATE cblock in the file, create the deflater.
 
-    assert (compType == DeflateCompression);
     if (deflater == Null)
         deflater = new ZlibDeflater;
     compressor = deflater;
@@ -418,6 +474,14 @@ OasisWriter::beginCblock (Ulong compType)
 OasisWriter::flushCblockBuffer (bool endOfInput)
 {
     assert (writingToCblock());
+
+    // A cblock for deflatePool is collected whole and compressed later.
+
+    if (currCblock != Null) {
+        currCblock->job.input.append(cblockBuf.buffer, cblockBuf.charsUsed());
+        cblockBuf.flushAll();
+        return;
+    }
     assert (compressor->needInput());
 
     Uint  inbytes;      // num bytes in cblockBuf to be compressed
@@ -456,6 +520,10 @@ OasisWriter::flushCblockBuffer (bool endOfInput)
 OasisWriter::endCblock()
 {
     cblockBuf.curr = bufptr;
+    if (currCblock != Null) {
+        endPooledCblock();
+        return;
+    }
     flushCblockBuffer(true);
     compressor = Null;
 
@@ -519,6 +587,179 @@ OasisWriter::endCblock()
 
 
 
+//----------------------------------------------------------------------
+//                      Compression in worker threads
+//----------------------------------------------------------------------
+// These methods are used only when deflatePool != Null.
+
+// beginPooledCblock -- begin collecting a cblock for deflatePool
+// beginCblock() calls this after writing the record-id and comp-type.
+
+/*private*/ void
+OasisWriter::beginPooledCblock()
+{
+    // The cblock record's first bytes are wherever bufptr is: in
+    // fileBuf if nothing is pending, otherwise held in cblockBuf.
+    // Either way they must come before the cblock's counts, so put
+    // them where they will be written in the right order.
+
+    if (pendingCblocks.empty())
+        fileBuf.curr = bufptr;
+    else {
+        cblockBuf.curr = bufptr;
+        holdCblockBuffer();
+    }
+
+    if (cblockBuf.buffer == Null)
+        cblockBuf.create(CblockBufferSize);
+
+    char  context[100];
+    formatContext(context, sizeof context);
+    currCblock = new PendingCblock;
+    currCblock->job.context = context;
+
+    bufptr = cblockBuf.buffer;
+    bufend = cblockBuf.end;
+}
+
+
+
+// endPooledCblock -- hand the current cblock to deflatePool
+// endCblock() calls this.  The cblock is queued in pendingCblocks and
+// the bytes that follow it are held in cblockBuf until it is written.
+
+/*private*/ void
+OasisWriter::endPooledCblock()
+{
+    flushCblockBuffer(true);
+    PendingCblock*  pc = currCblock;
+    currCblock = Null;
+
+    pc->uncompBytes = pc->job.input.size();
+    pendingCblocks.push_back(pc);
+    deflatePool->submit(&pc->job);
+
+    bufptr = cblockBuf.buffer;
+    bufend = cblockBuf.end;
+    writePendingCblocks(maxPendingCblocks);
+}
+
+
+
+// holdCblockBuffer -- move bytes held in cblockBuf to the last pending cblock
+// Precondition:
+//     ! pendingCblocks.empty()
+//     cblockBuf.curr is up to date
+
+/*private*/ void
+OasisWriter::holdCblockBuffer()
+{
+    assert (! pendingCblocks.empty());
+    pendingCblocks.back()->trailer.append(cblockBuf.buffer,
+                                          cblockBuf.charsUsed());
+    cblockBuf.flushAll();
+}
+
+
+
+// writePendingCblocks -- write compressed cblocks from the front of the queue
+//   maxPending         wait for the oldest cblock while more than this
+//                      many are pending.  0 means write them all.
+//
+// Writes every cblock at the front of pendingCblocks that has been
+// compressed, with its byte-counts and trailer, and fills in the
+// offsets requested by noteFileOffset().  If the queue becomes empty
+// outside a cblock, the bytes held in cblockBuf go to fileBuf and the
+// writer switches back to writing into fileBuf.
+
+/*private*/ void
+OasisWriter::writePendingCblocks (size_t maxPending)
+{
+    while (! pendingCblocks.empty()) {
+        PendingCblock*  pc = pendingCblocks.front();
+        if (pendingCblocks.size() <= maxPending
+                &&  ! deflatePool->isDone(&pc->job))
+            break;
+        deflatePool->wait(&pc->job);
+        pendingCblocks.pop_front();
+        auto_ptr<PendingCblock>  apc(pc);
+
+        const CblockJob&  job = pc->job;
+        if (! job.error.empty())
+            ThrowRuntimeError("%s", job.error.c_str());
+
+        // Unlike the cblocks compressed in this thread, the counts are
+        // known before the cblock is written.  Write them in the same
+        // fixed width so that the file is the same.
+
+        char  byteCounts[2*BytesForUllong];
+        makeUnsignedInteger64(byteCounts, BytesForUllong, pc->uncompBytes);
+        makeUnsignedInteger64(byteCounts+BytesForUllong, BytesForUllong,
+                              job.output.size());
+        writeFileBytes(byteCounts, sizeof byteCounts);
+        writeFileBytes(job.output.data(), job.output.size());
+
+        off_t  trailerOffset = fileOffset + fileBuf.charsUsed();
+        for (size_t j = 0;  j < pc->offsets.size();  ++j)
+            *pc->offsets[j].first = trailerOffset + pc->offsets[j].second;
+        writeFileBytes(pc->trailer.data(), pc->trailer.size());
+    }
+
+    if (pendingCblocks.empty()  &&  ! writingToCblock()
+            &&  bufend == cblockBuf.end) {
+        writeFileBytes(cblockBuf.buffer, bufptr - cblockBuf.buffer);
+        cblockBuf.flushAll();
+        bufptr = fileBuf.curr;
+        bufend = fileBuf.end;
+    }
+}
+
+
+
+// writeFileBytes -- append bytes to fileBuf, flushing it as needed
+// Used only while bufptr points into cblockBuf, so fileBuf.curr is
+// the current end of the data in fileBuf.
+
+/*private*/ void
+OasisWriter::writeFileBytes (const char* data, size_t nbytes)
+{
+    while (nbytes > 0) {
+        if (fileBuf.charsFree() == 0)
+            flushFileBuffer();
+        size_t  n = min(nbytes, fileBuf.charsFree());
+        memcpy(fileBuf.curr, data, n);
+        fileBuf.curr += n;
+        data += n;
+        nbytes -= n;
+    }
+}
+
+
+
+// noteFileOffset -- store the offset of the next byte to be written
+//   offsetp    where to store the offset
+//
+// Like currFileOffset(), but does not wait for pending cblocks.  If
+// the offset is not yet known, it is stored in *offsetp when the
+// cblocks before it are written, which is no later than the next call
+// to currFileOffset().  *offsetp must stay valid until then.
+// Precondition: the writer is not in a cblock.
+
+/*public*/ void
+OasisWriter::noteFileOffset (off_t* offsetp)
+{
+    assert (! writingToCblock());
+    if (pendingCblocks.empty()) {
+        *offsetp = currFileOffset();
+        return;
+    }
+    PendingCblock*  pc = pendingCblocks.back();
+    size_t  relOffset = pc->trailer.size() + (bufptr - cblockBuf.buffer);
+    pc->offsets.push_back(make_pair(offsetp, relOffset));
+}
+
+
+
 //----------------------------------------------------------------------
 //                            File operations
 //----------------------------------------------------------------------
@@ -11,6 +11,7 @@
 
 #include <cassert>
 #include <cstring>
+#include <deque>
 #include <limits>
 #include <string>
 #include <sys/types.h>          // for off_t
@@ -23,13 +24,16 @@
 
 namespace Oasis {
 
+using std::deque;
 using std::string;
 using SoftJin::llong;
+using SoftJin::Uint;
 using SoftJin::Ullong;
 using SoftJin::Ulong;
 using SoftJin::WriteBuffer;
 
 class Compressor;       // compressor.h
+class DeflatePool;      // compressor.h
 class ZlibDeflater;     // compressor.h
 class Validator;        // validator.h
 
@@ -56,6 +60,10 @@ Data members
         which writes the compressed output to fileBuf.
         cblockBuf.curr is updated only when switching to fileBuf.
 
+        When cblocks are compressed by deflatePool, cblockBuf also
+        collects the uncompressed bytes written between cblocks while
+        some earlier cblock is still pending.  See pendingCblocks.
+
     bufptr              char*
         Pointer into fileBuf.buffer or cblockBuf.buffer.  Points to
         where the next output character will be written.  Only this
@@ -86,9 +94,41 @@ Data members
 
     compressor
         The current compression strategy class.  Null means that the
-        writer is not in a CBLOCK.  Since the current spec defines DEFLATE
-        as the only compression method, this must have the same value
-        as deflater if it is non-Null.
+        writer is not in a CBLOCK or that the CBLOCK is being collected
+        for deflatePool.  Since the current spec defines DEFLATE as the
+        only compression method, this must have the same value as
+        deflater if it is non-Null.
+
+    deflatePool         DeflatePool*
+        Null unless the constructor was asked for compression threads.
+        Then each CBLOCK is collected whole in currCblock and handed to
+        the pool at endCblock(), and the writer goes on with the
+        following records while the pool compresses it.  deflater and
+        compressor are not used.
+
+    currCblock          PendingCblock*
+        Non-Null only when the writer is in a CBLOCK that will be
+        compressed by deflatePool.  cblockBuf is appended to its
+        uncompressed contents whenever cblockBuf fills.
+
+    pendingCblocks      deque<PendingCblock*>
+        CBLOCKs handed to deflatePool but not yet written, in file
+        order.  Along with its data, each one holds the uncompressed
+        bytes that follow it in the file up to the next pending CBLOCK,
+        and the noteFileOffset() requests that fall in those bytes.
+        While this is not empty nothing may go into fileBuf except the
+        pending CBLOCKs themselves, in order, so bytes written outside
+        CBLOCKs are collected in cblockBuf.  Because the byte-counts of
+        a pending CBLOCK are known when it is written, they are never
+        patched afterwards and CRC computation is never suspended.
+
+        Invariant:
+        bufptr points into fileBuf iff
+            (! writingToCblock()  &&  pendingCblocks.empty())
+
+    maxPendingCblocks   size_t
+        endCblock() waits for the oldest pending CBLOCK when there are
+        more than this many, to bound the memory held by the queue.
 
     cblockCountOffset   off_t
         Valid only when the writer is compressing data, i.e., when
@@ -151,19 +191,27 @@ class OasisWriter {
     Ullong      compBytes;
     Ullong      uncompBytes;
 
+    // Compression in worker threads
+    struct PendingCblock;
+    DeflatePool*   deflatePool;
+    PendingCblock* currCblock;
+    deque<PendingCblock*>  pendingCblocks;
+    size_t      maxPendingCblocks;
+
     // Validation
     Validation::Scheme  valScheme;      // None, CRC32, Checksum32
     Validator*  validator;
     off_t       crcNextOffset;
 
 public:
-    explicit    OasisWriter (const char* fname);
+    explicit    OasisWriter (const char* fname, Uint compressThreads = 0);
                 ~OasisWriter();
 
     void        beginFile (Validation::Scheme valScheme);
     void        endFile();
 
-    off_t       currFileOffset() const;
+    off_t       currFileOffset();
+    void        noteFileOffset (off_t* offsetp);
     void        beginRecord (RecordID recID);
     void        beginCblock (Ulong compType);
     void        endCblock();
@@ -202,6 +250,11 @@ private:
                                            Uint nbytes);
     void        updateCrcFromFile();
     void        flushCblockBuffer (bool endOfInput);
+    void        beginPooledCblock();
+    void        endPooledCblock();
+    void        holdCblockBuffer();
+    void        writePendingCblocks (size_t maxPending);
+    void        writeFileBytes (const char* data, size_t nbytes);
     void        writeAtOffset (const void* buf, size_t count, off_t offset);
     void        seekTo (off_t offset);
     void        finishEndRecord();
@@ -221,12 +274,27 @@ private:
 
 
 
+// writingToCblock -- true if the writer is in a cblock.
+
+inline bool
+OasisWriter::writingToCblock() const {
+    return (compressor != Null  ||  currCblock != Null);
+}
+
+
+
 // currFileOffset -- get file offset of next byte to be written.
 // Precondition: the writer is not currently compressing the data.
+// If some cblocks are still being compressed in other threads, this
+// waits for them and writes them, because the offset depends on their
+// compressed sizes.  Use noteFileOffset() to avoid the wait.
 
 inline off_t
-OasisWriter::currFileOffset() const {
-    assert (compressor == Null);
+OasisWriter::currFileOffset()
+{
+    assert (! writingToCblock());
+    if (! pendingCblocks.empty())
+        writePendingCblocks(0);
     return (fileOffset + (bufptr - fileBuf.buffer));
 }
 
@@ -36,6 +36,18 @@
 #define  SJ_DEPRECATED      __attribute__((deprecated))
 
 
+// Word-at-a-time decoding in the OASIS scanner needs to find the lowest
+// set bit of a 64-bit word, and to know that a word copied from memory
+// has its first byte in the low-order bits.  SJ_LITTLE_ENDIAN is left
+// undefined if gcc does not say what the byte order is.
+
+#define  SJ_CTZ64(x)        __builtin_ctzll(x)
+
+#if defined(__BYTE_ORDER__)  &&  __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define  SJ_LITTLE_ENDIAN  1
+#endif
+
+
 //----------------------------------------------------------------------
 #else  // not gcc
 
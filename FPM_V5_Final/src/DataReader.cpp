@@ -31,6 +31,7 @@ bool DataReader::ReadOASIS(string fileName, FPMLayout &layout)
     parserOptions.wantText          = false;
     parserOptions.wantValidation    = false;
     parserOptions.wantExtensions    = false;
+    parserOptions.singlePass        = true;
     const char*  infilename = fileName.c_str();
 
     printf("Start Reading OASIS layout ...\n");
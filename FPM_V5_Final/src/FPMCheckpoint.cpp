@@ -0,0 +1,107 @@
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include "FPMCheckpoint.h"
+
+namespace FPM {
+using namespace std;
+
+//one '\n' terminated line, false at the end of the file or on a torn line
+static bool readLine(FILE *f, string &line)
+{
+  line.clear();
+  int c;
+  while ((c = fgetc(f)) != EOF)
+  {
+    if (c == '\n')
+      return true;
+    line += (char)c;
+  }
+  return false;
+}
+
+//returns the length of the complete records, -1 if the setup differs
+long FPMCheckpoint::load(FILE *f, const string &setup)
+{
+  string line;
+  if (!readLine(f, line) || line != setup)
+    return -1;
+  long good = ftell(f);
+  while (readLine(f, line))
+  {
+    istringstream in(line);
+    int index, n;
+    if (!(in >> index >> n) || n < 0)
+      break;
+    vector<FPMPoint> points(n);
+    int i = 0;
+    for (; i < n; ++ i)
+    {
+      if (!(in >> points[i].x >> points[i].y))
+        break;
+    }
+    if (i < n)
+      break;
+    m_done[index].swap(points);
+    good = ftell(f);
+  }
+  return good;
+}
+
+bool FPMCheckpoint::open(const char *fileName, const string &setup, bool resume)
+{
+  close();
+  m_done.clear();
+  if (resume)
+  {
+    FILE *f = fopen(fileName, "r");
+    if (f != NULL)
+    {
+      long good = load(f, setup);
+      fclose(f);
+      if (good < 0)
+      {
+        cerr << "Checkpoint " << fileName << " is from another setup, not resuming" << endl;
+        m_done.clear();
+      }
+      else if (truncate(fileName, good) == 0)
+      {
+        m_file = fopen(fileName, "a");
+      }
+    }
+  }
+  if (m_file == NULL)
+  {
+    m_done.clear();
+    m_file = fopen(fileName, "w");
+    if (m_file == NULL)
+    {
+      cerr << "Can not write checkpoint " << fileName << endl;
+      return false;
+    }
+    fprintf(m_file, "%s\n", setup.c_str());
+    fflush(m_file);
+  }
+  cout << "Checkpoint " << fileName << ": " << m_done.size() << " windows done" << endl;
+  return true;
+}
+
+void FPMCheckpoint::close()
+{
+  if (m_file != NULL)
+    fclose(m_file);
+  m_file = NULL;
+}
+
+void FPMCheckpoint::record(int index, const vector<FPMPoint> &points)
+{
+  if (m_file == NULL)
+    return;
+  fprintf(m_file, "%d %d", index, (int)points.size());
+  for (int i = 0; i < points.size(); ++ i)
+    fprintf(m_file, " %d %d", points[i].x, points[i].y);
+  fprintf(m_file, "\n");
+  fflush(m_file);
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef __FPMCHECKPOINT_H__
+#define __FPMCHECKPOINT_H__
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "FPMPoint.h"
+
+//Log of the windows a run has finished, so a killed run can be resumed
+//(-checkpoint file [-resume]). The first line names the input layout and the
+//run setup the window numbering and matching depend on, then every finished
+//window appends one line
+//  index n x1 y1 ... xn yn
+//and is flushed at once. A resumed run must see the same layout and flags, else
+//it starts a new log; it skips the logged windows and reports their points as
+//if it had matched them.
+
+namespace FPM {
+
+class FPMCheckpoint
+{
+public:
+  FPMCheckpoint() { m_file = NULL; }
+  ~FPMCheckpoint() { close(); }
+  //read the windows of an earlier run with the same setup, cut off a torn last
+  //line and keep appending to the file; without resume start a new log
+  bool open(const char *fileName, const std::string &setup, bool resume);
+  void close();
+  int getDoneNum() { return m_done.size(); }
+  bool isDone(int index) { return m_done.find(index) != m_done.end(); }
+  std::vector<FPMPoint> &getPoints(int index) { return m_done[index]; }
+  const std::map< int, std::vector<FPMPoint> > &getDone() { return m_done; }
+  //only called by the thread collecting the points
+  void record(int index, const std::vector<FPMPoint> &points);
+
+private:
+  FILE *m_file;
+  std::map< int, std::vector<FPMPoint> > m_done;
+
+  long load(FILE *f, const std::string &setup);
+  FPMCheckpoint(const FPMCheckpoint &);
+  FPMCheckpoint &operator = (const FPMCheckpoint &);
+};
+
+}
+
+#endif  //FPMCHECKPOINT_H
@@ -0,0 +1,240 @@
+#include <cstdio>
+#include <iostream>
+#include "FPMLibrary.h"
+#include "FPMPlugin.h"
+#include "FPMMemory.h"
+
+extern int GRAPH_EDGE_DIFF;
+extern int CLUSTER_DIFF;
+
+namespace FPM {
+using namespace std;
+
+static void hashInt(unsigned long &h, int v)
+{
+  for(int i=0;i<4;i++)
+  {
+    h^=(v>>(i*8))&0xff;
+    h=(h*16777619UL)&0xffffffffUL;
+  }
+}
+
+//everything the generated matchers depend on
+unsigned long FPMLibrary::getFingerprint()
+{
+  unsigned long h=2166136261UL;
+  hashInt(h,FPM_PLUGIN_VERSION);
+  hashInt(h,GRAPH_EDGE_DIFF);
+  hashInt(h,CLUSTER_DIFF);
+  hashInt(h,m_blocks.size());
+  for(int j=0;j<m_blocks.size();j++)
+  {
+    FPMBlock &block=m_blocks[j];
+    int n=block.graph->NodeCount();
+    hashInt(h,n);
+    hashInt(h,isGuarded(block)&&m_clusters[block.cluster_id].rep==j);
+    hashInt(h,block.retired);
+    for(int i=0;i<block.sym.base.size();i++)
+      hashInt(h,block.sym.base[i]);
+    for(int v=0;v<block.sym.after.size();v++)
+    {
+      hashInt(h,block.sym.after[v].size());
+      for(int k=0;k<block.sym.after[v].size();k++)
+        hashInt(h,block.sym.after[v][k]);
+    }
+    for(int i=0;i<n;i++)
+    {
+      for(int k=0;k<block.graph->OutEdgeCount(i);k++)
+      {
+        int *attr;
+        int t=block.graph->GetOutEdge(i,k,&attr);
+        hashInt(h,i);
+        hashInt(h,t);
+        hashInt(h,*attr);
+      }
+    }
+  }
+  return h;
+}
+
+//One nested loop per block node in VF2 order. Candidates of a node come from the
+//neighbour list of an earlier node it is connected to, in increasing id like VF2,
+//and every pair with an earlier node is checked for the induced edges, so the
+//first mapping found is the first mapping VF2 reports.
+static void emitBlock(FILE *fp, int j, FPMBlock &block)
+{
+  ARGraph<void,int> *g=block.graph;
+  int n=g->NodeCount();
+  vector<int> pos(n);
+  for(int i=0;i<n;i++)
+    pos[block.sym.base[i]]=i;
+
+  fprintf(fp,"//block %d of pattern %d, %d nodes\n",j,block.pattern_id,n);
+  fprintf(fp,"template<int D>\nstatic int fpm_match_%d(const FPMPluginGraph *g, unsigned short *r)\n{\n",j);
+  string indent="  ";
+  for(int i=0;i<n;i++)
+  {
+    int u=block.sym.base[i];
+    int src=-1;
+    bool src_out=true;
+    for(int k=0;k<i&&src<0;k++)
+    {
+      int *attr;
+      if(g->HasEdge(block.sym.base[k],u,&attr))
+      {
+        src=k;
+        src_out=true;
+      }
+      else if(g->HasEdge(u,block.sym.base[k],&attr))
+      {
+        src=k;
+        src_out=false;
+      }
+    }
+    const char *side=src_out?"out":"in";
+    if(src<0)
+      fprintf(fp,"%sfor(int c%d=0;c%d<g->node_num;c%d++)\n%s{\n%s  int m%d=c%d;\n",
+              indent.c_str(),i,i,i,indent.c_str(),indent.c_str(),i,i);
+    else
+      fprintf(fp,"%sfor(int c%d=g->%s_off[m%d];c%d<g->%s_off[m%d+1];c%d++)\n%s{\n%s  int m%d=g->%s_node[c%d];\n",
+              indent.c_str(),i,side,src,i,side,src,i,indent.c_str(),indent.c_str(),i,side,i);
+    indent+="  ";
+    for(int k=0;k<i;k++)
+      fprintf(fp,"%sif(m%d==m%d) continue;\n",indent.c_str(),i,k);
+    fprintf(fp,"%sif(g->out_off[m%d+1]-g->out_off[m%d]<%d||g->in_off[m%d+1]-g->in_off[m%d]<%d) continue;\n",
+            indent.c_str(),i,i,g->OutEdgeCount(u),i,i,g->InEdgeCount(u));
+    for(int k=0;k<i;k++)
+    {
+      int p=block.sym.base[k];
+      int *attr;
+      if(g->HasEdge(p,u,&attr))
+        fprintf(fp,"%sif(!fpm_weight_ok(fpm_edge(g,m%d,m%d),%d,D)) continue;\n",indent.c_str(),k,i,*attr);
+      else
+        fprintf(fp,"%sif(fpm_edge(g,m%d,m%d)>=0) continue;\n",indent.c_str(),k,i);
+      if(g->HasEdge(u,p,&attr))
+        fprintf(fp,"%sif(!fpm_weight_ok(fpm_edge(g,m%d,m%d),%d,D)) continue;\n",indent.c_str(),i,k,*attr);
+      else
+        fprintf(fp,"%sif(fpm_edge(g,m%d,m%d)>=0) continue;\n",indent.c_str(),i,k);
+    }
+    if(u<block.sym.after.size())
+    {
+      for(int k=0;k<block.sym.after[u].size();k++)
+        fprintf(fp,"%sif(m%d<m%d) continue;\n",indent.c_str(),i,pos[block.sym.after[u][k]]);
+    }
+  }
+  for(int i=0;i<n;i++)
+    fprintf(fp,"%sr[%d]=m%d;\n",indent.c_str(),block.sym.base[i],i);
+  fprintf(fp,"%sreturn 1;\n",indent.c_str());
+  for(int i=n-1;i>=0;i--)
+  {
+    indent.erase(indent.size()-2);
+    fprintf(fp,"%s}\n",indent.c_str());
+  }
+  fprintf(fp,"  return 0;\n}\n\n");
+}
+
+bool FPMLibrary::emitMatchers(const char *path)
+{
+  FILE *fp=fopen(path,"w");
+  if(fp==NULL)
+  {
+    cerr<<"Error: can not write "<<path<<endl;
+    return false;
+  }
+  int block_num=m_blocks.size();
+  fprintf(fp,"//specialized block matchers, generated from a library of %d blocks\n",block_num);
+  fprintf(fp,"//GRAPH_EDGE_DIFF %d CLUSTER_DIFF %d\n",GRAPH_EDGE_DIFF,CLUSTER_DIFF);
+  fprintf(fp,"#define FPM_PLUGIN_SOURCE\n#include \"FPMPlugin.h\"\n\n");
+  for(int j=0;j<block_num;j++)
+  {
+    if(m_blocks[j].sym.base.size()!=m_blocks[j].graph->NodeCount())
+    {
+      cerr<<"Error: block "<<j<<" has no node order, matchers not generated"<<endl;
+      fclose(fp);
+      remove(path);
+      return false;
+    }
+    if(!m_blocks[j].retired)
+      emitBlock(fp,j,m_blocks[j]);
+  }
+
+  fprintf(fp,"extern \"C\" {\n");
+  fprintf(fp,"int fpm_plugin_version=%d;\n",FPM_PLUGIN_VERSION);
+  fprintf(fp,"unsigned long fpm_plugin_fingerprint=%luUL;\n",getFingerprint());
+  fprintf(fp,"int fpm_plugin_block_num=%d;\n",block_num);
+  fprintf(fp,"FPMPluginMatcher fpm_plugin_matchers[%d]={\n",block_num>0?block_num:1);
+  for(int j=0;j<block_num;j++)
+  {
+    if(m_blocks[j].retired)
+      fprintf(fp,"  0,\n");
+    else
+      fprintf(fp,"  fpm_match_%d<%d>,\n",j,GRAPH_EDGE_DIFF);
+  }
+  if(block_num==0)
+    fprintf(fp,"  0\n");
+  fprintf(fp,"};\n");
+  //cluster representatives are also matched with the widened tolerance
+  fprintf(fp,"FPMPluginMatcher fpm_plugin_widened[%d]={\n",block_num>0?block_num:1);
+  for(int j=0;j<block_num;j++)
+  {
+    int c=m_blocks[j].cluster_id;
+    if(isGuarded(m_blocks[j])&&m_clusters[c].rep==j)
+      fprintf(fp,"  fpm_match_%d<%d>,\n",j,GRAPH_EDGE_DIFF+CLUSTER_DIFF);
+    else
+      fprintf(fp,"  0,\n");
+  }
+  if(block_num==0)
+    fprintf(fp,"  0\n");
+  fprintf(fp,"};\n}\n");
+  fclose(fp);
+  cout<<"Matchers of "<<block_num<<" blocks written to "<<path<<endl;
+  return true;
+}
+
+bool FPMLibrary::loadPlugin(const char *path)
+{
+  return m_plugin.load(path,getFingerprint(),m_blocks.size());
+}
+
+//same contract as toMatchComponents, but the block is matched by its generated matcher
+bool FPMLibrary::matchPlugin(FPMPluginMatcher matcher, FPMBlock &block, FPMComponentVector &components, vector<FPMResultPair> &result_pair)
+{
+  int n=block.graph->NodeCount();
+  unsigned short *target=new unsigned short[n];
+  for(int c=0;c<components.size();c++)
+  {
+    if(!result_pair.empty()&&components[c].nodes[0]>result_pair[0].target_result[0])
+      break;
+    if(!isSigCompatible(block.sig,components[c].sig))
+      continue;
+    if(components[c].csr==NULL)
+    {
+      components[c].csr=new FPMCsrGraph;
+      toGetCsrGraph(components[c].graph,*components[c].csr);
+    }
+    if(matcher(&components[c].csr->g,target))
+    {
+      FPMMemScope mem(FPM_MEM_RESULT);
+      FPMResultPair pair;
+      pair.sub_result=new node_id[n];
+      pair.target_result=new node_id[n];
+      for(int i=0;i<n;i++)
+      {
+        pair.sub_result[i]=block.F[i];
+        pair.target_result[i]=components[c].nodes[target[i]];
+      }
+      if(!result_pair.empty()&&!isMappingBefore(pair,result_pair[0],n))
+      {
+        delete [] pair.sub_result;
+        delete [] pair.target_result;
+        continue;
+      }
+      freeResult(result_pair);
+      result_pair.push_back(pair);
+    }
+  }
+  delete [] target;
+  return !result_pair.empty();
+}
+
+}
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <cassert>
 #include <list>
+#include <set>
+#include <algorithm>
+#include <sstream>
 #include "FPMLayout.h"
 #include "Plot.h"
 #include "FPMPattern.h"
@@ -8,16 +11,33 @@
 #include "FPMTempEdge.h"
 #include "argraph.h"
 #include "FPMMatch.h"
+#include "FPMLibrary.h"
+#include "FPMPipeline.h"
+#include "FPMCheckpoint.h"
+#include "FPMMemory.h"
 #include "vf2_state.h"
 #include "EdgeComparator.h"
 #include "EdgeDestroyer.h"
 #include <ctime>
+#include <sys/stat.h>
 
 extern int S1_DISTANCE;
 extern int S2_DISTANCE;
 extern int MATCH_COUNT;
 extern int MEDGE_SIZE;
 extern int ADD_COUNT;
+extern int WIDTH_DIFF;
+extern int HEIGHT_DIFF;
+extern int GRAPH_EDGE_DIFF;
+extern int POLY_EDGE_DIFF;
+extern int CLUSTER_DIFF;
+extern const char *EMIT_FILE;
+extern const char *PLUGIN_FILE;
+extern int ANCHOR_MODE;
+extern int MATCH_THREADS;
+extern std::vector<int> TARGET_LAYERS;
+extern const char *CHECKPOINT_FILE;
+extern int RESUME_MODE;
 
 namespace FPM {
 using namespace std;
@@ -41,11 +61,45 @@ static bool checkPoly(FPMPoly &p)
   return true;
 }
 
+//shapes of these layers are clipped into the windows
+static bool isTargetLayer(int layer)
+{
+  return find(TARGET_LAYERS.begin(), TARGET_LAYERS.end(), layer) != TARGET_LAYERS.end();
+}
+
 void FPMLayout::addPoly(FPMPoly &p) {
   if (checkPoly(p))
     m_polys.push_back(p);
 }
 
+FPMPoly &FPMLayout::newPoly(int layer) {
+  if (m_polys.size() == m_polys.capacity())
+    reservePolys(m_polys.size() * 2 + 16);
+  m_polys.resize(m_polys.size() + 1);
+  m_polys.back().layer = layer;
+  return m_polys.back();
+}
+
+void FPMLayout::checkNewPoly() {
+  if (!checkPoly(m_polys.back()))
+    m_polys.pop_back();
+}
+
+//grow m_polys by swapping the vertex lists over instead of copying them
+void FPMLayout::reservePolys(int n) {
+  if (n <= (int)m_polys.capacity())
+    return;
+  std::vector<FPMPoly> polys;
+  polys.reserve(n);
+  polys.resize(m_polys.size());
+  for (int i = 0; i < (int)m_polys.size(); ++ i)
+  {
+    polys[i].layer = m_polys[i].layer;
+    polys[i].ptlist.swap(m_polys[i].ptlist);
+  }
+  m_polys.swap(polys);
+}
+
 bool FPMLayout::within_box(int x,int y, FPMRect mwindow)
 {
    if(x>mwindow.lb.x&&x<mwindow.lb.x+mwindow.width&&y>mwindow.lb.y&&y<mwindow.lb.y+mwindow.height)return true;
@@ -88,16 +142,13 @@ void FPMLayout::FinalResult(const std::vector<FPMPoint> &bad_point,const std::ve
         }
 		}
 		//cout<<"mwindows size---->"<<mwindows.size()<<endl;
+		FPMRectArray boxes;
+		for (int k = 0; k < mwindows.size(); ++ k)
+		  boxes.add(mwindows[k]);
 		for(int i=0;i<bad_point.size();i++)
 		{
 		  //update the windows for covered matching points
-      for (int k = 0; k < mwindows.size(); ++ k)
-      {
-          if (within_box(bad_point[i].x, bad_point[i].y ,mwindows[k]))
-          {
-            ++ mNum[k];
-          }
-      }
+      countInside(bad_point[i].x, bad_point[i].y, boxes, mNum);
     }
     //cout<<"come in good point"<<endl;
     
@@ -131,16 +182,13 @@ void FPMLayout::FinalResult(const std::vector<FPMPoint> &bad_point,const std::ve
         }
 		}
 		//cout<<"good result finished"<<endl;
+		FPMRectArray goodboxes;
+		for (int k = 0; k < mgoodwindows.size(); ++ k)
+		  goodboxes.add(mgoodwindows[k]);
 		for(int i=0;i<good_point.size();i++)
 		{
 		  //update the good windows for covered matching points
-      for (int k = 0; k < mgoodwindows.size(); ++ k)
-      {
-          if (within_box(good_point[i].x, good_point[i].y ,mgoodwindows[k]))
-          {
-            ++ mgoodNum[k];
-          }
-      }
+      countInside(good_point[i].x, good_point[i].y, goodboxes, mgoodNum);
     }
    // cout<<"final result end"<<endl;
     //cout<<"mwindow size: "<<mwindows.size()<<endl;
@@ -304,14 +352,18 @@ bool FPMLayout::checkOverlapOnWindow() {
     }
 
     bool g = true;
+    FPMRectArray array;
     for (int i = 0;i < rects.size();++i) {
-      for (int j = i + 1;j < rects.size();++j) {
-	if (checkOverlap(rects[i],rects[j])) {
+      array.add(rects[i]);
+    }
+    vector<int> hit;
+    for (int i = 0;i < rects.size();++i) {
+      clipRects(rects[i],array,i + 1,hit,NULL);
+      for (int k = 0;k < hit.size();++k) {
 	  cout << "false!" << endl;
 	  cout << rects[i] << endl;
-	  cout << rects[j] << endl;
+	  cout << rects[hit[k]] << endl;
 	  g = false;
-	}
       }
     }
     return g;
@@ -320,15 +372,13 @@ bool FPMLayout::checkOverlapOnWindow() {
 
 void FPMLayout::createSubLayoutsOnFrame() 
   {
-    const int targetLayer = 10;
-    
     const int frameLayer1 = 11;
     const int frameLayer2 = 12;
 
     vector<FPMPoly> target_polys;
     for (int i = 0; i < m_polys.size(); ++ i)
     {
-      if (m_polys[i].layer == targetLayer)
+      if (isTargetLayer(m_polys[i].layer))
       {
 	m_polys[i].makeCounterClockwise();
 	target_polys.push_back(m_polys[i]);
@@ -343,7 +393,7 @@ void FPMLayout::createSubLayoutsOnFrame()
       {
 	core_rects.push_back(m_rects[i]);
       }
-      else if (m_rects[i].layer == targetLayer)
+      else if (isTargetLayer(m_rects[i].layer))
       {
 	target_rects.push_back(m_rects[i]);
       }
@@ -351,6 +401,9 @@ void FPMLayout::createSubLayoutsOnFrame()
 
     //cout << "------------- merge -------------" << endl;
     //cout << core_rects.size() << endl;
+    FPMRectArray target_array;
+    for (int j = 0; j < target_rects.size(); ++ j)
+      target_array.add(target_rects[j]);
     for (int i = 0; i < core_rects.size(); ++ i)
     {
       //cout << core_rects[i];
@@ -360,10 +413,7 @@ void FPMLayout::createSubLayoutsOnFrame()
       	mergeRectPolygon(core_rects[i],target_polys[j],pt);
       }
 
-      for (int j = 0; j < target_rects.size(); ++ j)
-      {
-        	mergeRectRect(core_rects[i],target_rects[j],pt);
-      }
+      mergeRectRects(core_rects[i],target_array,target_rects,pt);
       pt.bbox = core_rects[i];	
       m_subLayouts.push_back(pt);
       //cout << pt;
@@ -437,11 +487,120 @@ static FPMRect BBox(FPMPoly &p)
   return r;
 }
 
-void FPMLayout::createSubLayoutsOnWindow(int n)
+//clip the target layer shapes into each window, one sub layout per window; with a
+//sink every window with at least min_shapes shapes is handed over as soon as the
+//sweep has passed its right side and is left empty in tempSubLayouts
+void FPMLayout::clipToWindows(vector<FPMRect> &windows, vector<FPMPattern> &tempSubLayouts, FPMWindowSink *sink, int min_shapes)
+{
+  FPMMemScope mem(FPM_MEM_CLIP);
+  //compute the bounding boxes for each polygon and rectangle
+  vector<FPMRect> bbs = windows;
+  int window_num = (int)windows.size();
+  tempSubLayouts.resize(window_num);
+  for (int i = 0; i < window_num; ++ i)
+    tempSubLayouts[i].bbox = windows[i];
+  vector<int> rectid;
+  for (int k = 0;k < m_rects.size();++k) {
+    if(isTargetLayer(m_rects[k].layer))
+    {
+      bbs.push_back(m_rects[k]);
+      rectid.push_back(k);
+    }
+  }
+  vector<int> polyid;
+  for (int k = 0;k < m_polys.size();++k) {
+    if(isTargetLayer(m_polys[k].layer))
+    {
+      bbs.push_back(BBox(m_polys[k]));
+      polyid.push_back(k);
+    }
+  }
+  //check overlap
+  int bbox_num = (int)bbs.size();
+  int rect_num = (int)rectid.size();
+  int poly_num = (int)polyid.size();
+  vector<SweepLine> Info(2 * bbox_num);
+  for (long i = 0; i < bbox_num; i++)
+  {
+    Info[2 * i].x = (double)bbs[i].lb.x;
+    Info[2 * i].index = i;
+    Info[2 * i].type = 0;
+    Info[2 * i + 1].x = (double)bbs[i].lb.x+bbs[i].width;
+    Info[2 * i + 1].index = i;
+    Info[2 * i + 1].type = 1;
+  }
+  sort(Info.begin(), Info.end(), cmp);  
+
+  list<Seg> current;
+  for (int line = 0; line != (int)Info.size(); ++line)
+  {
+    Seg seg_new;
+    seg_new.index = Info[line].index;
+    seg_new.y1 = (double)bbs[Info[line].index].lb.y;
+    seg_new.y2 = (double)bbs[Info[line].index].lb.y+bbs[Info[line].index].height;
+    if (Info[line].type)
+    {
+      current.remove(seg_new);
+      //all shapes overlapping a window start before its right side
+      int i = Info[line].index;
+      if (sink != NULL && i < window_num)
+      {
+        if ((int)(tempSubLayouts[i].m_poly_fulls.size() + tempSubLayouts[i].rect_set.size()) >= min_shapes)
+          sink->put(i, tempSubLayouts[i]);
+        tempSubLayouts[i].clearMem();
+      }
+    }
+    else
+    {
+      list<Seg>::iterator list_it = current.begin();
+      while (list_it != current.end())
+      {
+        if ((seg_new.y1 >= list_it->y1 && seg_new.y1 <= list_it->y2) || 
+        (list_it->y1 >= seg_new.y1 && list_it->y1 <= seg_new.y2))
+        {
+          //the following two rects overlap
+          int i = seg_new.index;
+          int j = list_it->index;
+#ifdef DEBUGINFO
+          cout << "SweepLine overlap bbox pair <" << i << "," << j << ">" << endl;
+#endif
+          if ((i < window_num && j >= window_num) || (j < window_num && i >= window_num))
+          {
+            if (j < window_num && i >= window_num)
+            {
+              int temp = i;
+              i = j;
+              j = temp;
+            }
+            
+            if (j-window_num < rect_num)
+            {
+              mergeRectRect(bbs[i], m_rects[rectid[j-window_num]], tempSubLayouts[i]);
+            }
+            else
+            {
+              if (j-window_num-rect_num >= poly_num)
+              {
+                cout << "ERROR: bbox index out of bound in " << __FILE__ << ":" << __LINE__ << endl;
+              }
+              else
+              {
+                mergeRectPolygon(bbs[i], m_polys[polyid[j-window_num-rect_num]], tempSubLayouts[i]);
+              }
+            }
+          }
+        }
+        ++list_it;
+      }
+      current.push_back(seg_new);
+    }
+  }
+  
+}
+
+//bounding box of the chip
+void FPMLayout::getChipBox(FPMPoint &lb, FPMPoint &ra)
 {
-  const int targetLayer = 10;
-  //bounding box of the chip
-  FPMPoint lb,ra;
   ra = lb = m_rects[0].lb;
   ra.x = ra.x + m_rects[0].width;
   ra.y = ra.y + m_rects[0].height;
@@ -473,6 +632,12 @@ void FPMLayout::createSubLayoutsOnWindow(int n)
       }
     }
   }
+}
+
+void FPMLayout::createSubLayoutsOnWindow(int n)
+{
+  FPMPoint lb,ra;
+  getChipBox(lb, ra);
   
   if (n != 0) {
     FPMPattern pattern;
@@ -501,10 +666,16 @@ void FPMLayout::createSubLayoutsOnWindow(int n)
     return;
   }
   
-  //compute the bounding boxes for each polygon and rectangle
-  vector<FPMRect> bbs;
-  vector<FPMPattern> tempSubLayouts;
-  
+  vector<FPMRect> windows;
+  getGridWindows(windows);
+  createSubLayoutsOn(windows, 11);
+}
+
+//overlapping windows over the whole chip
+void FPMLayout::getGridWindows(vector<FPMRect> &windows)
+{
+  FPMPoint lb,ra;
+  getChipBox(lb, ra);
   const int windowWidth = 4800;
   const int windowHeight = 4800;
   const int coreWidth = 1200;
@@ -524,106 +695,95 @@ void FPMLayout::createSubLayoutsOnWindow(int n)
       r.lb.y = r.lb.y + j * (windowHeight - coreHeight);
       r.width = windowWidth;
       r.height = windowHeight;
-      bbs.push_back(r);
-      
-      FPMPattern pt;
-      pt.bbox = r;
-      tempSubLayouts.push_back(pt);
+      windows.push_back(r);
     }
   }
-  vector<int> rectid;
-  for (int k = 0;k < m_rects.size();++k) {
-    if(m_rects[k].layer==targetLayer)
-    {
-      bbs.push_back(m_rects[k]);
-      rectid.push_back(k);
-    }
+}
+
+//one small window around every target layer shape whose normalized outline is
+//the anchor shape of some block, instead of windows over the whole chip;
+//keys[l] holds the anchor shapes of the library of TARGET_LAYERS[l]
+static int targetLayerIndex(int layer)
+{
+  return find(TARGET_LAYERS.begin(), TARGET_LAYERS.end(), layer) - TARGET_LAYERS.begin();
+}
+
+void FPMLayout::getAnchorWindows(const vector< set< vector<int> > > &keys, vector<FPMRect> &windows)
+{
+  const int anchorMargin = 1200;
+  vector<int> key;
+  int shape_num = 0;
+  for (int k = 0; k < m_rects.size(); ++ k)
+  {
+    int l = targetLayerIndex(m_rects[k].layer);
+    if (l == TARGET_LAYERS.size())
+      continue;
+    ++ shape_num;
+    FPMPoly p;
+    FPMPoint pt = m_rects[k].lb;
+    p.ptlist.push_back(pt);
+    pt.x += m_rects[k].width;
+    p.ptlist.push_back(pt);
+    pt.y += m_rects[k].height;
+    p.ptlist.push_back(pt);
+    pt.x -= m_rects[k].width;
+    p.ptlist.push_back(pt);
+    toGetShapeKey(p, key);
+    if (keys[l].find(key) != keys[l].end())
+      windows.push_back(m_rects[k]);
   }
-  vector<int> polyid;
-  for (int k = 0;k < m_polys.size();++k) {
-    if(m_polys[k].layer==targetLayer)
-    {
-      bbs.push_back(BBox(m_polys[k]));
-      polyid.push_back(k);
-    }
+  for (int k = 0; k < m_polys.size(); ++ k)
+  {
+    int l = targetLayerIndex(m_polys[k].layer);
+    if (l == TARGET_LAYERS.size())
+      continue;
+    ++ shape_num;
+    toGetShapeKey(m_polys[k], key);
+    if (keys[l].find(key) != keys[l].end())
+      windows.push_back(BBox(m_polys[k]));
   }
-  //check overlap
-  int bbox_num = (int)bbs.size();
-  int rect_num = (int)rectid.size();
-  int poly_num = (int)polyid.size();
-  vector<SweepLine> Info(2 * bbox_num);
-  for (long i = 0; i < bbox_num; i++)
+  for (int i = 0; i < windows.size(); ++ i)
   {
-    Info[2 * i].x = (double)bbs[i].lb.x;
-    Info[2 * i].index = i;
-    Info[2 * i].type = 0;
-    Info[2 * i + 1].x = (double)bbs[i].lb.x+bbs[i].width;
-    Info[2 * i + 1].index = i;
-    Info[2 * i + 1].type = 1;
+    windows[i].lb.x -= anchorMargin;
+    windows[i].lb.y -= anchorMargin;
+    windows[i].width += 2 * anchorMargin;
+    windows[i].height += 2 * anchorMargin;
   }
-  sort(Info.begin(), Info.end(), cmp);  
+  cout << windows.size() << " of " << shape_num << " shapes match an anchor shape" << endl;
+}
 
-  list<Seg> current;
-  for (int line = 0; line != (int)Info.size(); ++line)
+//windows to match: around the anchor shapes in anchor mode, else the grid;
+//returns the number of shapes a window needs to be matched
+int FPMLayout::chooseWindows(vector<FPMLibrary*> &libraries, vector<FPMRect> &windows)
+{
+  if (ANCHOR_MODE)
   {
-    Seg seg_new;
-    seg_new.index = Info[line].index;
-    seg_new.y1 = (double)bbs[Info[line].index].lb.y;
-    seg_new.y2 = (double)bbs[Info[line].index].lb.y+bbs[Info[line].index].height;
-    if (Info[line].type)
+    vector< set< vector<int> > > keys(libraries.size());
+    bool anchored = true;
+    for (int l = 0; l < libraries.size() && anchored; ++ l)
+      anchored = libraries[l]->getAnchorKeys(keys[l]);
+    if (anchored)
     {
-      current.remove(seg_new);
-    }
-    else
-    {
-      list<Seg>::iterator list_it = current.begin();
-      while (list_it != current.end())
-      {
-        if ((seg_new.y1 >= list_it->y1 && seg_new.y1 <= list_it->y2) || 
-        (list_it->y1 >= seg_new.y1 && list_it->y1 <= seg_new.y2))
-        {
-          //the following two rects overlap
-          int i = seg_new.index;
-          int j = list_it->index;
-#ifdef DEBUGINFO
-          cout << "SweepLine overlap bbox pair <" << i << "," << j << ">" << endl;
-#endif
-          if ((i < window_num && j >= window_num) || (j < window_num && i >= window_num))
-          {
-            if (j < window_num && i >= window_num)
-            {
-              int temp = i;
-              i = j;
-              j = temp;
-            }
-            
-            if (j-window_num < rect_num)
-            {
-              mergeRectRect(bbs[i], m_rects[rectid[j-window_num]], tempSubLayouts[i]);
-            }
-            else
-            {
-              if (j-window_num-rect_num >= poly_num)
-              {
-                cout << "ERROR: bbox index out of bound in " << __FILE__ << ":" << __LINE__ << endl;
-              }
-              else
-              {
-                mergeRectPolygon(bbs[i], m_polys[polyid[j-window_num-rect_num]], tempSubLayouts[i]);
-              }
-            }
-          }
-        }
-        ++list_it;
-      }
-      current.push_back(seg_new);
+      getAnchorWindows(keys, windows);
+      return 1;
     }
+    cout << "Some blocks are not anchored on a whole polygon, using windows" << endl;
   }
+  getGridWindows(windows);
+  return 11;
+}
+
+//clip all windows at once and keep the ones with at least min_shapes shapes
+void FPMLayout::createSubLayoutsOn(vector<FPMRect> &windows, int min_shapes)
+{
+  FPMMemScope mem(FPM_MEM_CLIP);
+  vector<FPMPattern> tempSubLayouts;
+  clipToWindows(windows, tempSubLayouts);
   
   m_subLayouts.clear();
   for (int i = 0; i < tempSubLayouts.size(); ++ i)
   {
-    if (tempSubLayouts[i].m_poly_fulls.size() + tempSubLayouts[i].rect_set.size() > 10)
+    if (tempSubLayouts[i].m_poly_fulls.size() + tempSubLayouts[i].rect_set.size() >= min_shapes)
     {
 //      cout << tempSubLayouts[i];
       m_subLayouts.push_back(tempSubLayouts[i]);
@@ -864,103 +1024,70 @@ void FPMLayout::createPatterns()
 //there are rectangles on layer 10 which remain to be consideration
 void FPMLayout::createPatterns() 
 {
-	const int targetLayer = 10;
-	const int coreLayer1 = 21;
-	const int coreLayer2 = 22;
-	
-	vector<FPMPoly> target_polys;
-	for (int i = 0; i < m_polys.size(); ++ i)
-	{
-		if (m_polys[i].layer == targetLayer)
-		{
-			m_polys[i].makeCounterClockwise();
-			target_polys.push_back(m_polys[i]);
-		}
-	}
-	
+	createPatternsOnCores(21, 22);
+}
+void FPMLayout::createGoodPatterns() 
+{
+	createPatternsOnCores(23, -1);
+}
+
+//one pattern per core rectangle and target layer, cut from that layer's shapes only
+void FPMLayout::createPatternsOnCores(int coreLayer1, int coreLayer2) 
+{
 	vector<FPMRect> core_rects;
-	vector<FPMRect> target_rects;
 	for (int i = 0; i < m_rects.size(); ++ i)
 	{
 		if (m_rects[i].layer == coreLayer1 || m_rects[i].layer == coreLayer2)
 		{
 			core_rects.push_back(m_rects[i]);
 		}
-		else if (m_rects[i].layer == targetLayer)
-		{
-			target_rects.push_back(m_rects[i]);
-		}
 	}
 	
-	//cout << "------------- merge -------------" << endl;
-	//cout << core_rects.size() << endl;
-	for (int i = 0; i < core_rects.size(); ++ i)
+	for (int l = 0; l < TARGET_LAYERS.size(); ++ l)
 	{
-		//cout << core_rects[i];
-		FPMPattern pt;
-		for (int j = 0; j < target_polys.size(); ++ j)
+		const int targetLayer = TARGET_LAYERS[l];
+		vector<FPMPoly> target_polys;
+		for (int i = 0; i < m_polys.size(); ++ i)
 		{
-		  mergeRectPolygon(core_rects[i],target_polys[j],pt);
+			if (m_polys[i].layer == targetLayer)
+			{
+				m_polys[i].makeCounterClockwise();
+				target_polys.push_back(m_polys[i]);
+			}
 		}
 		
-		for (int j = 0; j < target_rects.size(); ++ j)
-		{
-			mergeRectRect(core_rects[i],target_rects[j],pt);
-		}
-	        pt.bbox = core_rects[i];	
-		m_patterns.push_back(pt);
-		//cout << pt;
-	}
-	
-}
-void FPMLayout::createGoodPatterns() 
-{
-	const int targetLayer = 10;
-	const int coreLayer1 = 23;
-	
-	
-	vector<FPMPoly> target_polys;
-	for (int i = 0; i < m_polys.size(); ++ i)
-	{
-		if (m_polys[i].layer == targetLayer)
+		vector<FPMRect> target_rects;
+		for (int i = 0; i < m_rects.size(); ++ i)
 		{
-			m_polys[i].makeCounterClockwise();
-			target_polys.push_back(m_polys[i]);
-		}
-	}
-	
-	vector<FPMRect> core_rects;
-	vector<FPMRect> target_rects;
-	for (int i = 0; i < m_rects.size(); ++ i)
-	{
-		if (m_rects[i].layer == coreLayer1)
-		{
-			core_rects.push_back(m_rects[i]);
-		}
-		else if (m_rects[i].layer == targetLayer)
-		{
-			target_rects.push_back(m_rects[i]);
-		}
-	}
-	
-	//cout << "------------- merge -------------" << endl;
-	//cout << core_rects.size() << endl;
-	for (int i = 0; i < core_rects.size(); ++ i)
-	{
-		//cout << core_rects[i];
-		FPMPattern pt;
-		for (int j = 0; j < target_polys.size(); ++ j)
-		{
-		  mergeRectPolygon(core_rects[i],target_polys[j],pt);
+			if (m_rects[i].layer == targetLayer)
+			{
+				target_rects.push_back(m_rects[i]);
+			}
 		}
 		
+		//cout << "------------- merge -------------" << endl;
+		//cout << core_rects.size() << endl;
+		FPMRectArray target_array;
 		for (int j = 0; j < target_rects.size(); ++ j)
+			target_array.add(target_rects[j]);
+		for (int i = 0; i < core_rects.size(); ++ i)
 		{
-			mergeRectRect(core_rects[i],target_rects[j],pt);
+			//cout << core_rects[i];
+			FPMPattern pt;
+			for (int j = 0; j < target_polys.size(); ++ j)
+			{
+			  mergeRectPolygon(core_rects[i],target_polys[j],pt);
+			}
+			
+			mergeRectRects(core_rects[i],target_array,target_rects,pt);
+			pt.bbox = core_rects[i];
+			pt.layer = targetLayer;
+			//a core may have nothing on one of several layers
+			if (TARGET_LAYERS.size() > 1 && pt.m_poly_fulls.empty() && pt.rect_set.empty())
+				continue;
+			m_patterns.push_back(pt);
+			//cout << pt;
 		}
-	        pt.bbox = core_rects[i];	
-		m_patterns.push_back(pt);
-		//cout << pt;
 	}
 	
 }
@@ -1012,6 +1139,9 @@ void FPMLayout::mergeRectPolygon(FPMRect& r,FPMPoly& p,FPMPattern& pt)
   	return;
   }
   
+  //the engine is charged to kbool, the pieces to the caller
+  int tag = getMemTag();
+  FPMMemScope mem(FPM_MEM_KBOOL);
 	KBool::Kbool4Router kbr;
   KBool::Bool_Engine booleng;
 	
@@ -1043,6 +1173,7 @@ void FPMLayout::mergeRectPolygon(FPMRect& r,FPMPoly& p,FPMPattern& pt)
   while (booleng.StartPolygonGet())
   {
   	//Points in the polygon are in clockwise order, and intermediate points are not removed
+    FPMMemScope piece_mem(tag);
     FPMPoly polygon;
     while(booleng.PolygonHasMorePoints())
     {
@@ -1155,6 +1286,32 @@ void FPMLayout::mergeRectRect(FPMRect& r1,FPMRect& r2,FPMPattern& pt)
   return;
 }
 
+//mergeRectRect of r with every rectangle of source at once, rects holds source
+//in array form
+void FPMLayout::mergeRectRects(FPMRect& r,const FPMRectArray& rects,vector<FPMRect>& source,FPMPattern& pt)
+{
+  vector<int> hit;
+  FPMRectArray clipped;
+  clipRects(r, rects, 0, hit, &clipped);
+  for (int k = 0; k < hit.size(); ++ k)
+  {
+    FPMPoint lb,rb,ra,la;
+    la.x = lb.x = clipped.lx[k];
+    lb.y = rb.y = clipped.by[k];
+    ra.x = rb.x = clipped.rx[k];
+    la.y = ra.y = clipped.ty[k];
+    
+    FPMPoly_full pf;
+    pf.p.layer = source[hit[k]].layer;
+    pf.p.ptlist.push_back(lb);
+    pf.p.ptlist.push_back(rb);
+    pf.p.ptlist.push_back(ra);
+    pf.p.ptlist.push_back(la);
+    pf.full = (ra.x - la.x == source[hit[k]].width && la.y - lb.y == source[hit[k]].height);
+    pt.m_poly_fulls.push_back(pf);
+  }
+}
+
 
 void FPMLayout::patternRotation(FPMPattern &pt, vector<FPMPattern> &rotatePatterns)
 {
@@ -1606,7 +1763,6 @@ void FPMLayout:: drawRects(FPMPattern pattern,char* filename)
 
 void FPMLayout::createSubLayouts() 
 {
-	const int targetLayer = 10;
 //.....................
 	const int coreLayer1 = 11;
 	const int coreLayer2 = 12;
@@ -1614,7 +1770,7 @@ void FPMLayout::createSubLayouts()
 	vector<FPMPoly> target_polys;
 	for (int i = 0; i < m_polys.size(); ++ i)
 	{
-		if (m_polys[i].layer == targetLayer)
+		if (isTargetLayer(m_polys[i].layer))
 		{
 			m_polys[i].makeCounterClockwise();
 			target_polys.push_back(m_polys[i]);
@@ -1629,7 +1785,7 @@ void FPMLayout::createSubLayouts()
 		{
 			core_rects.push_back(m_rects[i]);
 		}
-		else if (m_rects[i].layer == targetLayer)
+		else if (isTargetLayer(m_rects[i].layer))
 		{
 			target_rects.push_back(m_rects[i]);
 		}
@@ -1637,6 +1793,9 @@ void FPMLayout::createSubLayouts()
 	
 	//cout << "------------- merge -------------" << endl;
 	//cout << core_rects.size() << endl;
+	FPMRectArray target_array;
+	for (int j = 0; j < target_rects.size(); ++ j)
+		target_array.add(target_rects[j]);
 	for (int i = 0; i < core_rects.size(); ++ i)
 	{
 		//cout << core_rects[i];
@@ -1646,10 +1805,7 @@ void FPMLayout::createSubLayouts()
 		  mergeRectPolygon(core_rects[i],target_polys[j],pt);
 		}
 		
-		for (int j = 0; j < target_rects.size(); ++ j)
-		{
-			mergeRectRect(core_rects[i],target_rects[j],pt);
-		}
+		mergeRectRects(core_rects[i],target_array,target_rects,pt);
 		pt.bbox = core_rects[i];	
 		m_subLayouts.push_back(pt);
 		//cout << pt;
@@ -2138,6 +2294,126 @@ static void drawResult(FPMPattern &pat, FPMPattern &layout, vector<GNULine*> &lv
   plot.draw(file.c_str());
 }
 
+//window graph: edges, ring and sweep edges, pruned by the library and split into components
+void FPMLayout::buildWindowGraph(FPMLibrary &library, FPMWindowJob &job)
+{
+  FPMMemScope mem(FPM_MEM_GRAPH);
+  FPMPattern &window=*job.window;
+  FPMTempEdgeVector layoutRing,layoutEdge_horizontal,layoutEdge_vertical;
+  job.layoutEdge.clear();
+  generateEdge(window);
+  layoutRing=generateRing(window);
+  SweepEdgeHorizontal(window, layoutEdge_horizontal);
+  SweepEdgeVertical(window, layoutEdge_vertical);
+  job.layoutEdge.insert(job.layoutEdge.begin(),layoutRing.begin(),layoutRing.end());
+  job.layoutEdge.insert(job.layoutEdge.begin(),layoutEdge_horizontal.begin(),layoutEdge_horizontal.end());
+  job.layoutEdge.insert(job.layoutEdge.begin(),layoutEdge_vertical.begin(),layoutEdge_vertical.end());
+
+  //connected blocks are matched per window component, the others against all kept nodes
+  job.node_num=window.m_edge.size();
+  job.pruned_num=library.pruneTarget(job.node_num,job.layoutEdge,job.keep);
+  toGetComponents(job.node_num,job.layoutEdge,job.keep,library.getMinNodes(),true,job.components);
+  if (library.needWholeGraph())
+    toGetComponents(job.node_num,job.layoutEdge,job.keep,library.getMinNodes(),false,job.whole);
+}
+
+//the window is a hit once MATCH_COUNT blocks matched, the last one locates it
+void FPMLayout::matchWindow(FPMLibrary &library, FPMWindowState &ws, FPMWindowJob &job)
+{
+  FPMMemScope mem(FPM_MEM_MATCH);
+  int match_count=0;
+  library.beginWindow(ws,job.components,job.whole);
+  for(int j=0;j<library.getBlockNum();j++)
+  {
+    vector<FPMResultPair> result;
+    library.matchBlock(ws,j,result);
+    if(result.size()!=0)
+    {
+      match_count++;
+      int first=0;
+      if(match_count==MATCH_COUNT)
+      {
+        job.hit=true;
+        job.result=result[0];
+        job.result_num=library.getBlock(j).graph->NodeCount();
+        first=1;
+      }
+      for (int x = first; x < result.size(); ++ x)
+      {
+        delete[] result[x].sub_result;
+        delete[] result[x].target_result;
+      }
+      result.clear();
+      if(job.hit)
+        break;
+    }
+  }
+  library.endWindow(ws);
+}
+
+void FPMLayout::collectWindow(FPMWindowJob &job, vector<FPMPoint> &mset)
+{
+  FPMMemScope mem(FPM_MEM_COLLECT);
+  FPMPattern &window=*job.window;
+  if(job.hit)
+  {
+    reOutput(window,job.result,mset,job.result_num);
+    delete[] job.result.sub_result;
+    delete[] job.result.target_result;
+    job.hit=false;
+  }
+  clearComponents(job.components);
+  clearComponents(job.whole);
+  window.m_edge_vector.clear();
+  window.m_edge.clear();
+  window.vertical_edge.clear();
+  window.horizontal_edge.clear();
+  window.m_poly_fulls.clear();
+  if(job.own)
+    delete job.window;
+  job.window=NULL;
+}
+
+//the jobs of one window: the window itself for a single target layer, else one
+//view per layer holding only that layer's shapes, numbered index*layers+layer
+void FPMLayout::makeWindowJobs(int index, FPMPattern *window, bool own, vector<FPMWindowJob*> &jobs)
+{
+  FPMMemScope mem(FPM_MEM_CLIP);
+  int layer_num=TARGET_LAYERS.size();
+  if(layer_num==1)
+  {
+    jobs.push_back(new FPMWindowJob(index,window,own));
+    return;
+  }
+  for(int l=0;l<layer_num;l++)
+  {
+    FPMPattern *view=new FPMPattern;
+    view->bbox=window->bbox;
+    view->layer=TARGET_LAYERS[l];
+    for(int k=0;k<window->m_poly_fulls.size();k++)
+    {
+      if(window->m_poly_fulls[k].p.layer==view->layer)
+        view->m_poly_fulls.push_back(window->m_poly_fulls[k]);
+    }
+    for(int k=0;k<window->rect_set.size();k++)
+    {
+      if(window->rect_set[k].layer==view->layer)
+        view->rect_set.push_back(window->rect_set[k]);
+    }
+    if(view->m_poly_fulls.empty()&&view->rect_set.empty())
+    {
+      delete view;
+      continue;
+    }
+    FPMWindowJob *job=new FPMWindowJob(index*layer_num+l,view,true);
+    job->layer=l;
+    jobs.push_back(job);
+  }
+  window->m_poly_fulls.clear();
+  if(own)
+    delete window;
+}
+
 void FPMLayout::test(std::vector<FPMPattern> record_patterns,bool isBad)
 {
   printf("Number of sublayouts: %d\n", m_subLayouts.size());
@@ -2160,236 +2436,119 @@ void FPMLayout::test(std::vector<FPMPattern> record_patterns,bool isBad)
   }
   */
   
-  //small block FPMTempEdgeVector and F array
-  FPMTempEdgeVector blockEdge;
-  vector<FPMTempEdgeVector> bl_vector;
-  FPMEdgeVector medge_vector;
-  vector<int*> bF_vector;
-  int wcount=0,match_count=0;
-  vector<FPMEdgeVector> medgeVector;
-  vector<FPMRect> bbox_vector;
-  
-  int add_count=0;
-  int boundArray[4]={0,0,0,0};
-  FPMTempEdgeVector patternEdge,layoutEdge, patternRing,patternEdge_vertical,patternEdge_horizontal,layoutRing,layoutEdge_horizontal,layoutEdge_vertical;
-  vector<FPMTempEdgeVector> pe_vector;
-  
-  vector<ARGraph<void,int> *> pattern_graph_vector;
-  ARGraph<void,int> * sublayout_graph = NULL;
-  vector<int*> weight_sub;
-  int* weight_target = NULL;
-  for(int j=0;j<record_patterns.size();j++)
+  //compile small blocks of all the recorded patterns, one library per target layer
+  int layer_num=TARGET_LAYERS.size();
+  vector<FPMLibrary*> libraries(layer_num);
+  for(int l=0;l<layer_num;l++)
   {
-    //cout<<"pattern num "<<j<<endl;
-    if(patternEdge.size()!=0)patternEdge.clear();
-    //cout<<"aaaa "<<endl;
-    if(patternRing.size()!=0)patternRing.clear();
-    //cout<<"bbbb "<<endl;
-    if(patternEdge_horizontal.size()!=0)patternEdge_horizontal.clear();
-    //cout<<"cccc "<<endl;
-    if(patternEdge_vertical.size()!=0)patternEdge_vertical.clear();
-    //cout<<"dddd "<<endl;
-    generateEdge(record_patterns[j]);
-    //cout<<"generate edge finished"<<endl;
-    patternRing=generateRing(record_patterns[j]);
-    //cout<<"generate ring finished"<<endl;
-    SweepEdgeHorizontal(record_patterns[j], patternEdge_horizontal);
-    //cout<<"construct horizontal finished"<<endl;
-    SweepEdgeVertical(record_patterns[j], patternEdge_vertical);
-    //cout<<"construct vertical finished"<<endl;
-    //get all the edge together
-    patternEdge.insert(patternEdge.begin(),patternRing.begin(),patternRing.end());
-    patternEdge.insert(patternEdge.begin(),patternEdge_horizontal.begin(),patternEdge_horizontal.end());
-    patternEdge.insert(patternEdge.begin(),patternEdge_vertical.begin(),patternEdge_vertical.end());             
-    //cout<<"construct patternEdge finished"<<endl;           
-    deleteBound(patternEdge, record_patterns[j]);
-          
-          /*****************construct small block******************/
-          int min_x,min_y,max_x,max_y,amin_x,amin_y,amax_x,amax_y;
-          for(int m=0;m<record_patterns[j].m_poly_fulls.size();m++)
-          {
-              //cout<<"come in block"<<endl;
-              //get bounding box of poly then decide the near area
-              add_count=0;
-              min_x=record_patterns[j].m_poly_fulls[m].p.ptlist[0].x;
-              min_y=record_patterns[j].m_poly_fulls[m].p.ptlist[0].y;
-              max_x=record_patterns[j].m_poly_fulls[m].p.ptlist[0].x;
-              max_y=record_patterns[j].m_poly_fulls[m].p.ptlist[0].y;
-              for(int p=0;p<record_patterns[j].m_poly_fulls[m].p.ptlist.size();p++)
-              {
-                  if(min_x>record_patterns[j].m_poly_fulls[m].p.ptlist[p].x)
-                    min_x=record_patterns[j].m_poly_fulls[m].p.ptlist[p].x;
-                  if(min_y>record_patterns[j].m_poly_fulls[m].p.ptlist[p].y)
-                    min_y=record_patterns[j].m_poly_fulls[m].p.ptlist[p].y;
-                  if(max_x<record_patterns[j].m_poly_fulls[m].p.ptlist[p].x)
-                    max_x=record_patterns[j].m_poly_fulls[m].p.ptlist[p].x;
-                  if(max_y<record_patterns[j].m_poly_fulls[m].p.ptlist[p].y)
-                    max_y=record_patterns[j].m_poly_fulls[m].p.ptlist[p].y;
-              }
-              //near area of poly m
-              amin_x=min_x-S1_DISTANCE;
-              amax_x=max_x+S1_DISTANCE;
-              amin_y=min_y-S1_DISTANCE;
-              amax_y=max_y+S1_DISTANCE;
-              //drawArea(record_patterns[j],amin_x,amin_y,amax_x,amax_y);
-              blockEdge.clear();
-              medge_vector.clear();
-              
-              //cout<<"after clear vector"<<endl;
-              for(int q=0;q<patternEdge.size();q++)
-              {
-                 //cout<<"come in patternEdge "<<q<<endl;
-                 if(record_patterns[j].m_edge[patternEdge[q].tempNode.first].belong_id==m)
-                 {
-                     
-                     //vertical edge
-                     if(record_patterns[j].m_edge[patternEdge[q].tempNode.second].type==0)
-                     {
-                         //vertical edge judge
-                         if((record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y<amax_y)||(record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y+record_patterns[j].m_edge[patternEdge[q].tempNode.second].length>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y+record_patterns[j].m_edge[patternEdge[q].tempNode.second].length<amax_y))
-                          {
-                             //in the naer area
-                             blockEdge.push_back(patternEdge[q]);
-                             if(record_patterns[j].m_edge[patternEdge[q].tempNode.second].belong_id!=m)add_count++;
-                          }
-                     }
-                     //horizontal edge
-                     else
-                     {
-                          //horizontal edge judge
-                          if((record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y<amax_y)||(record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x+record_patterns[j].m_edge[patternEdge[q].tempNode.second].length>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x+record_patterns[j].m_edge[patternEdge[q].tempNode.second].length<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y<amax_y))
-                          {
-                             //in the naer area
-                             blockEdge.push_back(patternEdge[q]);
-                             if(record_patterns[j].m_edge[patternEdge[q].tempNode.second].belong_id!=m)add_count++;
-
-                          }
-
-                     }
-                 }
-                 else if(record_patterns[j].m_edge[patternEdge[q].tempNode.second].belong_id==m)
-                 {
-                    //vertical
-                    if(record_patterns[j].m_edge[patternEdge[q].tempNode.first].type==0)
-                    {
-                         if((record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y<amax_y)||(record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y+record_patterns[j].m_edge[patternEdge[q].tempNode.first].length>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y+record_patterns[j].m_edge[patternEdge[q].tempNode.first].length<amax_y))
-                         {
-                           //in the naer area
-                           blockEdge.push_back(patternEdge[q]);
-                           if(record_patterns[j].m_edge[patternEdge[q].tempNode.first].belong_id!=m)add_count++;
-
-                         }
-                    }
-                    //horizontal
-                    else
-                    {
-                         if((record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y<amax_y)||(record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x+record_patterns[j].m_edge[patternEdge[q].tempNode.first].length>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x+record_patterns[j].m_edge[patternEdge[q].tempNode.first].length<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y<amax_y))
-                         {
-                           //in the naer area
-                           blockEdge.push_back(patternEdge[q]);
-                           if(record_patterns[j].m_edge[patternEdge[q].tempNode.first].belong_id!=m)add_count++;
-                         }
-                    }
-                 }
-              }
-              //cout<<"come in construct sub graph "<<blockEdge.size()<<endl;
-              
-              if(blockEdge.size()!=0&&add_count>=ADD_COUNT)
-              {
-                 //cout<<blockEdge<<endl;
-                 medge_vector=GetNodeSize(blockEdge,record_patterns[j]);
-                
-                 if(medge_vector.size()>=MEDGE_SIZE)
-                 {
-                    bbox_vector.push_back(record_patterns[j].bbox);
-                    bl_vector.push_back(blockEdge);
-                    medgeVector.push_back(medge_vector);
-                     int* nF=calcF(medge_vector);
-                     int* ws=new int[blockEdge.size()];
-                     bF_vector.push_back(nF);
-                     weight_sub.push_back(ws);
-                     pattern_graph_vector.push_back(toGetSubG(medge_vector.size(),blockEdge,nF,weight_sub[wcount]));
-                     wcount++;
-                 }
-              }
-          }
-   }
-    
-   bool flag;
-   int miss_match=0;
-  // FPMPatternVectorIter piter=m_subLayouts.begin();
-   
-   for(int i=0;i<m_subLayouts.size();i++)
-   {  
+    FPMMemScope mem(FPM_MEM_LIBRARY);
+    libraries[l]=new FPMLibrary;
+    if(layer_num==1)
+    {
+      libraries[l]->compile(*this,record_patterns);
+      continue;
+    }
+    vector<FPMPattern> layer_patterns;
+    for(int i=0;i<record_patterns.size();i++)
+    {
+      if(record_patterns[i].layer==TARGET_LAYERS[l])
+        layer_patterns.push_back(record_patterns[i]);
+    }
+    printf("Layer %d: %d patterns\n", TARGET_LAYERS[l], (int)layer_patterns.size());
+    libraries[l]->compile(*this,layer_patterns);
+  }
+  printMemStat("after compiling");
+  //generated matchers are specific to one library
+  if (layer_num == 1 && EMIT_FILE != NULL)
+    libraries[0]->emitMatchers(EMIT_FILE);
+  if (layer_num == 1 && PLUGIN_FILE != NULL)
+    libraries[0]->loadPlugin(PLUGIN_FILE);
+
+  //windows are numbered the same way only with the same input and setup, and they
+  //match the same way only with the same limits; any change starts a new log
+  FPMCheckpoint checkpoint;
+  FPMCheckpoint *done=NULL;
+  if (CHECKPOINT_FILE != NULL)
+  {
+    struct stat st;
+    long long size=-1,mtime=-1;
+    if (stat(m_inputFileName.c_str(),&st)==0)
+    {
+      size=st.st_size;
+      mtime=st.st_mtime;
+    }
+    ostringstream setup;
+    setup<<"FPM checkpoint: input "<<m_inputFileName<<" "<<size<<" "<<mtime<<", layers";
+    for(int l=0;l<layer_num;l++)
+      setup<<" "<<TARGET_LAYERS[l];
+    setup<<", anchor "<<ANCHOR_MODE<<", pipeline "<<(MATCH_THREADS>0)<<", "<<record_patterns.size()<<" patterns";
+    setup<<", distance "<<S1_DISTANCE<<" "<<S2_DISTANCE<<", match count "<<MATCH_COUNT<<", medge "<<MEDGE_SIZE<<", add "<<ADD_COUNT;
+    setup<<", diff "<<WIDTH_DIFF<<" "<<HEIGHT_DIFF<<" "<<GRAPH_EDGE_DIFF<<" "<<POLY_EDGE_DIFF<<" "<<CLUSTER_DIFF;
+    if (checkpoint.open(CHECKPOINT_FILE,setup.str(),RESUME_MODE))
+      done=&checkpoint;
+  }
+
+  long total_nodes=0,pruned_nodes=0;
+  vector<int> layer_hits(layer_num,0);
+  FPMWindowState ws;
+  if (MATCH_THREADS > 0)
+  {
+    runPipeline(libraries,mset,total_nodes,pruned_nodes,ws,layer_hits,done);
+  }
+  else
+  {
+    //anchor mode: windows only around shapes some block is anchored on
+    if (ANCHOR_MODE && m_subLayouts.empty())
+    {
+      vector<FPMRect> windows;
+      int min_shapes=chooseWindows(libraries,windows);
+      createSubLayoutsOn(windows,min_shapes);
+    }
+    for(int i=0;i<m_subLayouts.size();i++)
+    {
       cout<<"layout num "<<i<<endl;
-      match_count=0;
-      flag=false;
-      layoutEdge.clear();
-      
-      generateEdge(m_subLayouts[i]);
-      layoutRing=generateRing(m_subLayouts[i]);
-      SweepEdgeHorizontal(m_subLayouts[i], layoutEdge_horizontal);
-      SweepEdgeVertical(m_subLayouts[i], layoutEdge_vertical);
-      layoutEdge.insert(layoutEdge.begin(),layoutRing.begin(),layoutRing.end());
-      layoutEdge.insert(layoutEdge.begin(),layoutEdge_horizontal.begin(),layoutEdge_horizontal.end());
-      layoutEdge.insert(layoutEdge.begin(),layoutEdge_vertical.begin(),layoutEdge_vertical.end());
-     
-      //draw subLayouts
-      //drawLines(m_subLayouts[i],"subLayout");
-      //getchar();
-      if (weight_target)
+      vector<FPMWindowJob*> jobs;
+      makeWindowJobs(i,&m_subLayouts[i],false,jobs);
+      for(int j=0;j<jobs.size();j++)
       {
-        delete []weight_target;
-        weight_target = NULL;
-      }
-      //point_target[i]=new int[m_subLayouts[i].m_edge.size()];
-     // for(int yu=0;yu<m_subLayouts[i].m_edge.size();yu++)
-      //  point_target[i][yu]=m_subLayouts[i].m_edge[yu].length;
-      if (sublayout_graph)
-      {
-        delete sublayout_graph;
-        sublayout_graph = NULL;
+        FPMWindowJob &job=*jobs[j];
+        vector<FPMPoint> points;
+        if(done!=NULL&&done->isDone(job.index))
+        {
+          //matched before the resume, only release the window
+          collectWindow(job,points);
+          points=done->getPoints(job.index);
+        }
+        else
+        {
+          FPMLibrary &library=*libraries[job.layer];
+          buildWindowGraph(library,job);
+          matchWindow(library,ws,job);
+          if(job.hit)
+            layer_hits[job.layer]++;
+          collectWindow(job,points);
+          total_nodes+=job.node_num;
+          pruned_nodes+=job.pruned_num;
+          if(done!=NULL)
+            done->record(job.index,points);
+        }
+        mset.insert(mset.end(),points.begin(),points.end());
+        delete jobs[j];
       }
-      
-      weight_target=new int[layoutEdge.size()];
-      sublayout_graph = toGetTargetG(m_subLayouts[i].m_edge.size(),layoutEdge,weight_target);
-       
-       for(int j=0;j<bl_vector.size();j++)
-       { 
-         //cout<<"bl_vector num: "<<j<<endl;
-         vector<FPMResultPair> result;
-         toMatchEdge(pattern_graph_vector[j],sublayout_graph,medgeVector[j].size(),bF_vector[j], result);
-          if(result.size()!=0)
-          {
-             match_count++;
-             if(match_count==MATCH_COUNT)
-             {
-                 reOutput(m_subLayouts[i],result[0],mset,pattern_graph_vector[j]->NodeCount());
-             	  // drawEdge(medgeVector[j],bbox_vector[j]);
-                 break;
-             }
-             for (int x = 0; x < result.size(); ++ x) 
-             {
-               delete[] result[x].sub_result;
-               delete[] result[x].target_result;
-             }
-      	     result.clear();
-          }
-       }
-       m_subLayouts[i].m_edge_vector.clear();
-       m_subLayouts[i].m_edge.clear();
-       m_subLayouts[i].vertical_edge.clear();
-       m_subLayouts[i].horizontal_edge.clear();
-       m_subLayouts[i].m_poly_fulls.clear();
-   }
+    }
+  }
+  printMemStat("after matching");
+  for(int l=0;l<layer_num;l++)
+  {
+    if(layer_num>1)
+      printf("Layer %d: %d windows matched\n", TARGET_LAYERS[l], layer_hits[l]);
+    delete libraries[l];
+  }
    
-   /*///////////////JUST Comment it -- HY   
-   for(int i=0;i<weight_sub.size();i++)
-   { 
-   	 delete [] weight_sub[i];
-   }
-   weight_sub.clear();
-   */
+   if (total_nodes > 0)
+     printf("Library pruning removed %ld of %ld window nodes\n", pruned_nodes, total_nodes);
+   printf("Cluster representatives skipped %ld block tests\n", ws.skipNum);
+   printf("Subset blocks skipped %ld block tests\n", ws.subsetSkipNum);
    
   //remove redundancy
   for (int i = 0; i < mset.size(); ++ i)
@@ -2409,11 +2568,6 @@ void FPMLayout::test(std::vector<FPMPattern> record_patterns,bool isBad)
   else
     good_point.insert(good_point.begin(),mset.begin(),mset.end());
   
-  for(int j = 0; j < bF_vector.size(); ++j)
-  {
-    delete []bF_vector[j];
-  }
-  bF_vector.clear();		
 }
 
 static bool within_rect( FPMPoint &pt, FPMRect &rect )
@@ -4,16 +4,24 @@
 #include <string>
 #include <vector>
 #include <utility>
+#include <set>
 #include "FPMRect.h"
 #include "FPMPoly.h"
 #include "FPMPattern.h"
 #include "FPMTempEdge.h"
+#include "FPMRectArray.h"
 #include "math.h"
 #include "Plot.h"
 using namespace std;
 using namespace PLOT;
 namespace FPM {
 
+class FPMLibrary;
+struct FPMWindowState;
+struct FPMWindowJob;
+class FPMWindowSink;
+class FPMCheckpoint;
+
 typedef struct _PMPoint
 {
    int x;
@@ -28,6 +36,7 @@ public:
   void storeCoreRects();
   void compScore(vector<FPMPoint> &mset);
   void setOutputFileName(std::string fileName) { m_outputFileName = fileName; }
+  void setInputFileName(std::string fileName) { m_inputFileName = fileName; }
 /*****wangqin changed*******/
 //  void patternRotation(FPMPattern& pt);
 //  void patternSymmetry(FPMPattern& pt);
@@ -66,6 +75,15 @@ public:
   //getRing(FPMPattern &pattern,bool type);
   FPMTempEdgeVector getRing(FPMPattern &pattern,bool type);
   void test(std::vector<FPMPattern> record_patterns,bool isBad);
+  //window stages, run inline or by the pipeline threads (see FPMPipeline.h)
+  void buildWindowGraph(FPMLibrary &library, FPMWindowJob &job);
+  void matchWindow(FPMLibrary &library, FPMWindowState &ws, FPMWindowJob &job);
+  void collectWindow(FPMWindowJob &job, std::vector<FPMPoint> &mset);
+  void runPipeline(std::vector<FPMLibrary*> &libraries, std::vector<FPMPoint> &mset, long &total_nodes, long &pruned_nodes,
+                   FPMWindowState &stats, std::vector<int> &layer_hits, FPMCheckpoint *checkpoint);
+  int chooseWindows(std::vector<FPMLibrary*> &libraries, std::vector<FPMRect> &windows);
+  void makeWindowJobs(int index, FPMPattern *window, bool own, std::vector<FPMWindowJob*> &jobs);
+  void clipToWindows(std::vector<FPMRect> &windows, std::vector<FPMPattern> &subLayouts, FPMWindowSink *sink = NULL, int min_shapes = 0);
   
   int* deleteEdge(FPMPattern &pattern);
   int* calcF(const FPMEdgeVector &edge_vector);
@@ -93,6 +111,11 @@ void clear() {
   int getRectNum() { return m_rects.size(); }
   
   void addPoly(FPMPoly &p);
+  //readers build polygons in place: fill the ptlist of newPoly(), then
+  //checkNewPoly() drops it again if addPoly() would have refused it
+  FPMPoly &newPoly(int layer);
+  void checkNewPoly();
+  void reservePolys(int n);
   std::vector<FPMPoly> &getPolys() { return m_polys; }
 	int getPolyNum() { return m_polys.size(); }
 	
@@ -113,6 +136,7 @@ void clear() {
 private:
   int subLayouts_inisize;
   std::string m_outputFileName;
+  std::string m_inputFileName;//names the checkpoint setup
   std::vector<FPMRect> m_coreRects;
   std::vector<FPMRect> m_rects;
   std::vector<FPMPoly> m_polys;
@@ -123,10 +147,16 @@ private:
   std::vector<FPMPattern> record_patterns;
   void mergeRectPolygon(FPMRect& r,FPMPoly& p,FPMPattern& pt);
   void mergeRectRect(FPMRect& r1,FPMRect& r2,FPMPattern& pt);
+  void mergeRectRects(FPMRect& r,const FPMRectArray& rects,vector<FPMRect>& source,FPMPattern& pt);
   void mergeRectRectToRect(FPMRect& r1,FPMRect& r2,FPMPattern& pt,int& id); 
   bool checkOverlap(FPMRect& r1,FPMRect& r2);
   void createSubLayoutsOnFrame();
   void createSubLayoutsOnWindow(int n);
+  void createSubLayoutsOn(std::vector<FPMRect> &windows, int min_shapes);
+  void getChipBox(FPMPoint &lb, FPMPoint &ra);
+  void getGridWindows(std::vector<FPMRect> &windows);
+  void getAnchorWindows(const std::vector< std::set< std::vector<int> > > &keys, std::vector<FPMRect> &windows);
+  void createPatternsOnCores(int coreLayer1, int coreLayer2);
   
   inline int minint(int a,int b) { if(a < b) return a; else return b;}
   inline int maxint(int a,int b) { if(a < b) return b; else return a;}
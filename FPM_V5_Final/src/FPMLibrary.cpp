@@ -0,0 +1,651 @@
+#include <iostream>
+#include <algorithm>
+#include "FPMLibrary.h"
+#include "FPMLayout.h"
+#include "FPMTempEdge.h"
+#include "FPMMatch.h"
+#include "EdgeComparator.h"
+#include "vf2_state.h"
+#include "vf2_sub_state.h"
+#include "match.h"
+#include "FPMMemory.h"
+
+extern int S1_DISTANCE;
+extern int MEDGE_SIZE;
+extern int ADD_COUNT;
+extern int GRAPH_EDGE_DIFF;
+extern int CLUSTER_DIFF;
+
+//blocks with more automorphisms are matched without symmetry breaking
+const int FPM_AUT_MAX = 1000;
+
+namespace FPM {
+using namespace std;
+
+void FPMLibrary::clear()
+{
+  for(int i=0;i<m_blocks.size();i++)
+  {
+    delete m_blocks[i].graph;
+    delete [] m_blocks[i].weight;
+    delete [] m_blocks[i].F;
+    delete m_blocks[i].exact;
+    delete [] m_blocks[i].exact_weight;
+  }
+  m_blocks.clear();
+  m_plugin.close();
+  for(int i=0;i<m_clusters.size();i++)
+  {
+    delete m_clusters[i].graph;
+    delete [] m_clusters[i].weight;
+  }
+  m_clusters.clear();
+  m_weights.clear();
+  m_weightCount.clear();
+  m_patternNum = 0;
+  m_minNodes = INT_MAX;
+  m_minDegree = INT_MAX;
+  m_needWholeGraph = false;
+}
+
+void FPMLibrary::addBlock(FPMBlock &block)
+{
+  m_blocks.push_back(block);
+  for(int i=0;i<block.edges.size();i++)
+  {
+    int w=block.edges[i].weight;
+    if(m_weightCount[w]++==0)
+      m_weights.insert(lower_bound(m_weights.begin(),m_weights.end(),w),w);
+  }
+}
+
+//library-wide bounds used by pruneTarget and the window components
+void FPMLibrary::updateBounds()
+{
+  m_minNodes=INT_MAX;
+  m_minDegree=INT_MAX;
+  m_needWholeGraph=false;
+  for(int j=0;j<m_blocks.size();j++)
+  {
+    FPMBlock &block=m_blocks[j];
+    if(block.retired)
+      continue;
+    if(block.sig.node_num<m_minNodes)
+      m_minNodes=block.sig.node_num;
+    if(!block.sig.connected)
+      m_needWholeGraph=true;
+    for(int i=0;i<block.graph->NodeCount();i++)
+    {
+      int degree=block.graph->InEdgeCount(i)+block.graph->OutEdgeCount(i);
+      if(degree<m_minDegree)
+        m_minDegree=degree;
+    }
+  }
+}
+
+void FPMLibrary::compile(FPMLayout &layout, vector<FPMPattern> &record_patterns)
+{
+  clear();
+  appendPatterns(layout,record_patterns);
+}
+
+//cut every new pattern into small blocks around each of its polygons and link
+//the blocks into the clusters, the subset lattice and the symmetry data
+int FPMLibrary::appendPatterns(FPMLayout &layout, vector<FPMPattern> &record_patterns)
+{
+  FPMMemScope mem(FPM_MEM_LIBRARY);
+  int first_block=m_blocks.size();
+  int first_pattern=m_patternNum;
+  FPMTempEdgeVector blockEdge;
+  FPMEdgeVector medge_vector;
+  int add_count=0;
+  FPMTempEdgeVector patternEdge,patternRing,patternEdge_vertical,patternEdge_horizontal;
+  for(int j=0;j<record_patterns.size();j++)
+  {
+    //cout<<"pattern num "<<j<<endl;
+    if(patternEdge.size()!=0)patternEdge.clear();
+    //cout<<"aaaa "<<endl;
+    if(patternRing.size()!=0)patternRing.clear();
+    //cout<<"bbbb "<<endl;
+    if(patternEdge_horizontal.size()!=0)patternEdge_horizontal.clear();
+    //cout<<"cccc "<<endl;
+    if(patternEdge_vertical.size()!=0)patternEdge_vertical.clear();
+    //cout<<"dddd "<<endl;
+    layout.generateEdge(record_patterns[j]);
+    //cout<<"generate edge finished"<<endl;
+    patternRing=layout.generateRing(record_patterns[j]);
+    //cout<<"generate ring finished"<<endl;
+    SweepEdgeHorizontal(record_patterns[j], patternEdge_horizontal);
+    //cout<<"construct horizontal finished"<<endl;
+    SweepEdgeVertical(record_patterns[j], patternEdge_vertical);
+    //cout<<"construct vertical finished"<<endl;
+    //get all the edge together
+    patternEdge.insert(patternEdge.begin(),patternRing.begin(),patternRing.end());
+    patternEdge.insert(patternEdge.begin(),patternEdge_horizontal.begin(),patternEdge_horizontal.end());
+    patternEdge.insert(patternEdge.begin(),patternEdge_vertical.begin(),patternEdge_vertical.end());             
+    //cout<<"construct patternEdge finished"<<endl;           
+    layout.deleteBound(patternEdge, record_patterns[j]);
+          
+          /*****************construct small block******************/
+          int min_x,min_y,max_x,max_y,amin_x,amin_y,amax_x,amax_y;
+          for(int m=0;m<record_patterns[j].m_poly_fulls.size();m++)
+          {
+              //cout<<"come in block"<<endl;
+              //get bounding box of poly then decide the near area
+              add_count=0;
+              min_x=record_patterns[j].m_poly_fulls[m].p.ptlist[0].x;
+              min_y=record_patterns[j].m_poly_fulls[m].p.ptlist[0].y;
+              max_x=record_patterns[j].m_poly_fulls[m].p.ptlist[0].x;
+              max_y=record_patterns[j].m_poly_fulls[m].p.ptlist[0].y;
+              for(int p=0;p<record_patterns[j].m_poly_fulls[m].p.ptlist.size();p++)
+              {
+                  if(min_x>record_patterns[j].m_poly_fulls[m].p.ptlist[p].x)
+                    min_x=record_patterns[j].m_poly_fulls[m].p.ptlist[p].x;
+                  if(min_y>record_patterns[j].m_poly_fulls[m].p.ptlist[p].y)
+                    min_y=record_patterns[j].m_poly_fulls[m].p.ptlist[p].y;
+                  if(max_x<record_patterns[j].m_poly_fulls[m].p.ptlist[p].x)
+                    max_x=record_patterns[j].m_poly_fulls[m].p.ptlist[p].x;
+                  if(max_y<record_patterns[j].m_poly_fulls[m].p.ptlist[p].y)
+                    max_y=record_patterns[j].m_poly_fulls[m].p.ptlist[p].y;
+              }
+              //near area of poly m
+              amin_x=min_x-S1_DISTANCE;
+              amax_x=max_x+S1_DISTANCE;
+              amin_y=min_y-S1_DISTANCE;
+              amax_y=max_y+S1_DISTANCE;
+              //layout.drawArea(record_patterns[j],amin_x,amin_y,amax_x,amax_y);
+              blockEdge.clear();
+              medge_vector.clear();
+              
+              //cout<<"after clear vector"<<endl;
+              for(int q=0;q<patternEdge.size();q++)
+              {
+                 //cout<<"come in patternEdge "<<q<<endl;
+                 if(record_patterns[j].m_edge[patternEdge[q].tempNode.first].belong_id==m)
+                 {
+                     
+                     //vertical edge
+                     if(record_patterns[j].m_edge[patternEdge[q].tempNode.second].type==0)
+                     {
+                         //vertical edge judge
+                         if((record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y<amax_y)||(record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y+record_patterns[j].m_edge[patternEdge[q].tempNode.second].length>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y+record_patterns[j].m_edge[patternEdge[q].tempNode.second].length<amax_y))
+                          {
+                             //in the naer area
+                             blockEdge.push_back(patternEdge[q]);
+                             if(record_patterns[j].m_edge[patternEdge[q].tempNode.second].belong_id!=m)add_count++;
+                          }
+                     }
+                     //horizontal edge
+                     else
+                     {
+                          //horizontal edge judge
+                          if((record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y<amax_y)||(record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x+record_patterns[j].m_edge[patternEdge[q].tempNode.second].length>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.x+record_patterns[j].m_edge[patternEdge[q].tempNode.second].length<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.second].point.y<amax_y))
+                          {
+                             //in the naer area
+                             blockEdge.push_back(patternEdge[q]);
+                             if(record_patterns[j].m_edge[patternEdge[q].tempNode.second].belong_id!=m)add_count++;
+
+                          }
+
+                     }
+                 }
+                 else if(record_patterns[j].m_edge[patternEdge[q].tempNode.second].belong_id==m)
+                 {
+                    //vertical
+                    if(record_patterns[j].m_edge[patternEdge[q].tempNode.first].type==0)
+                    {
+                         if((record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y<amax_y)||(record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y+record_patterns[j].m_edge[patternEdge[q].tempNode.first].length>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y+record_patterns[j].m_edge[patternEdge[q].tempNode.first].length<amax_y))
+                         {
+                           //in the naer area
+                           blockEdge.push_back(patternEdge[q]);
+                           if(record_patterns[j].m_edge[patternEdge[q].tempNode.first].belong_id!=m)add_count++;
+
+                         }
+                    }
+                    //horizontal
+                    else
+                    {
+                         if((record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y<amax_y)||(record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x+record_patterns[j].m_edge[patternEdge[q].tempNode.first].length>amin_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.x+record_patterns[j].m_edge[patternEdge[q].tempNode.first].length<amax_x&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y>amin_y&&record_patterns[j].m_edge[patternEdge[q].tempNode.first].point.y<amax_y))
+                         {
+                           //in the naer area
+                           blockEdge.push_back(patternEdge[q]);
+                           if(record_patterns[j].m_edge[patternEdge[q].tempNode.first].belong_id!=m)add_count++;
+                         }
+                    }
+                 }
+              }
+              //cout<<"come in construct sub graph "<<blockEdge.size()<<endl;
+              
+              if(blockEdge.size()!=0&&add_count>=ADD_COUNT)
+              {
+                 //cout<<blockEdge<<endl;
+                 medge_vector=layout.GetNodeSize(blockEdge,record_patterns[j]);
+                
+                 if(medge_vector.size()>=MEDGE_SIZE)
+                 {
+                    FPMBlock block;
+                    block.pattern_id=first_pattern+j;
+                    block.bbox=record_patterns[j].bbox;
+                    block.edges=blockEdge;
+                    block.nodes=medge_vector;
+                    block.F=layout.calcF(medge_vector);
+                    block.weight=new int[blockEdge.size()];
+                    block.graph=toGetSubG(medge_vector.size(),blockEdge,block.F,block.weight);
+                    toGetSig(block.graph,block.sig);
+                    block.cluster_id=-1;
+                    block.exact=NULL;
+                    block.exact_weight=NULL;
+                    block.retired=false;
+                    block.anchored=record_patterns[j].m_poly_fulls[m].full;
+                    if(block.anchored)
+                      toGetShapeKey(record_patterns[j].m_poly_fulls[m].p,block.anchor_key);
+                    addBlock(block);
+                 }
+              }
+          }
+   }
+
+  for(int j=first_block;j<m_blocks.size();j++)
+  {
+    if(CLUSTER_DIFF>=0)
+      assignCluster(j);
+    //block graph comparing edge weights exactly
+    FPMBlock &block=m_blocks[j];
+    block.exact_weight=new int[block.edges.size()];
+    block.exact=toGetSubG(block.nodes.size(),block.edges,block.F,block.exact_weight);
+    block.exact->SetEdgeComparator(new EdgeComparator(0));
+    linkLattice(j);
+    //only automorphisms keeping every edge weight map a window match onto another
+    //valid match, so they are searched on the exact graph
+    toGetSymBreak(block.exact,FPM_AUT_MAX,block.sym);
+  }
+  m_patternNum+=record_patterns.size();
+  updateBounds();
+  if(m_plugin.isLoaded())
+  {
+    cout<<"Library changed, matcher plugin not used any more"<<endl;
+    m_plugin.close();
+  }
+  printSummary();
+  return first_pattern;
+}
+
+//retire all blocks of a pattern, the clusters and the lattice are patched around them
+int FPMLibrary::retirePattern(int pattern_id)
+{
+  int num=0;
+  for(int j=0;j<m_blocks.size();j++)
+  {
+    if(!m_blocks[j].retired&&m_blocks[j].pattern_id==pattern_id)
+    {
+      retireBlock(j);
+      num++;
+    }
+  }
+  if(num>0)
+  {
+    updateBounds();
+    if(m_plugin.isLoaded())
+    {
+      cout<<"Library changed, matcher plugin not used any more"<<endl;
+      m_plugin.close();
+    }
+  }
+  cout<<"Library: retired "<<num<<" blocks of pattern "<<pattern_id<<endl;
+  return num;
+}
+
+void FPMLibrary::retireBlock(int j)
+{
+  FPMBlock &block=m_blocks[j];
+  block.retired=true;
+  for(int i=0;i<block.edges.size();i++)
+  {
+    int w=block.edges[i].weight;
+    if(--m_weightCount[w]==0)
+    {
+      m_weightCount.erase(w);
+      m_weights.erase(lower_bound(m_weights.begin(),m_weights.end(),w));
+    }
+  }
+
+  for(int k=0;k<block.subsets.size();k++)
+  {
+    vector<int> &supersets=m_blocks[block.subsets[k]].supersets;
+    supersets.erase(find(supersets.begin(),supersets.end(),j));
+  }
+  for(int k=0;k<block.supersets.size();k++)
+  {
+    vector<int> &subsets=m_blocks[block.supersets[k]].subsets;
+    subsets.erase(find(subsets.begin(),subsets.end(),j));
+  }
+  block.subsets.clear();
+  block.supersets.clear();
+
+  if(block.cluster_id<0)
+    return;
+  FPMCluster &cluster=m_clusters[block.cluster_id];
+  cluster.members.erase(find(cluster.members.begin(),cluster.members.end(),j));
+  block.cluster_id=-1;
+  if(cluster.rep!=j)
+    return;
+  if(cluster.members.empty())
+  {
+    delete cluster.graph;
+    delete [] cluster.weight;
+    cluster.graph=NULL;
+    cluster.weight=NULL;
+    cluster.rep=-1;
+    return;
+  }
+  //the next member represents the cluster, members too far from it are clustered again
+  vector<int> members;
+  members.swap(cluster.members);
+  setClusterRep(cluster,members[0]);
+  cluster.members.push_back(members[0]);
+  vector<int> moved;
+  for(int k=1;k<members.size();k++)
+  {
+    if(isSameCluster(cluster,m_blocks[members[k]]))
+      cluster.members.push_back(members[k]);
+    else
+      moved.push_back(members[k]);
+  }
+  for(int k=0;k<moved.size();k++)
+    assignCluster(moved[k]);
+}
+
+void FPMLibrary::printSummary()
+{
+  int block_num=0,clustered=0,cluster_num=0,relation_num=0,sym_num=0;
+  for(int j=0;j<m_blocks.size();j++)
+  {
+    if(m_blocks[j].retired)
+      continue;
+    block_num++;
+    relation_num+=m_blocks[j].subsets.size();
+    if(m_blocks[j].sym.aut_num>1)
+      sym_num++;
+  }
+  for(int c=0;c<m_clusters.size();c++)
+  {
+    if(m_clusters[c].members.size()<2)
+      continue;
+    cluster_num++;
+    clustered+=m_clusters[c].members.size();
+  }
+  cout<<"Library: "<<block_num<<" blocks, "<<m_weights.size()<<" distinct edge weights"<<endl;
+  if(CLUSTER_DIFF>=0)
+    cout<<"Library: "<<clustered<<" blocks in "<<cluster_num<<" clusters"<<endl;
+  cout<<"Library: "<<relation_num<<" subset relations between blocks"<<endl;
+  cout<<"Library: "<<sym_num<<" symmetric blocks"<<endl;
+}
+
+//a block joins a cluster if it is isomorphic to the representative with every
+//edge weight within CLUSTER_DIFF, so a block match within GRAPH_EDGE_DIFF implies
+//a representative match within GRAPH_EDGE_DIFF+CLUSTER_DIFF
+bool FPMLibrary::isSameCluster(FPMCluster &cluster, FPMBlock &block)
+{
+  FPMGraphSig &rep_sig=m_blocks[cluster.rep].sig;
+  if(rep_sig.node_num!=block.sig.node_num||rep_sig.edge_num!=block.sig.edge_num||
+     rep_sig.max_degree!=block.sig.max_degree||rep_sig.connected!=block.sig.connected)
+    return false;
+  cluster.graph->SetEdgeComparator(new EdgeComparator(CLUSTER_DIFF));
+  VF2State s0(cluster.graph,block.graph);
+  int n;
+  node_id *c1=new node_id[block.sig.node_num];
+  node_id *c2=new node_id[block.sig.node_num];
+  bool found=match(&s0,&n,c1,c2);
+  delete [] c1;
+  delete [] c2;
+  cluster.graph->SetEdgeComparator(new EdgeComparator(GRAPH_EDGE_DIFF+CLUSTER_DIFF));
+  return found;
+}
+
+void FPMLibrary::setClusterRep(FPMCluster &cluster, int j)
+{
+  delete cluster.graph;
+  delete [] cluster.weight;
+  cluster.rep=j;
+  cluster.weight=new int[m_blocks[j].edges.size()];
+  cluster.graph=toGetSubG(m_blocks[j].nodes.size(),m_blocks[j].edges,m_blocks[j].F,cluster.weight);
+  cluster.graph->SetEdgeComparator(new EdgeComparator(GRAPH_EDGE_DIFF+CLUSTER_DIFF));
+}
+
+//greedy clustering in block order, the first block of a cluster is its representative;
+//single block clusters are kept for later blocks but guard nothing
+void FPMLibrary::assignCluster(int j)
+{
+  int c=0;
+  for(;c<m_clusters.size();c++)
+  {
+    if(m_clusters[c].rep>=0&&isSameCluster(m_clusters[c],m_blocks[j]))
+      break;
+  }
+  if(c==m_clusters.size())
+  {
+    FPMCluster cluster;
+    cluster.graph=NULL;
+    cluster.weight=NULL;
+    m_clusters.push_back(cluster);
+    setClusterRep(m_clusters[c],j);
+  }
+  m_clusters[c].members.push_back(j);
+  m_blocks[j].cluster_id=c;
+}
+
+bool FPMLibrary::isGuarded(FPMBlock &block)
+{
+  return block.cluster_id>=0&&m_clusters[block.cluster_id].members.size()>=2;
+}
+
+static bool isSubBlock(FPMBlock &a, FPMBlock &b)
+{
+  VF2SubState s0(a.exact,b.exact);
+  int n;
+  node_id *c1=new node_id[a.sig.node_num];
+  node_id *c2=new node_id[a.sig.node_num];
+  bool found=match(&s0,&n,c1,c2);
+  delete [] c1;
+  delete [] c2;
+  return found;
+}
+
+//block A is kept as a subset of block B if A is an induced subgraph of B with
+//equal edge weights, then every window match of B contains a match of A and a
+//miss of A proves a miss of B. Block j is compared with all earlier blocks.
+void FPMLibrary::linkLattice(int j)
+{
+  FPMBlock &block=m_blocks[j];
+  for(int a=0;a<j;a++)
+  {
+    FPMBlock &other=m_blocks[a];
+    if(other.retired)
+      continue;
+    if(isSigCompatible(other.sig,block.sig)&&isSubBlock(other,block))
+    {
+      block.subsets.push_back(a);
+      other.supersets.push_back(j);
+    }
+    //of two equal blocks only the earlier one is a subset of the later one
+    if(other.sig.node_num==block.sig.node_num&&other.sig.edge_num==block.sig.edge_num)
+      continue;
+    if(isSigCompatible(block.sig,other.sig)&&isSubBlock(block,other))
+    {
+      //smallest subsets first, they are the cheapest to reject
+      vector<int>::iterator it=other.subsets.begin();
+      while(it!=other.subsets.end()&&m_blocks[*it].sig.node_num<=block.sig.node_num)
+        ++it;
+      other.subsets.insert(it,j);
+      block.supersets.push_back(a);
+    }
+  }
+  for(int x=1;x<block.subsets.size();x++)
+  {
+    int a=block.subsets[x];
+    int y=x;
+    for(;y>0&&m_blocks[block.subsets[y-1]].sig.node_num>m_blocks[a].sig.node_num;y--)
+      block.subsets[y]=block.subsets[y-1];
+    block.subsets[y]=a;
+  }
+}
+
+bool FPMLibrary::getAnchorKeys(set< vector<int> > &keys)
+{
+  keys.clear();
+  for(int j=0;j<m_blocks.size();j++)
+  {
+    if(m_blocks[j].retired)
+      continue;
+    if(!m_blocks[j].anchored)
+      return false;
+    keys.insert(m_blocks[j].anchor_key);
+  }
+  cout<<"Library: "<<keys.size()<<" distinct anchor shapes"<<endl;
+  return true;
+}
+
+void FPMLibrary::beginWindow(FPMWindowState &ws, FPMComponentVector &components, FPMComponentVector &whole)
+{
+  ws.components=&components;
+  ws.whole=&whole;
+  ws.clusterState.assign(m_clusters.size(),0);
+  ws.blockState.assign(m_blocks.size(),0);
+  ws.blockResult.resize(m_blocks.size());
+}
+
+//drop results of blocks tested ahead of the loop but never asked for
+void FPMLibrary::endWindow(FPMWindowState &ws)
+{
+  for(int j=0;j<ws.blockResult.size();j++)
+    freeResult(ws.blockResult[j]);
+  ws.components=NULL;
+  ws.whole=NULL;
+}
+
+void FPMLibrary::freeResult(vector<FPMResultPair> &result)
+{
+  for(int x=0;x<result.size();x++)
+  {
+    delete [] result[x].sub_result;
+    delete [] result[x].target_result;
+  }
+  result.clear();
+}
+
+//match block j in the current window unless its cluster representative or one
+//of its subset blocks already missed, the result is kept until matchBlock asks for it
+bool FPMLibrary::testBlock(FPMWindowState &ws, int j)
+{
+  if(ws.blockState[j]!=0)
+    return ws.blockState[j]==1;
+  FPMBlock &block=m_blocks[j];
+  FPMComponentVector &targets=block.sig.connected?*ws.components:*ws.whole;
+  ws.blockState[j]=2;
+  if(block.retired)
+    return false;
+  if(isGuarded(block))
+  {
+    FPMCluster &cluster=m_clusters[block.cluster_id];
+    if(ws.clusterState[block.cluster_id]==0)
+    {
+      FPMBlock &rep=m_blocks[cluster.rep];
+      vector<FPMResultPair> rep_result;
+      bool found;
+      if(m_plugin.getWidened(cluster.rep)!=NULL)
+        found=matchPlugin(m_plugin.getWidened(cluster.rep),rep,targets,rep_result);
+      else
+        found=toMatchComponents(cluster.graph,rep.sig,targets,rep.nodes.size(),rep.F,rep_result,&rep.sym);
+      freeResult(rep_result);
+      ws.clusterState[block.cluster_id]=found?1:2;
+    }
+    if(ws.clusterState[block.cluster_id]==2)
+    {
+      ws.skipNum++;
+      return false;
+    }
+  }
+  for(int k=0;k<block.subsets.size();k++)
+  {
+    if(!testBlock(ws,block.subsets[k]))
+    {
+      ws.subsetSkipNum++;
+      return false;
+    }
+  }
+  bool found;
+  if(m_plugin.getMatcher(j)!=NULL)
+    found=matchPlugin(m_plugin.getMatcher(j),block,targets,ws.blockResult[j]);
+  else
+    found=toMatchComponents(block.graph,block.sig,targets,block.nodes.size(),block.F,ws.blockResult[j],&block.sym);
+  if(found)
+    ws.blockState[j]=1;
+  return ws.blockState[j]==1;
+}
+
+bool FPMLibrary::matchBlock(FPMWindowState &ws, int j, vector<FPMResultPair> &result)
+{
+  if(!testBlock(ws,j))
+    return false;
+  result.swap(ws.blockResult[j]);
+  ws.blockResult[j].clear();
+  return true;
+}
+
+bool FPMLibrary::isWeightUsed(int weight)
+{
+  vector<int>::iterator it=lower_bound(m_weights.begin(),m_weights.end(),weight-GRAPH_EDGE_DIFF);
+  return it!=m_weights.end()&&*it<=weight+GRAPH_EDGE_DIFF;
+}
+
+//A window node can only be mapped by a block node if at least m_minDegree of its
+//edges have a weight within GRAPH_EDGE_DIFF of some block edge and lead to nodes
+//which can be mapped as well. Removed nodes are never part of a match, so the
+//induced subgraph test on the remaining nodes gives the same results.
+//Node lengths are not checked because blocks are matched without a node comparator.
+int FPMLibrary::pruneTarget(int target_num, const FPMTempEdgeVector &target_source, vector<bool> &keep)
+{
+  keep.assign(target_num,true);
+  vector<int> degree(target_num,0);
+  vector< vector<int> > adj(target_num);
+  for(int i=0;i<target_source.size();i++)
+  {
+    if(!isWeightUsed(target_source[i].weight))
+      continue;
+    int a=target_source[i].tempNode.first;
+    int b=target_source[i].tempNode.second;
+    degree[a]++;
+    degree[b]++;
+    adj[a].push_back(b);
+    adj[b].push_back(a);
+  }
+
+  vector<int> removed;
+  for(int i=0;i<target_num;i++)
+  {
+    if(degree[i]<m_minDegree)
+    {
+      keep[i]=false;
+      removed.push_back(i);
+    }
+  }
+  int prune_num=0;
+  while(!removed.empty())
+  {
+    int v=removed.back();
+    removed.pop_back();
+    prune_num++;
+    for(int k=0;k<adj[v].size();k++)
+    {
+      int u=adj[v][k];
+      if(keep[u]&&--degree[u]<m_minDegree)
+      {
+        keep[u]=false;
+        removed.push_back(u);
+      }
+    }
+  }
+  return prune_num;
+}
+
+}
@@ -0,0 +1,133 @@
+#ifndef __FPMLIBRARY_H__
+#define __FPMLIBRARY_H__
+#include <vector>
+#include <set>
+#include <map>
+#include <climits>
+#include "FPMPattern.h"
+#include "FPMTempEdge.h"
+#include "FPMMatch.h"
+
+namespace FPM {
+
+class FPMLayout;
+
+//one small block of a recorded pattern, matched as a subgraph of the window graphs
+struct FPMBlock
+{
+  int pattern_id;
+  FPMRect bbox;
+  FPMTempEdgeVector edges;//block edges, node ids are pattern edge ids
+  FPMEdgeVector nodes;//pattern edges used as graph nodes
+  int *F;//graph node -> pattern edge id
+  int *weight;
+  ARGraph<void,int> *graph;
+  FPMGraphSig sig;
+  int cluster_id;
+  std::vector<int> subsets;//blocks contained in this one, smallest first
+  std::vector<int> supersets;//blocks containing this one
+  ARGraph<void,int> *exact;//graph comparing edge weights exactly
+  int *exact_weight;
+  bool retired;//never matched again, kept so block ids stay valid
+  SymBreak sym;
+  bool anchored;//the polygon the block is built around lies wholly in the pattern
+  std::vector<int> anchor_key;//its normalized shape, see toGetShapeKey
+};
+typedef std::vector<FPMBlock> FPMBlockVector;
+
+//blocks isomorphic to the representative within CLUSTER_DIFF, the representative
+//is matched first with GRAPH_EDGE_DIFF+CLUSTER_DIFF and guards all members of
+//clusters with several members
+struct FPMCluster
+{
+  int rep;//block id of the representative, -1 once all members are retired
+  std::vector<int> members;
+  int *weight;
+  ARGraph<void,int> *graph;//representative graph with the widened tolerance
+};
+typedef std::vector<FPMCluster> FPMClusterVector;
+
+//matching state of one window, each matching thread has its own
+struct FPMWindowState
+{
+  FPMComponentVector *components;
+  FPMComponentVector *whole;
+  std::vector<char> clusterState;//0 untested, 1 matched, 2 missed
+  std::vector<char> blockState;//0 untested, 1 matched, 2 missed
+  std::vector< std::vector<FPMResultPair> > blockResult;
+  long skipNum;//blocks skipped because the cluster representative missed
+  long subsetSkipNum;//blocks skipped because a subset block missed
+  FPMWindowState() { components = NULL; whole = NULL; skipNum = 0; subsetSkipNum = 0; }
+};
+
+//the compiled pattern library: all blocks of the recorded patterns plus
+//library-wide data used to cut down window graphs before matching
+class FPMLibrary
+{
+public:
+  FPMLibrary() { m_minNodes = INT_MAX; m_minDegree = INT_MAX; m_needWholeGraph = false; m_patternNum = 0; }
+  ~FPMLibrary() { clear(); }
+  void compile(FPMLayout &layout, std::vector<FPMPattern> &record_patterns);
+  void clear();
+
+  //incremental maintenance, only the blocks of the added or retired patterns are
+  //compared with the rest of the library; appending gives the same library as
+  //compiling all patterns at once. Pattern ids are given in append order.
+  int appendPatterns(FPMLayout &layout, std::vector<FPMPattern> &patterns);
+  int retirePattern(int pattern_id);
+  int getPatternNum() { return m_patternNum; }
+
+  int getBlockNum() { return m_blocks.size(); }
+  FPMBlock &getBlock(int i) { return m_blocks[i]; }
+  int getMinNodes() { return m_minNodes; }
+  bool needWholeGraph() { return m_needWholeGraph; }
+  //anchor shapes of all blocks, false if some block has no whole anchor polygon
+  bool getAnchorKeys(std::set< std::vector<int> > &keys);
+
+  //mark window nodes which can not be mapped by any block of the library
+  int pruneTarget(int target_num, const FPMTempEdgeVector &target_source, std::vector<bool> &keep);
+
+  //per window matching, a block is skipped when the representative of its cluster
+  //or one of its subset blocks missed; the library itself is only read
+  void beginWindow(FPMWindowState &ws, FPMComponentVector &components, FPMComponentVector &whole);
+  bool matchBlock(FPMWindowState &ws, int j, std::vector<FPMResultPair> &result);
+  void endWindow(FPMWindowState &ws);
+
+  //specialized matchers: emit C++ source for all blocks, or load a plugin built from it
+  bool emitMatchers(const char *path);
+  bool loadPlugin(const char *path);
+  unsigned long getFingerprint();
+
+private:
+  void addBlock(FPMBlock &block);
+  void retireBlock(int j);
+  void updateBounds();
+  bool isWeightUsed(int weight);
+  bool isGuarded(FPMBlock &block);
+  void assignCluster(int j);
+  void setClusterRep(FPMCluster &cluster, int j);
+  bool isSameCluster(FPMCluster &cluster, FPMBlock &block);
+  void linkLattice(int j);
+  void printSummary();
+  bool testBlock(FPMWindowState &ws, int j);
+  void freeResult(std::vector<FPMResultPair> &result);
+  bool matchPlugin(FPMPluginMatcher matcher, FPMBlock &block, FPMComponentVector &components, std::vector<FPMResultPair> &result_pair);
+
+  FPMBlockVector m_blocks;
+  std::vector<int> m_weights;//sorted distinct edge weights of all blocks
+  std::map<int,int> m_weightCount;//number of block edges with each weight
+  int m_patternNum;
+  int m_minNodes;
+  int m_minDegree;//smallest node degree in any block
+  bool m_needWholeGraph;
+
+  FPMClusterVector m_clusters;
+  FPMPlugin m_plugin;
+
+  FPMLibrary(const FPMLibrary &);
+  FPMLibrary &operator = (const FPMLibrary &);
+};
+
+}
+
+#endif  //FPMLIBRARY_H
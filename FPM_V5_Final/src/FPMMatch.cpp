@@ -16,21 +16,26 @@
 #include "EdgeComparator.h"
 #include "EdgeDestroyer.h"
 #include "PiontComparator.h"
+#include "FPMMemory.h"
+#include "FPMReplay.h"
+#include <sys/time.h>
 
 
 extern int WIDTH_DIFF;
 extern int HEIGHT_DIFF;
 extern int GRAPH_EDGE_DIFF;
 extern int POLY_EDGE_DIFF;
+extern double CAPTURE_MS;
 namespace FPM{
 
 using namespace std;
 
-int FPM_thu_num;
 const int FPM_thu_num_MAX =30000;
 
+//the result vector is empty when matching starts, so its size counts the visits
+//and no shared counter is needed when windows are matched in parallel
 bool my_visitor(int n,node_id ni1[],node_id ni2[],void *user_data){
-  ++FPM_thu_num;
+  FPMMemScope mem(FPM_MEM_RESULT);
   vector<FPMResultPair> *result=(vector<FPMResultPair>*)user_data;
   FPMResultPair temp_result;
   temp_result.sub_result = new node_id[n];
@@ -43,7 +48,7 @@ bool my_visitor(int n,node_id ni1[],node_id ni2[],void *user_data){
   }
   
   result->push_back(temp_result);
-  if(FPM_thu_num==FPM_thu_num_MAX){
+  if(result->size()==FPM_thu_num_MAX){
      return true;
   }
   return false;
@@ -92,16 +97,35 @@ ARGraph<void,int> *toGetTargetG(int target_num,const FPMTempEdgeVector &target_s
 }
 
 void toMatchEdge(ARGraph<void,int> *sub_graph, ARGraph<void,int> *target_graph,
-                  int sub_num, int* F, vector<FPMResultPair>& result_pair)
+                  int sub_num, int* F, vector<FPMResultPair>& result_pair, const SymBreak *sym)
 {
   //cout<<"out the sub graph :"<<target_graph->NodeCount()<<endl;
   //for(int i=0;i<target_graph->NodeCount();i++)
   //{ cout<<i<<": "<<target_graph->InEdgeCount(i)<<" "<<target_graph->OutEdgeCount(i)<<endl;
   //}
-   VF2SubState s0(sub_graph, target_graph);
-   FPM_thu_num=0;
   // cout<<"in"<<sub_graph->NodeCount()<<" "<<target_graph->NodeCount()<<endl;
-   match(&s0,my_visitor,&result_pair);   
+   struct timeval start;
+   if(CAPTURE_MS>0)
+     gettimeofday(&start,NULL);
+   //symmetric blocks report one mapping per automorphism class
+   if(sym!=NULL&&sym->aut_num>1)
+   {
+     SymSubState s0(sub_graph, target_graph, sym);
+     match(&s0,my_visitor,&result_pair);
+   }
+   else
+   {
+     VF2SubState s0(sub_graph, target_graph);
+     match(&s0,my_visitor,&result_pair);
+   }
+   if(CAPTURE_MS>0)
+   {
+     struct timeval end;
+     gettimeofday(&end,NULL);
+     double ms=(end.tv_sec-start.tv_sec)*1e3+(end.tv_usec-start.tv_usec)*1e-3;
+     if(ms>CAPTURE_MS)
+       captureMatch(sub_graph,target_graph,sub_num,F,sym,ms,result_pair.size());
+   }
    for(int i=0;i<result_pair.size();i++)
    {
       for(int j=0;j<sub_num;j++)
@@ -111,6 +135,195 @@ void toMatchEdge(ARGraph<void,int> *sub_graph, ARGraph<void,int> *target_graph,
    }
 }
 
+static int findRoot(vector<int> &parent,int x)
+{
+  while(parent[x]!=x)
+  {
+    parent[x]=parent[parent[x]];
+    x=parent[x];
+  }
+  return x;
+}
+
+void toGetSig(ARGraph<void,int> *graph,FPMGraphSig &sig)
+{
+  int n=graph->NodeCount();
+  vector<int> parent(n);
+  for(int i=0;i<n;i++)
+    parent[i]=i;
+  sig.node_num=n;
+  sig.edge_num=0;
+  sig.max_degree=0;
+  for(int i=0;i<n;i++)
+  {
+    int degree=graph->InEdgeCount(i)+graph->OutEdgeCount(i);
+    if(degree>sig.max_degree)
+      sig.max_degree=degree;
+    sig.edge_num+=graph->OutEdgeCount(i);
+    for(int k=0;k<graph->OutEdgeCount(i);k++)
+    {
+      int *attr;
+      int a=findRoot(parent,i);
+      int b=findRoot(parent,graph->GetOutEdge(i,k,&attr));
+      if(a!=b)
+        parent[a]=b;
+    }
+  }
+  int roots=0;
+  for(int i=0;i<n;i++)
+  {
+    if(findRoot(parent,i)==i)
+      roots++;
+  }
+  sig.connected=(roots<=1);
+}
+
+bool isSigCompatible(const FPMGraphSig &sub_sig,const FPMGraphSig &target_sig)
+{
+  return sub_sig.node_num<=target_sig.node_num
+      && sub_sig.edge_num<=target_sig.edge_num
+      && sub_sig.max_degree<=target_sig.max_degree;
+}
+
+//split the window graph into connected components, components smaller than min_nodes are dropped.
+//nodes with keep[i]==false are removed together with their edges.
+//if split is false all kept nodes go into one component.
+void toGetComponents(int target_num,const FPMTempEdgeVector &target_source,const vector<bool> &keep,
+                     int min_nodes,bool split,FPMComponentVector &components)
+{
+  components.clear();
+  vector<int> parent(target_num);
+  for(int i=0;i<target_num;i++)
+    parent[i]=i;
+  for(int i=0;i<target_source.size();i++)
+  {
+    if(!keep[target_source[i].tempNode.first]||!keep[target_source[i].tempNode.second])
+      continue;
+    int a=findRoot(parent,target_source[i].tempNode.first);
+    int b=findRoot(parent,target_source[i].tempNode.second);
+    if(a!=b)
+      parent[a]=b;
+  }
+  if(!split)
+  {
+    for(int i=0;i<target_num;i++)
+      parent[i]=0;
+  }
+
+  vector<int> size(target_num,0);
+  for(int i=0;i<target_num;i++)
+  {
+    if(keep[i])
+      size[findRoot(parent,i)]++;
+  }
+
+  //component index of each root, and local id of each node
+  vector<int> comp_id(target_num,-1);
+  vector<int> local(target_num,-1);
+  for(int i=0;i<target_num;i++)
+  {
+    int r=findRoot(parent,i);
+    if(!keep[i]||size[r]<min_nodes)
+      continue;
+    if(comp_id[r]<0)
+    {
+      comp_id[r]=components.size();
+      FPMComponent comp;
+      comp.graph=NULL;
+      comp.weight=NULL;
+      comp.csr=NULL;
+      components.push_back(comp);
+    }
+    local[i]=components[comp_id[r]].nodes.size();
+    components[comp_id[r]].nodes.push_back(i);
+  }
+
+  vector<FPMTempEdgeVector> comp_edges(components.size());
+  for(int i=0;i<target_source.size();i++)
+  {
+    if(!keep[target_source[i].tempNode.first]||!keep[target_source[i].tempNode.second])
+      continue;
+    int c=comp_id[findRoot(parent,target_source[i].tempNode.first)];
+    if(c<0)
+      continue;
+    FPMTempEdge e=target_source[i];
+    e.tempNode.first=local[e.tempNode.first];
+    e.tempNode.second=local[e.tempNode.second];
+    comp_edges[c].push_back(e);
+  }
+
+  for(int c=0;c<components.size();c++)
+  {
+    components[c].weight=new int[comp_edges[c].size()];
+    components[c].graph=toGetTargetG(components[c].nodes.size(),comp_edges[c],components[c].weight);
+    toGetSig(components[c].graph,components[c].sig);
+  }
+}
+
+void clearComponents(FPMComponentVector &components)
+{
+  for(int c=0;c<components.size();c++)
+  {
+    delete components[c].graph;
+    delete [] components[c].weight;
+    delete components[c].csr;
+  }
+  components.clear();
+}
+
+static void freeResultPairs(vector<FPMResultPair> &result_pair)
+{
+  for(int i=0;i<result_pair.size();i++)
+  {
+    delete [] result_pair[i].sub_result;
+    delete [] result_pair[i].target_result;
+  }
+  result_pair.clear();
+}
+
+//true if mapping a comes before mapping b, comparing their window node ids in block node order
+bool isMappingBefore(const FPMResultPair &a,const FPMResultPair &b,int sub_num)
+{
+  for(int j=0;j<sub_num;j++)
+  {
+    if(a.target_result[j]!=b.target_result[j])
+      return a.target_result[j]<b.target_result[j];
+  }
+  return false;
+}
+
+//match a connected block against every component large enough to hold it and keep the
+//results of the component whose first mapping is lexicographically smallest in window node ids.
+//that is the mapping VF2 finds first on the whole window graph, since it tries targets by
+//increasing id. components are in min-node-id order, so once a component starts after the
+//first target of the best mapping no later one can beat it
+bool toMatchComponents(ARGraph<void,int> *sub_graph,const FPMGraphSig &sub_sig,FPMComponentVector &components,
+                        int sub_num,int* F,vector<FPMResultPair> &result_pair,const SymBreak *sym)
+{
+  vector<FPMResultPair> comp_result;
+  for(int c=0;c<components.size();c++)
+  {
+    if(!result_pair.empty()&&components[c].nodes[0]>result_pair[0].target_result[0])
+      break;
+    if(!isSigCompatible(sub_sig,components[c].sig))
+      continue;
+    toMatchEdge(sub_graph,components[c].graph,sub_num,F,comp_result,sym);
+    if(comp_result.size()==0)
+      continue;
+    for(int i=0;i<comp_result.size();i++)
+    {
+      for(int j=0;j<sub_num;j++)
+      {
+        comp_result[i].target_result[j]=components[c].nodes[comp_result[i].target_result[j]];
+      }
+    }
+    if(result_pair.empty()||isMappingBefore(comp_result[0],result_pair[0],sub_num))
+      result_pair.swap(comp_result);
+    freeResultPairs(comp_result);
+  }
+  return result_pair.size()!=0;
+}
+
 /*
 void reOutput(const FPMPattern &pattern, const FPMPattern &sublayout, FPMResultPair &result, const FPMTempEdgeVector &source, ofstream &fout)
 { // cout<<"come intytrytrytr"<<endl;
@@ -4,6 +4,8 @@
 #include <fstream>
 #include "FPMArGraph.h"
 #include "FPMTempEdge.h"
+#include "SymSubState.h"
+#include "FPMPlugin.h"
 namespace FPM{
 using namespace std;
   struct FPMPoint;
@@ -11,7 +13,34 @@ using namespace std;
 bool my_visitor(int n,node_id ni1[],node_id ni2[],void *user_data);
 ARGraph<void,int> *toGetSubG(int sub_num,const FPMTempEdgeVector &sub_source,int *F,int* tempWeghht2);
 ARGraph<void,int> *toGetTargetG(int target_num,const FPMTempEdgeVector &target_source,int* tempWeight);
-void toMatchEdge(ARGraph<void,int> *sub_graph,ARGraph<void,int> *target_graph,int sub_num,int* F,   vector<FPMResultPair> &result_pair);
+void toMatchEdge(ARGraph<void,int> *sub_graph,ARGraph<void,int> *target_graph,int sub_num,int* F,   vector<FPMResultPair> &result_pair,const SymBreak *sym=NULL);
+
+//size signature of a graph, a block can only be found in a graph with at least its signature
+struct FPMGraphSig
+{
+  int node_num;
+  int edge_num;
+  int max_degree;
+  bool connected;
+};
+
+//connected component of a window graph, nodes are renumbered from 0
+struct FPMComponent
+{
+  vector<int> nodes;//local node id -> window node id
+  FPMGraphSig sig;
+  ARGraph<void,int> *graph;
+  int *weight;
+  FPMCsrGraph *csr;//built on first use by a matcher plugin
+};
+typedef vector<FPMComponent> FPMComponentVector;
+
+void toGetSig(ARGraph<void,int> *graph,FPMGraphSig &sig);
+bool isSigCompatible(const FPMGraphSig &sub_sig,const FPMGraphSig &target_sig);
+void toGetComponents(int target_num,const FPMTempEdgeVector &target_source,const vector<bool> &keep,int min_nodes,bool split,FPMComponentVector &components);
+void clearComponents(FPMComponentVector &components);
+bool isMappingBefore(const FPMResultPair &a,const FPMResultPair &b,int sub_num);
+bool toMatchComponents(ARGraph<void,int> *sub_graph,const FPMGraphSig &sub_sig,FPMComponentVector &components,int sub_num,int* F,vector<FPMResultPair> &result_pair,const SymBreak *sym=NULL);
 
 void reOutput(const FPMPattern& sublayout,FPMResultPair &result,vector<FPMPoint>& mset,int num);
 
@@ -0,0 +1,145 @@
+#ifdef FPM_MEMSTAT
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "FPMMemory.h"
+
+namespace FPM {
+
+struct FPMMemCounter
+{
+  volatile long allocated;
+  volatile long allocs;
+  volatile long frees;
+  volatile long live;
+  volatile long peak;
+};
+
+//zero initialized before any constructor allocates
+static FPMMemCounter counters[FPM_MEM_TAG_NUM];
+static volatile long total_live, total_peak;
+static __thread int current_tag;
+
+static const char *tag_names[FPM_MEM_TAG_NUM] =
+{
+  "other", "read", "pattern", "library", "clip", "kbool", "graph", "match", "result", "collect"
+};
+
+//kept in front of every block, 16 bytes so the block stays aligned as malloc's
+struct FPMMemHeader
+{
+  size_t size;
+  long tag;
+};
+
+static void raisePeak(volatile long &peak, long live)
+{
+  long old = peak;
+  while (live > old && !__sync_bool_compare_and_swap(&peak, old, live))
+    old = peak;
+}
+
+static void *allocate(size_t size)
+{
+  FPMMemHeader *h = (FPMMemHeader *)malloc(sizeof(FPMMemHeader) + size);
+  if (h == NULL)
+    return NULL;
+  h->size = size;
+  h->tag = current_tag;
+  FPMMemCounter &c = counters[h->tag];
+  __sync_fetch_and_add(&c.allocated, size);
+  __sync_fetch_and_add(&c.allocs, 1);
+  raisePeak(c.peak, __sync_add_and_fetch(&c.live, size));
+  raisePeak(total_peak, __sync_add_and_fetch(&total_live, size));
+  return h + 1;
+}
+
+static void release(void *p)
+{
+  if (p == NULL)
+    return;
+  FPMMemHeader *h = (FPMMemHeader *)p - 1;
+  FPMMemCounter &c = counters[h->tag];
+  __sync_fetch_and_add(&c.frees, 1);
+  __sync_fetch_and_sub(&c.live, h->size);
+  __sync_fetch_and_sub(&total_live, h->size);
+  free(h);
+}
+
+FPMMemScope::FPMMemScope(int tag)
+{
+  m_prev = current_tag;
+  current_tag = tag;
+}
+
+FPMMemScope::~FPMMemScope()
+{
+  current_tag = m_prev;
+}
+
+int getMemTag()
+{
+  return current_tag;
+}
+
+void printMemStat(const char *when)
+{
+  const double mb = 1024.0 * 1024.0;
+  printf("Memory %s: live %.1f MB, peak %.1f MB\n", when, total_live / mb, total_peak / mb);
+  printf("  %-8s %12s %10s %10s %10s %10s\n", "tag", "allocated MB", "allocs", "frees", "live MB", "peak MB");
+  for (int i = 0; i < FPM_MEM_TAG_NUM; ++ i)
+  {
+    FPMMemCounter &c = counters[i];
+    if (c.allocs == 0)
+      continue;
+    printf("  %-8s %12.1f %10ld %10ld %10.2f %10.2f\n", tag_names[i], c.allocated / mb, c.allocs, c.frees,
+           c.live / mb, c.peak / mb);
+  }
+}
+
+}
+
+void *operator new(size_t size)
+{
+  void *p = FPM::allocate(size);
+  if (p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) throw()
+{
+  return FPM::allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) throw()
+{
+  return FPM::allocate(size);
+}
+
+void operator delete(void *p) throw()
+{
+  FPM::release(p);
+}
+
+void operator delete[](void *p) throw()
+{
+  FPM::release(p);
+}
+
+void operator delete(void *p, size_t) throw()
+{
+  FPM::release(p);
+}
+
+void operator delete[](void *p, size_t) throw()
+{
+  FPM::release(p);
+}
+
+#endif
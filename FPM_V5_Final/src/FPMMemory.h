@@ -0,0 +1,56 @@
+#ifndef __FPMMEMORY_H__
+#define __FPMMEMORY_H__
+
+//Allocation accounting, built with -DFPM_MEMSTAT (make memstat). The global
+//operator new/delete are replaced and every allocation is charged to the tag of
+//the innermost FPMMemScope of its thread, which marks a stage or a data
+//structure. A free is charged back to the tag of its allocation, so the live
+//bytes left on a tag are what that stage still holds. Without FPM_MEMSTAT the
+//scopes and the report compile to nothing.
+
+namespace FPM {
+
+enum FPMMemTag
+{
+  FPM_MEM_OTHER,
+  FPM_MEM_READ,//m_rects and m_polys of the layouts
+  FPM_MEM_PATTERN,//training patterns
+  FPM_MEM_LIBRARY,//compiled blocks, clusters, lattice
+  FPM_MEM_CLIP,//windows and sub layouts
+  FPM_MEM_KBOOL,//boolean engine cutting polygons
+  FPM_MEM_GRAPH,//window edges, ARGraph components
+  FPM_MEM_MATCH,//VF2 states
+  FPM_MEM_RESULT,//FPMResultPair arrays
+  FPM_MEM_COLLECT,//matched points
+  FPM_MEM_TAG_NUM
+};
+
+#ifdef FPM_MEMSTAT
+class FPMMemScope
+{
+public:
+  FPMMemScope(int tag);
+  ~FPMMemScope();
+
+private:
+  int m_prev;
+};
+
+//tag allocations of this thread are charged to now
+int getMemTag();
+//bytes allocated, live and peak live bytes and allocation counts per tag
+void printMemStat(const char *when);
+#else
+class FPMMemScope
+{
+public:
+  FPMMemScope(int tag) {}
+};
+
+static inline int getMemTag() { return FPM_MEM_OTHER; }
+static inline void printMemStat(const char *when) {}
+#endif
+
+}
+
+#endif  //FPMMEMORY_H
@@ -106,6 +106,32 @@ static void compactPolygon(FPMPoly  &p)
     // assert(p.ptlist.size() > 3);
 }
 
+//normalized shape of a polygon: edge vectors of the compacted counter-clockwise
+//outline, starting from the lowest, leftmost vertex
+void toGetShapeKey(const FPMPoly &poly, std::vector<int> &key)
+{
+    FPMPoly p = poly;
+    if (p.ptlist.size() > 4)
+        compactPolygon(p);
+    p.makeCounterClockwise();
+    int n = p.ptlist.size();
+    int start = 0;
+    for (int i = 1; i < n; ++ i)
+    {
+        if (p.ptlist[i].y < p.ptlist[start].y ||
+            (p.ptlist[i].y == p.ptlist[start].y && p.ptlist[i].x < p.ptlist[start].x))
+            start = i;
+    }
+    key.clear();
+    for (int i = 0; i < n; ++ i)
+    {
+        FPMPoint &a = p.ptlist[(start+i)%n];
+        FPMPoint &b = p.ptlist[(start+i+1)%n];
+        key.push_back(b.x - a.x);
+        key.push_back(b.y - a.y);
+    }
+}
+
 #define BITARR
 
 bool PTR(FPMPattern &pt,bool save)
@@ -8,6 +8,9 @@
 
 namespace FPM {
 
+//layer the patterns are cut from unless other target layers are given
+const int FPM_DEFAULT_LAYER = 10;
+
 struct FPMPoly_full
 {
 	bool full;
@@ -25,6 +28,8 @@ struct FPMPattern
   std::vector<FPMEdge> horizontal_edge;
         
 	std::vector<FPMPoly_full> m_poly_fulls;
+  int layer;//target layer of a recorded pattern, it is matched by that layer's library
+  FPMPattern() { layer = FPM_DEFAULT_LAYER; }
   void clearPolyMem();
   void clearRectMem();
   void clearMem();
@@ -39,6 +44,7 @@ std:: ostream & operator << (std::ostream &out, FPMPattern &pt);
 //wangqin changed
 bool PTR(FPMPattern &pt,bool save);
 static void compactPolygon(FPMPoly &p);
+void toGetShapeKey(const FPMPoly &poly, std::vector<int> &key);
 //void duplicate(vector<FPMPattern>& patterns,bool** f);
 
 }
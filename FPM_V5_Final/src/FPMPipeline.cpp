@@ -0,0 +1,277 @@
+#include <iostream>
+#include <cstdio>
+#include <map>
+#include <pthread.h>
+#include <sys/time.h>
+#include "FPMLayout.h"
+#include "FPMLibrary.h"
+#include "FPMPipeline.h"
+#include "FPMQueue.h"
+#include "FPMCheckpoint.h"
+#include "FPMMemory.h"
+
+extern int GRAPH_THREADS;
+extern int MATCH_THREADS;
+extern int QUEUE_SIZE;
+
+namespace FPM {
+using namespace std;
+
+typedef FPMQueue<FPMWindowJob> FPMJobQueue;
+
+static double wallTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+struct FPMPipelineContext
+{
+  FPMLayout *layout;
+  vector<FPMLibrary*> libraries;//one per target layer
+  FPMCheckpoint *checkpoint;//windows done by an earlier run, NULL without checkpoints
+  vector<FPMRect> windows;//windows still to clip, empty if the sub layouts exist
+  int min_shapes;
+  FPMJobQueue *clipped;//clip -> graph
+  FPMJobQueue *built;//graph -> match
+  FPMJobQueue *matched;//match -> collect
+  int graph_threads;
+  int match_threads;
+  volatile int graph_left;//stage threads still running
+  volatile int match_left;
+  vector<FPMWindowState> states;//one per match thread
+  double clip_busy;
+  vector<double> graph_busy;
+  vector<double> match_busy;
+};
+
+struct FPMStageArg
+{
+  FPMPipelineContext *ctx;
+  int id;
+};
+
+//queue the jobs of one window except those done before a resume,
+//returns the time spent waiting on a full queue
+static double pushJobs(FPMPipelineContext *ctx, vector<FPMWindowJob *> &jobs)
+{
+  double wait = 0;
+  for (int i = 0; i < jobs.size(); ++ i)
+  {
+    if (ctx->checkpoint != NULL && ctx->checkpoint->isDone(jobs[i]->index))
+    {
+      vector<FPMPoint> none;
+      ctx->layout->collectWindow(*jobs[i], none);
+      delete jobs[i];
+      continue;
+    }
+    double start = wallTime();
+    ctx->clipped->push(jobs[i]);
+    wait += wallTime() - start;
+  }
+  return wait;
+}
+
+//hands the jobs of every clipped window to the graph stage
+class FPMQueueSink : public FPMWindowSink
+{
+public:
+  FPMQueueSink(FPMPipelineContext *ctx) { m_ctx = ctx; m_waitTime = 0; }
+  void put(int index, FPMPattern &window)
+  {
+    FPMPattern *w = new FPMPattern;
+    w->bbox = window.bbox;
+    w->rect_set.swap(window.rect_set);
+    w->m_poly_fulls.swap(window.m_poly_fulls);
+    vector<FPMWindowJob *> jobs;
+    m_ctx->layout->makeWindowJobs(index, w, true, jobs);
+    m_waitTime += pushJobs(m_ctx, jobs);
+  }
+  double getWaitTime() { return m_waitTime; }
+
+private:
+  FPMPipelineContext *m_ctx;
+  double m_waitTime;//spent on a full queue, not clipping
+};
+
+static void *clipStage(void *arg)
+{
+  FPMPipelineContext *ctx = (FPMPipelineContext *)arg;
+  FPMMemScope mem(FPM_MEM_CLIP);
+  double start = wallTime();
+  double wait = 0;
+  vector<FPMPattern> &subLayouts = ctx->layout->getSubLayouts();
+  if (ctx->windows.empty())
+  {
+    for (int i = 0; i < subLayouts.size(); ++ i)
+    {
+      vector<FPMWindowJob *> jobs;
+      ctx->layout->makeWindowJobs(i, &subLayouts[i], false, jobs);
+      wait += pushJobs(ctx, jobs);
+    }
+  }
+  else
+  {
+    FPMQueueSink sink(ctx);
+    vector<FPMPattern> tempSubLayouts;
+    ctx->layout->clipToWindows(ctx->windows, tempSubLayouts, &sink, ctx->min_shapes);
+    wait = sink.getWaitTime();
+  }
+  ctx->clip_busy = wallTime() - start - wait;
+  for (int i = 0; i < ctx->graph_threads; ++ i)
+    ctx->clipped->push(NULL);
+  return NULL;
+}
+
+static void *graphStage(void *arg)
+{
+  FPMStageArg *sa = (FPMStageArg *)arg;
+  FPMPipelineContext *ctx = sa->ctx;
+  double busy = 0;
+  while (true)
+  {
+    FPMWindowJob *job = ctx->clipped->pop();
+    if (job == NULL)
+      break;
+    double start = wallTime();
+    ctx->layout->buildWindowGraph(*ctx->libraries[job->layer], *job);
+    busy += wallTime() - start;
+    ctx->built->push(job);
+  }
+  ctx->graph_busy[sa->id] = busy;
+  //the last graph thread stops the match threads
+  if (__sync_sub_and_fetch(&ctx->graph_left, 1) == 0)
+  {
+    for (int i = 0; i < ctx->match_threads; ++ i)
+      ctx->built->push(NULL);
+  }
+  return NULL;
+}
+
+static void *matchStage(void *arg)
+{
+  FPMStageArg *sa = (FPMStageArg *)arg;
+  FPMPipelineContext *ctx = sa->ctx;
+  double busy = 0;
+  while (true)
+  {
+    FPMWindowJob *job = ctx->built->pop();
+    if (job == NULL)
+      break;
+    double start = wallTime();
+    ctx->layout->matchWindow(*ctx->libraries[job->layer], ctx->states[sa->id], *job);
+    busy += wallTime() - start;
+    ctx->matched->push(job);
+  }
+  ctx->match_busy[sa->id] = busy;
+  if (__sync_sub_and_fetch(&ctx->match_left, 1) == 0)
+    ctx->matched->push(NULL);
+  return NULL;
+}
+
+static void printQueue(const char *name, FPMJobQueue &queue)
+{
+  printf("  queue %-8s capacity %d, %ld pushes, occupancy avg %.2f max %ld, full waits %ld, empty waits %ld\n",
+         name, queue.getCapacity(), queue.getPushNum(), queue.getAvgOccupancy(), queue.getMaxOccupancy(),
+         queue.getFullWaits(), queue.getEmptyWaits());
+}
+
+static void printStage(const char *name, vector<double> &busy, double elapsed)
+{
+  double sum = 0;
+  for (int i = 0; i < busy.size(); ++ i)
+    sum += busy[i];
+  printf("  stage %-8s %d threads, busy %.3f s, utilization %.0f%%\n",
+         name, (int)busy.size(), sum, elapsed > 0 ? 100 * sum / (elapsed * busy.size()) : 0);
+}
+
+//clip, graph and match windows concurrently, the calling thread collects the points
+void FPMLayout::runPipeline(vector<FPMLibrary*> &libraries, vector<FPMPoint> &mset, long &total_nodes, long &pruned_nodes,
+                            FPMWindowState &stats, vector<int> &layer_hits, FPMCheckpoint *checkpoint)
+{
+  FPMPipelineContext ctx;
+  ctx.layout = this;
+  ctx.libraries = libraries;
+  ctx.checkpoint = checkpoint;
+  ctx.min_shapes = 0;
+  if (m_subLayouts.empty())
+    ctx.min_shapes = chooseWindows(libraries, ctx.windows);
+  ctx.graph_threads = GRAPH_THREADS > 0 ? GRAPH_THREADS : 1;
+  ctx.match_threads = MATCH_THREADS;
+  ctx.graph_left = ctx.graph_threads;
+  ctx.match_left = ctx.match_threads;
+  ctx.states.resize(ctx.match_threads);
+  ctx.clip_busy = 0;
+  ctx.graph_busy.assign(ctx.graph_threads, 0);
+  ctx.match_busy.assign(ctx.match_threads, 0);
+  FPMJobQueue clipped(QUEUE_SIZE), built(QUEUE_SIZE), matched(QUEUE_SIZE);
+  ctx.clipped = &clipped;
+  ctx.built = &built;
+  ctx.matched = &matched;
+
+  double start = wallTime();
+  vector<pthread_t> threads(1 + ctx.graph_threads + ctx.match_threads);
+  vector<FPMStageArg> args(ctx.graph_threads + ctx.match_threads);
+  pthread_create(&threads[0], NULL, clipStage, &ctx);
+  for (int i = 0; i < ctx.graph_threads; ++ i)
+  {
+    args[i].ctx = &ctx;
+    args[i].id = i;
+    pthread_create(&threads[1 + i], NULL, graphStage, &args[i]);
+  }
+  for (int i = 0; i < ctx.match_threads; ++ i)
+  {
+    FPMStageArg &sa = args[ctx.graph_threads + i];
+    sa.ctx = &ctx;
+    sa.id = i;
+    pthread_create(&threads[1 + ctx.graph_threads + i], NULL, matchStage, &sa);
+  }
+
+  //windows finish out of order, points are kept per window and reported in window order
+  map< int, vector<FPMPoint> > points;
+  if (checkpoint != NULL)
+    points = checkpoint->getDone();
+  vector<double> collect_busy(1, 0);
+  int job_num = 0;
+  while (true)
+  {
+    FPMWindowJob *job = matched.pop();
+    if (job == NULL)
+      break;
+    double t = wallTime();
+    total_nodes += job->node_num;
+    pruned_nodes += job->pruned_num;
+    if (job->hit)
+      ++ layer_hits[job->layer];
+    collectWindow(*job, points[job->index]);
+    if (checkpoint != NULL)
+      checkpoint->record(job->index, points[job->index]);
+    delete job;
+    ++ job_num;
+    collect_busy[0] += wallTime() - t;
+  }
+  for (int i = 0; i < threads.size(); ++ i)
+    pthread_join(threads[i], NULL);
+  double elapsed = wallTime() - start;
+
+  for (map< int, vector<FPMPoint> >::iterator it = points.begin(); it != points.end(); ++ it)
+    mset.insert(mset.end(), it->second.begin(), it->second.end());
+  for (int i = 0; i < ctx.states.size(); ++ i)
+  {
+    stats.skipNum += ctx.states[i].skipNum;
+    stats.subsetSkipNum += ctx.states[i].subsetSkipNum;
+  }
+
+  printf("Pipeline matched %d jobs in %.3f s\n", job_num, elapsed);
+  vector<double> clip_busy(1, ctx.clip_busy);
+  printStage("clip", clip_busy, elapsed);
+  printStage("graph", ctx.graph_busy, elapsed);
+  printStage("match", ctx.match_busy, elapsed);
+  printStage("collect", collect_busy, elapsed);
+  printQueue("clipped", clipped);
+  printQueue("built", built);
+  printQueue("matched", matched);
+}
+
+}
@@ -0,0 +1,49 @@
+#ifndef __FPMPIPELINE_H__
+#define __FPMPIPELINE_H__
+#include <vector>
+#include "FPMPattern.h"
+#include "FPMTempEdge.h"
+#include "FPMMatch.h"
+
+//Window matching as a pipeline of stages connected by bounded queues:
+//  clip (1 thread) -> graph (GRAPH_THREADS) -> match (MATCH_THREADS) -> collect (main thread)
+//clip cuts the target layers into windows, graph builds the pruned window graph and
+//its components, match runs the library blocks on them and collect turns the hit
+//into a point. With several target layers a window becomes one job per layer,
+//each matched by the library of that layer. Points are put back in window order, so the result does not depend
+//on the thread counts. With MATCH_THREADS 0 the stages run inline one window after
+//the other.
+
+namespace FPM {
+
+//one window travelling through the stages
+struct FPMWindowJob
+{
+  int index;//window order, points are reported in this order
+  int layer;//index into TARGET_LAYERS, selects the library
+  FPMPattern *window;
+  bool own;//window is deleted after collect
+  FPMTempEdgeVector layoutEdge;
+  std::vector<bool> keep;
+  FPMComponentVector components;
+  FPMComponentVector whole;
+  int node_num;
+  int pruned_num;
+  bool hit;//MATCH_COUNT blocks matched
+  FPMResultPair result;//first mapping of the last matched block
+  int result_num;
+  FPMWindowJob(int i, FPMPattern *w, bool o) { index = i; layer = 0; window = w; own = o; node_num = 0; pruned_num = 0; hit = false; result_num = 0; }
+};
+
+//receives each window as soon as the clipping sweep has passed it
+class FPMWindowSink
+{
+public:
+  virtual ~FPMWindowSink() {}
+  //the sink may take the contents of window
+  virtual void put(int index, FPMPattern &window) = 0;
+};
+
+}
+
+#endif  //FPMPIPELINE_H
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <algorithm>
+#include <dlfcn.h>
+#include "FPMPlugin.h"
+
+namespace FPM {
+using namespace std;
+
+static void toGetCsrSide(int n, vector< pair<int,int> > *lists, vector<int> &off, vector<int> &node, vector<int> &weight)
+{
+  off.assign(n+1,0);
+  node.clear();
+  weight.clear();
+  for(int i=0;i<n;i++)
+  {
+    sort(lists[i].begin(),lists[i].end());
+    for(int k=0;k<lists[i].size();k++)
+    {
+      node.push_back(lists[i][k].first);
+      weight.push_back(lists[i][k].second);
+    }
+    off[i+1]=node.size();
+  }
+}
+
+void toGetCsrGraph(ARGraph<void,int> *graph, FPMCsrGraph &csr)
+{
+  int n=graph->NodeCount();
+  vector< pair<int,int> > *out=new vector< pair<int,int> >[n];
+  vector< pair<int,int> > *in=new vector< pair<int,int> >[n];
+  for(int i=0;i<n;i++)
+  {
+    for(int k=0;k<graph->OutEdgeCount(i);k++)
+    {
+      int *attr;
+      int j=graph->GetOutEdge(i,k,&attr);
+      out[i].push_back(make_pair(j,*attr));
+      in[j].push_back(make_pair(i,*attr));
+    }
+  }
+  toGetCsrSide(n,out,csr.out_off,csr.out_node,csr.out_weight);
+  toGetCsrSide(n,in,csr.in_off,csr.in_node,csr.in_weight);
+  delete [] out;
+  delete [] in;
+
+  //empty vectors have no storage, keep the pointers valid anyway
+  csr.out_node.reserve(1);
+  csr.out_weight.reserve(1);
+  csr.in_node.reserve(1);
+  csr.in_weight.reserve(1);
+  csr.g.node_num=n;
+  csr.g.out_off=&csr.out_off[0];
+  csr.g.out_node=csr.out_node.data();
+  csr.g.out_weight=csr.out_weight.data();
+  csr.g.in_off=&csr.in_off[0];
+  csr.g.in_node=csr.in_node.data();
+  csr.g.in_weight=csr.in_weight.data();
+}
+
+bool FPMPlugin::load(const char *path, unsigned long fingerprint, int block_num)
+{
+  close();
+  void *handle=dlopen(path,RTLD_NOW);
+  if(handle==NULL)
+  {
+    cerr<<"Warning: can not load matcher plugin "<<path<<": "<<dlerror()<<endl;
+    return false;
+  }
+  int *version=(int *)dlsym(handle,"fpm_plugin_version");
+  unsigned long *print=(unsigned long *)dlsym(handle,"fpm_plugin_fingerprint");
+  int *num=(int *)dlsym(handle,"fpm_plugin_block_num");
+  FPMPluginMatcher *matchers=(FPMPluginMatcher *)dlsym(handle,"fpm_plugin_matchers");
+  FPMPluginMatcher *widened=(FPMPluginMatcher *)dlsym(handle,"fpm_plugin_widened");
+  if(version==NULL||print==NULL||num==NULL||matchers==NULL||widened==NULL||*version!=FPM_PLUGIN_VERSION)
+  {
+    cerr<<"Warning: "<<path<<" is not a matcher plugin of this version"<<endl;
+    dlclose(handle);
+    return false;
+  }
+  if(*print!=fingerprint||*num!=block_num)
+  {
+    cerr<<"Warning: matcher plugin "<<path<<" was generated from another library or settings, not used"<<endl;
+    dlclose(handle);
+    return false;
+  }
+  m_handle=handle;
+  m_matchers=matchers;
+  m_widened=widened;
+  m_blockNum=block_num;
+  cout<<"Matcher plugin "<<path<<" loaded for "<<block_num<<" blocks"<<endl;
+  return true;
+}
+
+void FPMPlugin::close()
+{
+  if(m_handle!=NULL)
+    dlclose(m_handle);
+  m_handle=NULL;
+  m_matchers=NULL;
+  m_widened=NULL;
+  m_blockNum=0;
+}
+
+}
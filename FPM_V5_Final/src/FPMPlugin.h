@@ -0,0 +1,95 @@
+#ifndef __FPMPLUGIN_H__
+#define __FPMPLUGIN_H__
+
+//Interface between the matcher and the specialized block matchers generated by
+//FPMLibrary::emitMatchers. The generated source only includes this header and
+//is built as a shared object, e.g.
+//  g++ -O2 -shared -fPIC -I<fpm src dir> matchers.cpp -o matchers.so
+//and loaded with -plugin matchers.so.
+
+#define FPM_PLUGIN_VERSION 1
+
+extern "C" {
+
+//window component in compressed adjacency form, neighbour lists sorted by id
+struct FPMPluginGraph
+{
+  int node_num;
+  const int *out_off;
+  const int *out_node;
+  const int *out_weight;
+  const int *in_off;
+  const int *in_node;
+  const int *in_weight;
+};
+
+//find the first mapping of a block in g in the order VF2 would report it,
+//target_result[i] receives the target node of block node i
+typedef int (*FPMPluginMatcher)(const FPMPluginGraph *g, unsigned short *target_result);
+
+}
+
+//weight of edge a->b or -1, used by the generated code
+static inline int fpm_edge(const FPMPluginGraph *g, int a, int b)
+{
+  int lo=g->out_off[a],hi=g->out_off[a+1];
+  while(lo<hi)
+  {
+    int mid=(lo+hi)>>1;
+    if(g->out_node[mid]<b)
+      lo=mid+1;
+    else
+      hi=mid;
+  }
+  if(lo<g->out_off[a+1]&&g->out_node[lo]==b)
+    return g->out_weight[lo];
+  return -1;
+}
+
+static inline bool fpm_weight_ok(int w, int block_w, int diff)
+{
+  return w>=0&&w-block_w<=diff&&block_w-w<=diff;
+}
+
+#ifndef FPM_PLUGIN_SOURCE
+#include <vector>
+#include "argraph.h"
+
+namespace FPM {
+
+//compressed copy of a component graph handed to the plugin
+struct FPMCsrGraph
+{
+  FPMPluginGraph g;
+  std::vector<int> out_off,out_node,out_weight;
+  std::vector<int> in_off,in_node,in_weight;
+};
+
+void toGetCsrGraph(ARGraph<void,int> *graph, FPMCsrGraph &csr);
+
+//a loaded matcher plugin, only used if it was generated from the same library
+class FPMPlugin
+{
+public:
+  FPMPlugin() { m_handle = NULL; m_matchers = NULL; m_widened = NULL; m_blockNum = 0; }
+  ~FPMPlugin() { close(); }
+  bool load(const char *path, unsigned long fingerprint, int block_num);
+  void close();
+  bool isLoaded() { return m_handle != NULL; }
+  FPMPluginMatcher getMatcher(int j) { return m_handle ? m_matchers[j] : NULL; }
+  FPMPluginMatcher getWidened(int j) { return m_handle ? m_widened[j] : NULL; }
+
+private:
+  void *m_handle;
+  FPMPluginMatcher *m_matchers;
+  FPMPluginMatcher *m_widened;//cluster representative matchers, NULL for other blocks
+  int m_blockNum;
+
+  FPMPlugin(const FPMPlugin &);
+  FPMPlugin &operator = (const FPMPlugin &);
+};
+
+}
+#endif
+
+#endif  //FPMPLUGIN_H
@@ -0,0 +1,182 @@
+#ifndef __FPMQUEUE_H__
+#define __FPMQUEUE_H__
+#include <vector>
+#include <sched.h>
+#include <pthread.h>
+
+namespace FPM {
+
+//bounded multi-producer multi-consumer queue of pointers on a ring of sequenced
+//cells (D. Vyukov's array queue), capacity is rounded up to a power of two.
+//A full or empty queue yields the thread a few times, then sleeps on a condition
+//variable until the cell it waits for is released. The lock is only taken by
+//sleepers and by the threads that wake them.
+template <class T>
+class FPMQueue
+{
+public:
+  FPMQueue(int capacity)
+  {
+    int size = 2;
+    while (size < capacity)
+      size <<= 1;
+    m_mask = size - 1;
+    m_cells.resize(size);
+    for (int i = 0; i < size; ++ i)
+      m_cells[i].seq = i;
+    m_head = m_tail = 0;
+    m_pushNum = m_occupancySum = 0;
+    m_maxOccupancy = 0;
+    m_fullWaits = m_emptyWaits = 0;
+    m_pushSleepers = m_popSleepers = 0;
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_notFull, NULL);
+    pthread_cond_init(&m_notEmpty, NULL);
+  }
+
+  ~FPMQueue()
+  {
+    pthread_mutex_destroy(&m_lock);
+    pthread_cond_destroy(&m_notFull);
+    pthread_cond_destroy(&m_notEmpty);
+  }
+
+  void push(T *item)
+  {
+    long pos = m_tail;
+    int spins = 0;
+    while (true)
+    {
+      Cell &cell = m_cells[pos & m_mask];
+      long diff = cell.seq - pos;
+      if (diff == 0)
+      {
+        if (__sync_bool_compare_and_swap(&m_tail, pos, pos + 1))
+          break;
+      }
+      else if (diff < 0)
+      {
+        __sync_fetch_and_add(&m_fullWaits, 1);
+        if (++ spins < SPIN_LIMIT)
+          sched_yield();
+        else
+        {
+          sleepOn(cell, pos, &m_pushSleepers, &m_notFull);
+          spins = 0;
+        }
+      }
+      pos = m_tail;
+    }
+    Cell &cell = m_cells[pos & m_mask];
+    cell.item = item;
+    __sync_synchronize();
+    cell.seq = pos + 1;
+    wake(&m_popSleepers, &m_notEmpty);
+
+    //occupancy seen by the producer, head may lag a little
+    long occupancy = pos + 1 - m_head;
+    __sync_fetch_and_add(&m_pushNum, 1);
+    __sync_fetch_and_add(&m_occupancySum, occupancy);
+    long max = m_maxOccupancy;
+    while (occupancy > max && !__sync_bool_compare_and_swap(&m_maxOccupancy, max, occupancy))
+      max = m_maxOccupancy;
+  }
+
+  T *pop()
+  {
+    long pos = m_head;
+    int spins = 0;
+    while (true)
+    {
+      Cell &cell = m_cells[pos & m_mask];
+      long diff = cell.seq - (pos + 1);
+      if (diff == 0)
+      {
+        if (__sync_bool_compare_and_swap(&m_head, pos, pos + 1))
+          break;
+      }
+      else if (diff < 0)
+      {
+        __sync_fetch_and_add(&m_emptyWaits, 1);
+        if (++ spins < SPIN_LIMIT)
+          sched_yield();
+        else
+        {
+          sleepOn(cell, pos + 1, &m_popSleepers, &m_notEmpty);
+          spins = 0;
+        }
+      }
+      pos = m_head;
+    }
+    Cell &cell = m_cells[pos & m_mask];
+    T *item = cell.item;
+    __sync_synchronize();
+    cell.seq = pos + m_mask + 1;
+    wake(&m_pushSleepers, &m_notFull);
+    return item;
+  }
+
+  int getCapacity() { return m_mask + 1; }
+  long getPushNum() { return m_pushNum; }
+  double getAvgOccupancy() { return m_pushNum > 0 ? (double)m_occupancySum / m_pushNum : 0; }
+  long getMaxOccupancy() { return m_maxOccupancy; }
+  long getFullWaits() { return m_fullWaits; }
+  long getEmptyWaits() { return m_emptyWaits; }
+
+private:
+  enum { SPIN_LIMIT = 16 };//yields before a full or empty queue sleeps
+
+  struct Cell
+  {
+    volatile long seq;
+    T *item;
+  };
+
+  //sleep until the sequence of cell reaches seq. The sleeper is counted before the
+  //sequence is read again, and wake() reads the count after storing a sequence,
+  //so either the sleeper sees the new sequence or wake() sees the sleeper
+  void sleepOn(Cell &cell, long seq, volatile long *sleepers, pthread_cond_t *cond)
+  {
+    pthread_mutex_lock(&m_lock);
+    __sync_fetch_and_add(sleepers, 1);
+    while (cell.seq - seq < 0)
+      pthread_cond_wait(cond, &m_lock);
+    __sync_fetch_and_sub(sleepers, 1);
+    pthread_mutex_unlock(&m_lock);
+  }
+
+  //wake every sleeper of one side, they wait on different cells
+  void wake(volatile long *sleepers, pthread_cond_t *cond)
+  {
+    __sync_synchronize();
+    if (*sleepers == 0)
+      return;
+    pthread_mutex_lock(&m_lock);
+    pthread_cond_broadcast(cond);
+    pthread_mutex_unlock(&m_lock);
+  }
+
+  std::vector<Cell> m_cells;
+  long m_mask;
+  volatile long m_head;
+  volatile long m_tail;
+
+  volatile long m_pushNum;
+  volatile long m_occupancySum;
+  volatile long m_maxOccupancy;
+  volatile long m_fullWaits;
+  volatile long m_emptyWaits;
+
+  pthread_mutex_t m_lock;
+  pthread_cond_t m_notFull;
+  pthread_cond_t m_notEmpty;
+  volatile long m_pushSleepers;
+  volatile long m_popSleepers;
+
+  FPMQueue(const FPMQueue &);
+  FPMQueue &operator = (const FPMQueue &);
+};
+
+}
+
+#endif  //FPMQUEUE_H
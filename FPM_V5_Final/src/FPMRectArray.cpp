@@ -0,0 +1,136 @@
+#include "FPMRectArray.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+namespace FPM {
+using namespace std;
+
+//append the lanes set in mask, lowest first so the order is the scalar order
+static inline void appendHits(int k, int mask, const int *clx, const int *cby, const int *crx, const int *cty,
+                              vector<int> &hit, FPMRectArray *out)
+{
+  while (mask != 0)
+  {
+    int b = __builtin_ctz(mask);
+    mask &= mask - 1;
+    hit.push_back(k + b);
+    if (out != NULL)
+      out->add(clx[b], cby[b], crx[b], cty[b]);
+  }
+}
+
+int clipRects(const FPMRect &window, const FPMRectArray &rects, int first, vector<int> &hit, FPMRectArray *out)
+{
+  int wlx = window.lb.x;
+  int wby = window.lb.y;
+  int wrx = window.lb.x + window.width;
+  int wty = window.lb.y + window.height;
+  int n = rects.size();
+  hit.clear();
+  if (out != NULL)
+    out->clear();
+  int k = first;
+
+#if defined(__AVX2__)
+  __m256i vlx = _mm256_set1_epi32(wlx);
+  __m256i vby = _mm256_set1_epi32(wby);
+  __m256i vrx = _mm256_set1_epi32(wrx);
+  __m256i vty = _mm256_set1_epi32(wty);
+  for (; k + 8 <= n; k += 8)
+  {
+    __m256i lx = _mm256_loadu_si256((const __m256i *)&rects.lx[k]);
+    __m256i by = _mm256_loadu_si256((const __m256i *)&rects.by[k]);
+    __m256i rx = _mm256_loadu_si256((const __m256i *)&rects.rx[k]);
+    __m256i ty = _mm256_loadu_si256((const __m256i *)&rects.ty[k]);
+    __m256i m = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(rx, vlx), _mm256_cmpgt_epi32(ty, vby)),
+                                 _mm256_and_si256(_mm256_cmpgt_epi32(vrx, lx), _mm256_cmpgt_epi32(vty, by)));
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(m));
+    if (mask == 0)
+      continue;
+    int clx[8], cby[8], crx[8], cty[8];
+    _mm256_storeu_si256((__m256i *)clx, _mm256_max_epi32(lx, vlx));
+    _mm256_storeu_si256((__m256i *)cby, _mm256_max_epi32(by, vby));
+    _mm256_storeu_si256((__m256i *)crx, _mm256_min_epi32(rx, vrx));
+    _mm256_storeu_si256((__m256i *)cty, _mm256_min_epi32(ty, vty));
+    appendHits(k, mask, clx, cby, crx, cty, hit, out);
+  }
+#elif defined(__SSE4_1__)
+  __m128i vlx = _mm_set1_epi32(wlx);
+  __m128i vby = _mm_set1_epi32(wby);
+  __m128i vrx = _mm_set1_epi32(wrx);
+  __m128i vty = _mm_set1_epi32(wty);
+  for (; k + 4 <= n; k += 4)
+  {
+    __m128i lx = _mm_loadu_si128((const __m128i *)&rects.lx[k]);
+    __m128i by = _mm_loadu_si128((const __m128i *)&rects.by[k]);
+    __m128i rx = _mm_loadu_si128((const __m128i *)&rects.rx[k]);
+    __m128i ty = _mm_loadu_si128((const __m128i *)&rects.ty[k]);
+    __m128i m = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(rx, vlx), _mm_cmpgt_epi32(ty, vby)),
+                              _mm_and_si128(_mm_cmpgt_epi32(vrx, lx), _mm_cmpgt_epi32(vty, by)));
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(m));
+    if (mask == 0)
+      continue;
+    int clx[4], cby[4], crx[4], cty[4];
+    _mm_storeu_si128((__m128i *)clx, _mm_max_epi32(lx, vlx));
+    _mm_storeu_si128((__m128i *)cby, _mm_max_epi32(by, vby));
+    _mm_storeu_si128((__m128i *)crx, _mm_min_epi32(rx, vrx));
+    _mm_storeu_si128((__m128i *)cty, _mm_min_epi32(ty, vty));
+    appendHits(k, mask, clx, cby, crx, cty, hit, out);
+  }
+#endif
+
+  for (; k < n; ++ k)
+  {
+    if (wlx >= rects.rx[k] || wby >= rects.ty[k] || rects.lx[k] >= wrx || rects.by[k] >= wty)
+      continue;
+    hit.push_back(k);
+    if (out != NULL)
+      out->add(rects.lx[k] > wlx ? rects.lx[k] : wlx, rects.by[k] > wby ? rects.by[k] : wby,
+               rects.rx[k] < wrx ? rects.rx[k] : wrx, rects.ty[k] < wty ? rects.ty[k] : wty);
+  }
+  return hit.size();
+}
+
+void countInside(int x, int y, const FPMRectArray &boxes, vector<int> &counts)
+{
+  int n = boxes.size();
+  int k = 0;
+#if defined(__AVX2__)
+  __m256i vx = _mm256_set1_epi32(x);
+  __m256i vy = _mm256_set1_epi32(y);
+  for (; k + 8 <= n; k += 8)
+  {
+    __m256i m = _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpgt_epi32(vx, _mm256_loadu_si256((const __m256i *)&boxes.lx[k])),
+                         _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)&boxes.rx[k]), vx)),
+        _mm256_and_si256(_mm256_cmpgt_epi32(vy, _mm256_loadu_si256((const __m256i *)&boxes.by[k])),
+                         _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)&boxes.ty[k]), vy)));
+    //true lanes are -1
+    __m256i c = _mm256_loadu_si256((const __m256i *)&counts[k]);
+    _mm256_storeu_si256((__m256i *)&counts[k], _mm256_sub_epi32(c, m));
+  }
+#elif defined(__SSE4_1__)
+  __m128i vx = _mm_set1_epi32(x);
+  __m128i vy = _mm_set1_epi32(y);
+  for (; k + 4 <= n; k += 4)
+  {
+    __m128i m = _mm_and_si128(
+        _mm_and_si128(_mm_cmpgt_epi32(vx, _mm_loadu_si128((const __m128i *)&boxes.lx[k])),
+                      _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *)&boxes.rx[k]), vx)),
+        _mm_and_si128(_mm_cmpgt_epi32(vy, _mm_loadu_si128((const __m128i *)&boxes.by[k])),
+                      _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *)&boxes.ty[k]), vy)));
+    __m128i c = _mm_loadu_si128((const __m128i *)&counts[k]);
+    _mm_storeu_si128((__m128i *)&counts[k], _mm_sub_epi32(c, m));
+  }
+#endif
+  for (; k < n; ++ k)
+  {
+    if (x > boxes.lx[k] && x < boxes.rx[k] && y > boxes.by[k] && y < boxes.ty[k])
+      ++ counts[k];
+  }
+}
+
+}
@@ -0,0 +1,33 @@
+#ifndef __FPMRECTARRAY_H__
+#define __FPMRECTARRAY_H__
+#include <vector>
+#include "FPMRect.h"
+
+namespace FPM {
+
+//rectangles as separate coordinate arrays for the batch kernels below, which
+//test a whole array against one window with AVX2 or SSE4.1 when the compiler
+//targets them and with scalar code otherwise
+struct FPMRectArray
+{
+  std::vector<int> lx;
+  std::vector<int> by;
+  std::vector<int> rx;
+  std::vector<int> ty;
+
+  void clear() { lx.clear(); by.clear(); rx.clear(); ty.clear(); }
+  void add(const FPMRect &r) { add(r.lb.x, r.lb.y, r.lb.x + r.width, r.lb.y + r.height); }
+  void add(int l, int b, int r, int t) { lx.push_back(l); by.push_back(b); rx.push_back(r); ty.push_back(t); }
+  int size() const { return lx.size(); }
+};
+
+//rectangles from first on overlapping window, same test as checkOverlap; hit gets
+//their indices in order and out, if given, the parts inside window
+int clipRects(const FPMRect &window, const FPMRectArray &rects, int first, std::vector<int> &hit, FPMRectArray *out);
+
+//++counts[k] for every box k strictly containing (x,y), same test as within_box
+void countInside(int x, int y, const FPMRectArray &boxes, std::vector<int> &counts);
+
+}
+
+#endif  //FPMRECTARRAY_H
@@ -0,0 +1,303 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <sys/time.h>
+#include "argedit.h"
+#include "match.h"
+#include "vf2_sub_state.h"
+#include "vf_sub_state.h"
+#include "ull_sub_state.h"
+#include "EdgeComparator.h"
+#include "FPMReplay.h"
+
+namespace FPM {
+using namespace std;
+
+//same cap on reported mappings as my_visitor
+const int FPM_REPLAY_VISIT_MAX = 30000;
+const int FPM_REPLAY_AUT_MAX = 1000;
+
+static volatile int capture_num = 0;
+
+static double wallTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+//the comparators accept |a-b| <= tolerance, find the largest such difference
+static int edgeTolerance(ARGraph<void,int> *g)
+{
+  int zero = 0;
+  int lo = -1, hi = 1 << 24;
+  while (lo < hi)
+  {
+    int mid = lo + (hi - lo + 1) / 2;
+    if (g->CompatibleEdge(&zero, &mid))
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+static void writeGraph(FILE *f, const char *name, ARGraph<void,int> *g)
+{
+  int n = g->NodeCount();
+  int m = 0;
+  for (int i = 0; i < n; ++ i)
+    m += g->OutEdgeCount(i);
+  fprintf(f, "%s %d %d\n", name, n, m);
+  for (int i = 0; i < n; ++ i)
+  {
+    for (int k = 0; k < g->OutEdgeCount(i); ++ k)
+    {
+      int *attr;
+      int j = g->GetOutEdge(i, k, &attr);
+      fprintf(f, "%d %d %d\n", i, j, *attr);
+    }
+  }
+}
+
+void captureMatch(ARGraph<void,int> *sub_graph, ARGraph<void,int> *target_graph, int sub_num, int *F,
+                  const SymBreak *sym, double ms, int result_num)
+{
+  int id = __sync_fetch_and_add(&capture_num, 1);
+  if (id >= FPM_CAPTURE_MAX)
+    return;
+  char name[64];
+  sprintf(name, "fpm_replay_%d.txt", id);
+  FILE *f = fopen(name, "w");
+  if (f == NULL)
+    return;
+  fprintf(f, "FPM replay 1\n");
+  fprintf(f, "time_ms %.3f\n", ms);
+  fprintf(f, "results %d\n", result_num);
+  fprintf(f, "tolerance %d\n", edgeTolerance(sub_graph));
+  fprintf(f, "F %d", sub_num);
+  for (int i = 0; i < sub_num; ++ i)
+    fprintf(f, " %d", F[i]);
+  fprintf(f, "\n");
+  if (sym != NULL && sym->aut_num > 1)
+  {
+    fprintf(f, "sym %d %d", sym->aut_num, (int)sym->base.size());
+    for (int i = 0; i < sym->base.size(); ++ i)
+      fprintf(f, " %d", sym->base[i]);
+    fprintf(f, "\n");
+    for (int v = 0; v < sym->after.size(); ++ v)
+    {
+      fprintf(f, "after %d", (int)sym->after[v].size());
+      for (int i = 0; i < sym->after[v].size(); ++ i)
+        fprintf(f, " %d", sym->after[v][i]);
+      fprintf(f, "\n");
+    }
+  }
+  else
+    fprintf(f, "sym 1 0\n");
+  writeGraph(f, "block", sub_graph);
+  writeGraph(f, "target", target_graph);
+  fclose(f);
+  printf("Captured a %.1f ms match in %s\n", ms, name);
+}
+
+struct FPMReplayGraph
+{
+  int n;
+  vector<int> from, to, weight;
+};
+
+static bool readKey(FILE *f, const char *key)
+{
+  char word[32];
+  return fscanf(f, "%31s", word) == 1 && strcmp(word, key) == 0;
+}
+
+static bool readGraph(FILE *f, const char *name, FPMReplayGraph &g)
+{
+  int m;
+  if (!readKey(f, name) || fscanf(f, "%d %d", &g.n, &m) != 2)
+    return false;
+  g.from.resize(m);
+  g.to.resize(m);
+  g.weight.resize(m);
+  for (int k = 0; k < m; ++ k)
+  {
+    if (fscanf(f, "%d %d %d", &g.from[k], &g.to[k], &g.weight[k]) != 3)
+      return false;
+  }
+  return true;
+}
+
+//node i of g becomes node order[i], tolerance < 0 leaves the edges uncompared
+static ARGraph<void,int> *buildGraph(FPMReplayGraph &g, const vector<int> &order, int tolerance)
+{
+  vector<int> rorder(g.n);
+  for (int i = 0; i < g.n; ++ i)
+    rorder[order[i]] = i;
+  ARGEdit edit;
+  for (int i = 0; i < g.n; ++ i)
+    edit.InsertNode(NULL);
+  //ARGEdit keeps edges in insertion order, insert them by new source node
+  for (int i = 0; i < g.n; ++ i)
+  {
+    for (int k = 0; k < g.from.size(); ++ k)
+    {
+      if (g.from[k] == rorder[i])
+        edit.InsertEdge(i, order[g.to[k]], &g.weight[k]);
+    }
+  }
+  ARGraph<void,int> *graph = new ARGraph<void,int>(&edit);
+  if (tolerance >= 0)
+    graph->SetEdgeComparator(new EdgeComparator(tolerance));
+  return graph;
+}
+
+static bool countVisitor(int n, node_id ni1[], node_id ni2[], void *user_data)
+{
+  int *count = (int *)user_data;
+  return ++ *count >= FPM_REPLAY_VISIT_MAX;
+}
+
+static void runEngine(const char *engine, const char *ordering, int tolerance, ARGraph<void,int> *sub,
+                      ARGraph<void,int> *target, const SymBreak *sym)
+{
+  int count = 0;
+  double start = wallTime();
+  if (strcmp(engine, "sym") == 0)
+  {
+    SymSubState s0(sub, target, sym);
+    match(&s0, countVisitor, &count);
+  }
+  else if (strcmp(engine, "vf2") == 0)
+  {
+    VF2SubState s0(sub, target);
+    match(&s0, countVisitor, &count);
+  }
+  else if (strcmp(engine, "vf") == 0)
+  {
+    VFSubState s0(sub, target);
+    match(&s0, countVisitor, &count);
+  }
+  else
+  {
+    UllSubState s0(sub, target);
+    match(&s0, countVisitor, &count);
+  }
+  printf("  %-4s %-9s tolerance %5d: %10.3f ms, %d mappings\n", engine, ordering, tolerance,
+         (wallTime() - start) * 1000, count);
+}
+
+int replayMatch(const char *fileName)
+{
+  FILE *f = fopen(fileName, "r");
+  if (f == NULL)
+  {
+    cerr << "Can not open replay file " << fileName << endl;
+    return -1;
+  }
+  double ms;
+  int results, tolerance, sub_num;
+  SymBreak sym;
+  FPMReplayGraph block, target;
+  bool ok = readKey(f, "FPM") && readKey(f, "replay") && readKey(f, "1") &&
+            readKey(f, "time_ms") && fscanf(f, "%lf", &ms) == 1 &&
+            readKey(f, "results") && fscanf(f, "%d", &results) == 1 &&
+            readKey(f, "tolerance") && fscanf(f, "%d", &tolerance) == 1 &&
+            readKey(f, "F") && fscanf(f, "%d", &sub_num) == 1;
+  for (int i = 0; ok && i < sub_num; ++ i)
+  {
+    int F;
+    ok = fscanf(f, "%d", &F) == 1;
+  }
+  int base_num = 0;
+  ok = ok && readKey(f, "sym") && fscanf(f, "%d %d", &sym.aut_num, &base_num) == 2;
+  for (int i = 0; ok && i < base_num; ++ i)
+  {
+    int b;
+    ok = fscanf(f, "%d", &b) == 1;
+    sym.base.push_back(b);
+  }
+  if (ok && sym.aut_num > 1)
+  {
+    sym.after.resize(sub_num);
+    for (int v = 0; ok && v < sub_num; ++ v)
+    {
+      int k;
+      ok = readKey(f, "after") && fscanf(f, "%d", &k) == 1;
+      for (int i = 0; ok && i < k; ++ i)
+      {
+        int u;
+        ok = fscanf(f, "%d", &u) == 1;
+        sym.after[v].push_back(u);
+      }
+    }
+  }
+  ok = ok && readGraph(f, "block", block) && readGraph(f, "target", target);
+  fclose(f);
+  if (!ok)
+  {
+    cerr << "Bad replay file " << fileName << endl;
+    return -1;
+  }
+  printf("Replay %s: block %d nodes, target %d nodes, captured at %.3f ms with %d mappings\n",
+         fileName, block.n, target.n, ms, results);
+
+  //node orderings of the block: as captured, reversed and by decreasing degree
+  vector<int> degree(block.n, 0);
+  for (int k = 0; k < block.from.size(); ++ k)
+  {
+    ++ degree[block.from[k]];
+    ++ degree[block.to[k]];
+  }
+  vector< pair<int,int> > by_degree;
+  for (int i = 0; i < block.n; ++ i)
+    by_degree.push_back(make_pair(-degree[i], i));
+  sort(by_degree.begin(), by_degree.end());
+  const char *orderings[3] = {"captured", "reversed", "degree"};
+  vector< vector<int> > orders(3, vector<int>(block.n));
+  for (int i = 0; i < block.n; ++ i)
+  {
+    orders[0][i] = i;
+    orders[1][i] = block.n - 1 - i;
+    orders[2][by_degree[i].second] = i;
+  }
+
+  vector<int> identity(target.n);
+  for (int i = 0; i < target.n; ++ i)
+    identity[i] = i;
+  ARGraph<void,int> *target_graph = buildGraph(target, identity, -1);
+  for (int o = 0; o < 3; ++ o)
+  {
+    ARGraph<void,int> *sub = buildGraph(block, orders[o], tolerance);
+    SymBreak order_sym;
+    if (o == 0)
+      order_sym = sym;
+    else if (sym.aut_num > 1)
+    {
+      //orbits are only valid for the node order they were computed on
+      ARGraph<void,int> *exact = buildGraph(block, orders[o], 0);
+      toGetSymBreak(exact, FPM_REPLAY_AUT_MAX, order_sym);
+      delete exact;
+    }
+    if (sym.aut_num > 1 && order_sym.aut_num > 1)
+      runEngine("sym", orderings[o], tolerance, sub, target_graph, &order_sym);
+    runEngine("vf2", orderings[o], tolerance, sub, target_graph, NULL);
+    runEngine("vf", orderings[o], tolerance, sub, target_graph, NULL);
+    runEngine("ull", orderings[o], tolerance, sub, target_graph, NULL);
+    delete sub;
+  }
+  int tolerances[3] = {0, tolerance / 2, tolerance * 2};
+  for (int t = 0; t < 3; ++ t)
+  {
+    ARGraph<void,int> *sub = buildGraph(block, orders[0], tolerances[t]);
+    runEngine("vf2", orderings[0], tolerances[t], sub, target_graph, NULL);
+    delete sub;
+  }
+  delete target_graph;
+  return 0;
+}
+
+}
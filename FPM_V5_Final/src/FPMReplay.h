@@ -0,0 +1,23 @@
+#ifndef __FPMREPLAY_H__
+#define __FPMREPLAY_H__
+#include "argraph.h"
+#include "SymSubState.h"
+
+//Capture and replay of single slow VF2 calls. With -capture ms every block
+//against window component call running longer than ms is written to
+//fpm_replay_<n>.txt (at most FPM_CAPTURE_MAX files): the block graph with its
+//F mapping and symmetry breaking, the component graph, the edge weights and the
+//tolerance of the block comparator. -replay file reruns just that call with the
+//recorded and other engines, node orderings and tolerances, without the layout.
+
+namespace FPM {
+
+const int FPM_CAPTURE_MAX = 100;
+
+void captureMatch(ARGraph<void,int> *sub_graph, ARGraph<void,int> *target_graph, int sub_num, int *F,
+                  const SymBreak *sym, double ms, int result_num);
+int replayMatch(const char *fileName);
+
+}
+
+#endif  //FPMREPLAY_H
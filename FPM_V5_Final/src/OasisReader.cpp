@@ -85,7 +85,11 @@ GetPointListTypeName (PointList::ListType ltype)
 
 // OasisReader constructor
 //   fp         output file
-OasisReader::OasisReader (FILE* fp, FPM::FPMLayout &layout):fpout(fp), m_layout(layout), m_rep(Null) {}
+OasisReader::OasisReader (FILE* fp, FPM::FPMLayout &layout):fpout(fp), m_layout(layout), m_rep(Null)
+{
+    m_firstRect = layout.getRectNum();
+    m_firstPoly = layout.getPolyNum();
+}
 
 /*virtual*/
 OasisReader::~OasisReader() { }
@@ -117,6 +121,14 @@ OasisReader::beginFile (const string& version,
 #ifdef DEBUGINFO
     print(", validation scheme = %s\n", scheme);
 #endif
+
+    // A single-pass parse that has to start over calls beginFile()
+    // again.  Drop the shapes of the abandoned parse.
+    std::vector<FPM::FPMRect> &rects = m_layout.getRects();
+    std::vector<FPM::FPMPoly> &polys = m_layout.getPolys();
+    rects.erase(rects.begin() + m_firstRect, rects.end());
+    polys.erase(polys.begin() + m_firstPoly, polys.end());
+    m_rep = Null;
 }
 
 
@@ -220,176 +232,14 @@ OasisReader::beginRectangle (Ulong layer, Ulong datatype,
       return;
     }
     
-    RepetitionType  repType = rep->getType();
-    if (repType == Rep_ReusePrevious)
+    rep = reuseRepetition(rep);
+    repetitionMoves(rep, m_moves);
+    for (int k = 0; k < m_moves.size(); ++ k)
     {
-#ifdef DEBUGINFO
-      printf("Warning: reuse previous repetitioin type!\n");
-#endif
-      assert(m_rep != Null);
-      repType = m_rep->getType();
-      rep = m_rep;
-    }
-    else
-    {
-      m_rep = rep;
-    }
-    assert(repType != Rep_ReusePrevious);
-    int MoveX = 0, MoveY = 0;
-    
-    switch (repType) {
-        // repetition type = Matrix (1)
-        //     xdimen = AAA, ydimen = BBB, xspace = CCC, yspace = DDD
-        case Rep_Matrix:
-          {
-            for (int i = 0; i < rep->getMatrixXdimen(); ++ i)
-            {
-              MoveX = i * rep->getMatrixXspace();
-              for (int j = 0; j < rep->getMatrixYdimen(); ++ j)
-              {
-                MoveY = j * rep->getMatrixYspace();
-                FPM::FPMRect r2 = r;
-                r2.lb.x = r2.lb.x + MoveX;
-                r2.lb.y = r2.lb.y + MoveY;
-                m_layout.addRect(r2);
-              }
-            }
-          }
-          break;
-        
-        // repetition type = UniformX (2)
-        //     dimen = AAA, xspace = BBB
-        case Rep_UniformX:
-          {
-            for (int i = 0; i < rep->getDimen(); ++ i)
-            {
-              MoveX = i * rep->getUniformXspace();
-              FPM::FPMRect r2 = r;
-              r2.lb.x = r2.lb.x + MoveX;
-              m_layout.addRect(r2);
-            }
-          }
-          break;
-
-        case Rep_UniformY:
-          {
-            for (int j = 0; j < rep->getDimen(); ++ j)
-            {
-              MoveY = j * rep->getUniformYspace();
-              FPM::FPMRect r2 = r;
-              r2.lb.y = r2.lb.y + MoveY;
-              m_layout.addRect(r2);
-            }
-          }
-          break;
-
-        // repetition type = VaryingX (4)
-        //     NNN points
-        //     0  X1  X2  X3  X4      <---- the X offsets (first is always 0)
-        //     X5  X6  ...
-        //
-        // For Rep_GridVaryingX, the first two lines will be:
-        // repetition type = GridVaryingX (5)
-        //     NNN points, grid = GGG
-        case Rep_VaryingX:
-        case Rep_GridVaryingX: {
-#ifdef DEBUGINFO
-            printf("Warning: Repetition type Rep_GridVaryingX or Rep_VaryingX!\n");
-#endif
-            Ulong  dimen = rep->getDimen();
-            int grid = 1;
-//            if (repType == Rep_GridVaryingX)
-//              grid = rep->getGrid();
-            assert(rep->getVaryingXoffset(0) == 0);
-            MoveX = 0;
-            for (Ulong j = 0;  j < dimen;  ++j) {
-              MoveX = grid * rep->getVaryingXoffset(j);
-              FPM::FPMRect r2 = r;
-              r2.lb.x += MoveX;
-              m_layout.addRect(r2);
-            }
-            break;
-        }
-
-        // This is the same as the code above, except with y instead of x.
-        case Rep_VaryingY: //(6)
-        case Rep_GridVaryingY: { //(7)
-#ifdef DEBUGINFO
-            printf("Warning: Repetition type Rep_GridVaryingY or Rep_VaryingY!\n");
-#endif
-            Ulong  dimen = rep->getDimen();
-            int grid = 1;
-//            if (repType == Rep_GridVaryingY)
-//                grid = rep->getGrid();
-            assert(rep->getVaryingYoffset(0) == 0);
-            MoveY = 0;
-            for (Ulong j = 0;  j < dimen; ++j) {
-              MoveY = grid * rep->getVaryingYoffset(j);
-              FPM::FPMRect r2 = r;
-              r2.lb.y += MoveY;
-              m_layout.addRect(r2);
-            }
-            break;
-        }
-        
-        case Rep_TiltedMatrix: { //(8)
-#ifdef DEBUGINFO
-            printf("Warning: Repetition type Rep_TiltedMatrix!\n");
-#endif
-            Delta  ndelta = rep->getMatrixNdelta();
-            Delta  mdelta = rep->getMatrixMdelta();
-            for (int i = 0; i < rep->getMatrixNdimen(); ++ i)
-            {
-              for (int j = 0; j < rep->getMatrixMdimen(); ++ j)
-              {
-                MoveX = i * ndelta.x + j * mdelta.x;
-                MoveY = i * ndelta.y + j * mdelta.y;
-                FPM::FPMRect r2 = r;
-                r2.lb.x += MoveX;
-                r2.lb.y += MoveY;
-                m_layout.addRect(r2);
-              }
-            }
-            break;
-        }
-
-        case Rep_Diagonal: { //(9)
-            Delta  delta = rep->getDiagonalDelta();
-            for (int i = 0; i < rep->getDimen(); ++ i)
-            {
-              MoveX = i * delta.x;
-              MoveY = i * delta.y;
-              FPM::FPMRect r2 = r;
-              r2.lb.x += MoveX;
-              r2.lb.y += MoveY;
-              m_layout.addRect(r2);
-            }
-            break;
-        }
-        
-        case Rep_Arbitrary: //(10)
-        case Rep_GridArbitrary: { //(11)
-//#ifdef DEBUGINFO
-//            printf("Warning: Repetition type Rep_Arbitrary or Rep_GridArbitrary!\n");
-//#endif
-            Ulong  dimen = rep->getDimen();
-            int grid = 1;
-            //////////////NOTE: grid is set to 1
-//            if (repType == Rep_GridArbitrary) 
-//                grid = rep->getGrid();
-            MoveX = MoveY = 0;
-            assert(rep->getDelta(0).x == 0 && rep->getDelta(0).y == 0);
-            for (Ulong j = 0;  j < dimen;  ++j) {
-              Delta  delta = rep->getDelta(j);
-              MoveX = grid * delta.x;
-              MoveY = grid * delta.y;
-              FPM::FPMRect r2 = r;
-              r2.lb.x += MoveX;
-              r2.lb.y += MoveY;
-              m_layout.addRect(r2);              
-            }
-            break;
-        }
+      FPM::FPMRect r2 = r;
+      r2.lb.x += m_moves[k].x;
+      r2.lb.y += m_moves[k].y;
+      m_layout.addRect(r2);
     }
     
     printRepetition(rep);
@@ -410,39 +260,134 @@ OasisReader::beginPolygon (Ulong layer, Ulong datatype,
     printPointList(ptlist);
 #endif
     
-    FPM::FPMPoly p;
-    p.layer = layer;
+    m_points.resize(ptlist.size());
     PointList::const_iterator  iter = ptlist.begin(),
                                 end = ptlist.end();
-    for ( ; iter != end; ++iter) {
-        FPM::FPMPoint pt;
-        pt.x = x + iter -> x;
-        pt.y = y + iter -> y;
-        p.ptlist.push_back(pt);
+    for (int k = 0; iter != end; ++iter, ++k) {
+        m_points[k].x = x + iter -> x;
+        m_points[k].y = y + iter -> y;
     }
     
     if (rep == Null)
     {
-      m_layout.addPoly(p);
+      addPolys(layer, Null);
       return;
     }
-    RepetitionType  repType = rep->getType();
-    if (repType == Rep_ReusePrevious)
+
+    rep = reuseRepetition(rep);
+    repetitionMoves(rep, m_moves);
+    addPolys(layer, &m_moves);
+    
+    printRepetition(rep);
+}
+
+/*virtual*/ bool
+OasisReader::wantBatches()
+{
+    return true;
+}
+
+// addElements -- add a run of rectangles or polygons of one layer.
+// Converts the batch straight into FPMRects and FPMPolys; each distinct
+// repetition of the batch is expanded only once.
+
+/*virtual*/ void
+OasisReader::addElements (const ElementBatch& batch)
+{
+    size_t n = batch.size();
+    Ulong movesRep = ElementBatch::NoRepetition;
+    
+    if (batch.kind == ElementBatch::Rectangles)
+    {
+      FPM::FPMRect r;
+      r.layer = batch.layer;
+      for (size_t i = 0; i < n; ++ i)
+      {
+        const long *c = &batch.coords[4 * i];
+        r.lb.x = c[0];
+        r.lb.y = c[1];
+        r.width = c[2];
+        r.height = c[3];
+        Ulong ri = batch.repIndex[i];
+        if (ri == ElementBatch::NoRepetition)
+        {
+          m_layout.addRect(r);
+          continue;
+        }
+        if (ri != movesRep)
+        {
+          repetitionMoves(&batch.reps[ri], m_moves);
+          movesRep = ri;
+        }
+        for (int k = 0; k < m_moves.size(); ++ k)
+        {
+          FPM::FPMRect r2 = r;
+          r2.lb.x += m_moves[k].x;
+          r2.lb.y += m_moves[k].y;
+          m_layout.addRect(r2);
+        }
+      }
+      return;
+    }
+    
+    for (size_t i = 0; i < n; ++ i)
+    {
+      long x = batch.coords[2 * i];
+      long y = batch.coords[2 * i + 1];
+      m_points.resize(batch.pointStart[i + 1] - batch.pointStart[i]);
+      const Delta *d = &batch.points[batch.pointStart[i]];
+      for (int k = 0; k < m_points.size(); ++ k)
+      {
+        m_points[k].x = x + d[k].x;
+        m_points[k].y = y + d[k].y;
+      }
+      Ulong ri = batch.repIndex[i];
+      if (ri == ElementBatch::NoRepetition)
+      {
+        addPolys(batch.layer, Null);
+        continue;
+      }
+      if (ri != movesRep)
+      {
+        repetitionMoves(&batch.reps[ri], m_moves);
+        movesRep = ri;
+      }
+      addPolys(batch.layer, &m_moves);
+    }
+}
+
+// reuseRepetition -- resolve Rep_ReusePrevious to the last repetition seen.
+
+Repetition*
+OasisReader::reuseRepetition (Repetition* rep)
+{
+    if (rep->getType() == Rep_ReusePrevious)
     {
 #ifdef DEBUGINFO
       printf("Warning: reuse previous repetitioin type!\n");
 #endif
       assert(m_rep != Null);
-      repType = m_rep->getType();
       rep = m_rep;
     }
     else
     {
       m_rep = rep;
     }
-    assert(repType != Rep_ReusePrevious);
-    int MoveX = 0, MoveY = 0;
+    assert(rep->getType() != Rep_ReusePrevious);
+    return rep;
+}
 
+// repetitionMoves -- offsets of all the instances of a repetition.
+// The grid of the Grid* types is taken as 1.
+
+void
+OasisReader::repetitionMoves (const Repetition* rep, vector<FPM::FPMPoint>& moves)
+{
+    RepetitionType  repType = rep->getType();
+    int MoveX = 0, MoveY = 0;
+    FPM::FPMPoint move;
+    moves.clear();
+    
     switch (repType) {
         // repetition type = Matrix (1)
         //     xdimen = AAA, ydimen = BBB, xspace = CCC, yspace = DDD
@@ -454,31 +399,23 @@ OasisReader::beginPolygon (Ulong layer, Ulong datatype,
               for (int j = 0; j < rep->getMatrixYdimen(); ++ j)
               {
                 MoveY = j * rep->getMatrixYspace();
-                FPM::FPMPoly p2 = p;
-                for (int k = 0; k < p2.ptlist.size(); ++ k)
-                {
-                	p2.ptlist[k].x = p2.ptlist[k].x + MoveX;
-                	p2.ptlist[k].y = p2.ptlist[k].y + MoveY;
-                }
-                m_layout.addPoly(p2);
+                move.x = MoveX;
+                move.y = MoveY;
+                moves.push_back(move);
               }
             }
           }
           break;
-
+        
         // repetition type = UniformX (2)
         //     dimen = AAA, xspace = BBB
         case Rep_UniformX:
           {
             for (int i = 0; i < rep->getDimen(); ++ i)
             {
-              MoveX = i * rep->getUniformXspace();
-              FPM::FPMPoly p2 = p;
-              for (int k = 0; k < p2.ptlist.size(); ++ k)
-              {
-              	p2.ptlist[k].x = p2.ptlist[k].x + MoveX;
-              }
-              m_layout.addPoly(p2);
+              move.x = i * rep->getUniformXspace();
+              move.y = 0;
+              moves.push_back(move);
             }
           }
           break;
@@ -487,13 +424,9 @@ OasisReader::beginPolygon (Ulong layer, Ulong datatype,
           {
             for (int j = 0; j < rep->getDimen(); ++ j)
             {
-              MoveY = j * rep->getUniformYspace();
-              FPM::FPMPoly p2 = p;
-              for (int k = 0; k < p2.ptlist.size(); ++ k)
-              {
-              	p2.ptlist[k].y = p2.ptlist[k].y + MoveY;
-              }
-              m_layout.addPoly(p2);
+              move.x = 0;
+              move.y = j * rep->getUniformYspace();
+              moves.push_back(move);
             }
           }
           break;
@@ -514,18 +447,12 @@ OasisReader::beginPolygon (Ulong layer, Ulong datatype,
             Ulong  dimen = rep->getDimen();
             int grid = 1;
 //            if (repType == Rep_GridVaryingX)
-//                grid = rep->getGrid();
+//              grid = rep->getGrid();
             assert(rep->getVaryingXoffset(0) == 0);
-            MoveX = 0;
-            for (Ulong j = 0;  j < dimen; ++ j) 
-            {
-              MoveX = grid * rep->getVaryingXoffset(j);
-              FPM::FPMPoly p2 = p;
-              for (int k = 0;k < p2.ptlist.size(); ++ k)
-              {
-              	p2.ptlist[k].x += MoveX;
-              }
-              m_layout.addPoly(p2);
+            for (Ulong j = 0;  j < dimen;  ++j) {
+              move.x = grid * rep->getVaryingXoffset(j);
+              move.y = 0;
+              moves.push_back(move);
             }
             break;
         }
@@ -541,16 +468,10 @@ OasisReader::beginPolygon (Ulong layer, Ulong datatype,
 //            if (repType == Rep_GridVaryingY)
 //                grid = rep->getGrid();
             assert(rep->getVaryingYoffset(0) == 0);
-            MoveY = 0;
-            for (Ulong j = 0;  j < dimen; ++ j)
-            {
-              MoveY = grid * rep->getVaryingYoffset(j);
-              FPM::FPMPoly p2 = p;
-              for (int k = 0;k < p2.ptlist.size(); ++ k)
-              {
-              	p2.ptlist[k].y += MoveY;
-              }
-              m_layout.addPoly(p2);
+            for (Ulong j = 0;  j < dimen; ++j) {
+              move.x = 0;
+              move.y = grid * rep->getVaryingYoffset(j);
+              moves.push_back(move);
             }
             break;
         }
@@ -565,15 +486,9 @@ OasisReader::beginPolygon (Ulong layer, Ulong datatype,
             {
               for (int j = 0; j < rep->getMatrixMdimen(); ++ j)
               {
-                MoveX = i * ndelta.x + j * mdelta.x;
-                MoveY = i * ndelta.y + j * mdelta.y;
-                FPM::FPMPoly p2 = p;
-                for (int k = 0; k < p2.ptlist.size(); ++ k)
-                {
-                	p2.ptlist[k].x += MoveX;
-                	p2.ptlist[k].y += MoveY;
-                }
-                m_layout.addPoly(p2);
+                move.x = i * ndelta.x + j * mdelta.x;
+                move.y = i * ndelta.y + j * mdelta.y;
+                moves.push_back(move);
               }
             }
             break;
@@ -583,47 +498,52 @@ OasisReader::beginPolygon (Ulong layer, Ulong datatype,
             Delta  delta = rep->getDiagonalDelta();
             for (int i = 0; i < rep->getDimen(); ++ i)
             {
-              MoveX = i * delta.x;
-              MoveY = i * delta.y;
-              FPM::FPMPoly p2 = p;
-              for (int k = 0; k < p2.ptlist.size(); ++ k)
-              {
-              	p2.ptlist[k].x += MoveX;
-              	p2.ptlist[k].y += MoveY;
-              }
-              m_layout.addPoly(p2);
-            }            
+              move.x = i * delta.x;
+              move.y = i * delta.y;
+              moves.push_back(move);
+            }
             break;
         }
-
+        
         case Rep_Arbitrary: //(10)
         case Rep_GridArbitrary: { //(11)
-//#ifdef DEBUGINFO
-//            printf("Warning: Repetition type Rep_Arbitrary or Rep_GridArbitrary!\n");
-//#endif
             Ulong  dimen = rep->getDimen();
             int grid = 1;
-//            if (repType == Rep_GridArbitrary)
+            //////////////NOTE: grid is set to 1
+//            if (repType == Rep_GridArbitrary) 
 //                grid = rep->getGrid();
-            MoveX = MoveY = 0;
             assert(rep->getDelta(0).x == 0 && rep->getDelta(0).y == 0);
             for (Ulong j = 0;  j < dimen;  ++j) {
               Delta  delta = rep->getDelta(j);
-              MoveX = grid * delta.x;
-              MoveY = grid * delta.y;
-              FPM::FPMPoly p2 = p;
-              for (int k = 0; k < p2.ptlist.size(); ++ k)
-              {
-              	p2.ptlist[k].x += MoveX;
-              	p2.ptlist[k].y += MoveY;
-              }
-              m_layout.addPoly(p2);
+              move.x = grid * delta.x;
+              move.y = grid * delta.y;
+              moves.push_back(move);
             }
             break;
         }
     }
-    
-    printRepetition(rep);
+}
+
+// addPolys -- add the polygon in m_points once, or at each offset in moves.
+// The vertices are written straight into the layout's polygon.
+
+void
+OasisReader::addPolys (Ulong layer, const vector<FPM::FPMPoint>* moves)
+{
+    int num = (moves == Null) ? 1 : moves->size();
+    for (int j = 0; j < num; ++ j)
+    {
+      int MoveX = (moves == Null) ? 0 : (*moves)[j].x;
+      int MoveY = (moves == Null) ? 0 : (*moves)[j].y;
+      FPM::FPMPoly &p = m_layout.newPoly(layer);
+      p.ptlist.resize(m_points.size());
+      for (int k = 0; k < m_points.size(); ++ k)
+      {
+      	p.ptlist[k].x = m_points[k].x + MoveX;
+      	p.ptlist[k].y = m_points[k].y + MoveY;
+      }
+      m_layout.checkNewPoly();
+    }
 }
 
 /*virtual*/ void
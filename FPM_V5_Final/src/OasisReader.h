@@ -18,6 +18,10 @@ class OasisReader : public OasisBuilder {
     char        printBuf[256];  // for printable versions of [ab]-strings
     FPM::FPMLayout   &m_layout;
     Repetition   *m_rep;
+    std::vector<FPM::FPMPoint>   m_moves;   // offsets of the last repetition
+    std::vector<FPM::FPMPoint>   m_points;  // vertices of the current polygon
+    int          m_firstRect;   // shapes the layout had before the parse
+    int          m_firstPoly;
     
 public:
     OasisReader (FILE* fp, FPM::FPMLayout &layout);
@@ -81,6 +85,9 @@ public:
     // virtual void  endElement();
     //     Inherit empty implementation from OasisBuilder
 
+    virtual bool  wantBatches();
+    virtual void  addElements (const ElementBatch& batch);
+
     virtual void  addFileProperty (Property* prop);
     virtual void  addCellProperty (Property* prop);
     virtual void  addElementProperty (Property* prop);
@@ -93,6 +100,11 @@ public:
     virtual void  registerXName      (XName*      xname);
 
 private:
+    Repetition* reuseRepetition (Repetition* rep);
+    void        repetitionMoves (const Repetition* rep,
+                                 std::vector<FPM::FPMPoint>& moves);
+    void        addPolys (Ulong layer,
+                          const std::vector<FPM::FPMPoint>* moves);
     void        printName (const char* nameType, OasisName* oname);
     void        printProperty (Uint indentLevel, const Property* prop);
     void        printPropValue (Uint indentLevel, const PropValue* propval);
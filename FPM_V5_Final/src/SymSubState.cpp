@@ -0,0 +1,141 @@
+#include "SymSubState.h"
+#include "vf2_state.h"
+#include "match.h"
+
+using namespace std;
+
+struct AutList
+{
+  int max_aut;
+  vector< vector<node_id> > perms;
+};
+
+static bool aut_visitor(int n, node_id ni1[], node_id ni2[], void *user_data)
+{
+  AutList *auts=(AutList *)user_data;
+  vector<node_id> perm(n);
+  for(int i=0;i<n;i++)
+    perm[ni1[i]]=ni2[i];
+  auts->perms.push_back(perm);
+  return auts->perms.size()>auts->max_aut;
+}
+
+void toGetSymBreak(ARGraph_impl *g, int max_aut, SymBreak &sym)
+{
+  int n=g->NodeCount();
+  sym.aut_num=0;
+  sym.base.clear();
+  sym.after.clear();
+
+  //the base order is the order VF2 maps g1, which depends on g1 only
+  vector<node_id> base(n,NULL_NODE);
+  node_id *c1=new node_id[n];
+  node_id *c2=new node_id[n];
+  int num;
+  SymSubState s0(g,g,NULL,&base);
+  bool found=match(&s0,&num,c1,c2);
+  delete [] c1;
+  delete [] c2;
+  if(!found)
+    return;
+  sym.base=base;
+  sym.after.resize(n);
+
+  AutList auts;
+  auts.max_aut=max_aut;
+  VF2State a0(g,g);
+  match(&a0,aut_visitor,&auts);
+  if(auts.perms.size()<2||auts.perms.size()>max_aut)
+    return;
+
+  sym.aut_num=auts.perms.size();
+  //walk down the stabilizer chain along the base
+  vector<bool> alive(auts.perms.size(),true);
+  for(int i=0;i<n;i++)
+  {
+    node_id u=base[i];
+    vector<bool> in_orbit(n,false);
+    for(int k=0;k<auts.perms.size();k++)
+    {
+      if(alive[k])
+        in_orbit[auts.perms[k][u]]=true;
+    }
+    for(int v=0;v<n;v++)
+    {
+      if(in_orbit[v]&&v!=u)
+        sym.after[v].push_back(u);
+    }
+    for(int k=0;k<auts.perms.size();k++)
+    {
+      if(auts.perms[k][u]!=u)
+        alive[k]=false;
+    }
+  }
+}
+
+SymSubState::SymSubState(ARGraph_impl *g1, ARGraph_impl *g2, const SymBreak *s, vector<node_id> *base_log)
+  : VF2SubState(g1,g2)
+{
+  sym=s;
+  log=base_log;
+  added=NULL_NODE;
+  owner=true;
+  int n=g1->NodeCount();
+  map=new node_id[n];
+  for(int i=0;i<n;i++)
+    map[i]=NULL_NODE;
+}
+
+SymSubState::SymSubState(const SymSubState &state)
+  : VF2SubState(state)
+{
+  sym=state.sym;
+  log=state.log;
+  map=state.map;
+  added=NULL_NODE;
+  owner=false;
+}
+
+SymSubState::~SymSubState()
+{
+  if(owner)
+    delete [] map;
+}
+
+bool SymSubState::IsFeasiblePair(node_id n1, node_id n2)
+{
+  if(sym!=NULL)
+  {
+    const vector<node_id> &after=sym->after[n1];
+    for(int i=0;i<after.size();i++)
+    {
+      if(map[after[i]]!=NULL_NODE&&n2<map[after[i]])
+        return false;
+    }
+  }
+  return VF2SubState::IsFeasiblePair(n1,n2);
+}
+
+void SymSubState::AddPair(node_id n1, node_id n2)
+{
+  VF2SubState::AddPair(n1,n2);
+  map[n1]=n2;
+  added=n1;
+  if(log!=NULL)
+    (*log)[CoreLen()-1]=n1;
+}
+
+State *SymSubState::Clone()
+{
+  return new SymSubState(*this);
+}
+
+void SymSubState::BackTrack()
+{
+  VF2SubState::BackTrack();
+  if(added!=NULL_NODE)
+  {
+    map[added]=NULL_NODE;
+    added=NULL_NODE;
+  }
+}
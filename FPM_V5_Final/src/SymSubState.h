@@ -0,0 +1,47 @@
+#ifndef SYMSUBSTATE_H
+#define SYMSUBSTATE_H
+
+#include <vector>
+#include "argraph.h"
+#include "vf2_sub_state.h"
+
+//symmetry breaking data of a block graph
+//base:  order in which VF2 maps the block nodes
+//after: after[v] lists the base nodes u that v must be mapped behind, i.e.
+//       v is in the orbit of u under the automorphisms fixing all earlier base nodes
+struct SymBreak
+{
+  int aut_num;
+  std::vector<node_id> base;
+  std::vector< std::vector<node_id> > after;
+};
+
+//compute the base order, the automorphisms of g (edge weights compared with the
+//comparator of g) and the orbit constraints, no constraints are set if there
+//are more than max_aut automorphisms
+void toGetSymBreak(ARGraph_impl *g, int max_aut, SymBreak &sym);
+
+//VF2SubState reporting only one mapping per automorphism class of g1: the one
+//which maps every base node to a smaller target id than the rest of its orbit.
+//Since VF2 maps g1 in base order and tries targets in increasing id, this is the
+//mapping of the class which would have been found first anyway.
+class SymSubState: public VF2SubState
+{
+  private:
+    const SymBreak *sym;
+    node_id *map;//shared by all clones, like the core sets of VF2SubState
+    node_id added;
+    bool owner;
+    std::vector<node_id> *log;
+
+  public:
+    SymSubState(ARGraph_impl *g1, ARGraph_impl *g2, const SymBreak *s, std::vector<node_id> *base_log=NULL);
+    SymSubState(const SymSubState &state);
+    ~SymSubState();
+    bool IsFeasiblePair(node_id n1, node_id n2);
+    void AddPair(node_id n1, node_id n2);
+    State *Clone();
+    virtual void BackTrack();
+};
+
+#endif
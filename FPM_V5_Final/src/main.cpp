@@ -1,11 +1,16 @@
 #include <string>
 #include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
 #include <iostream>
 #include <time.h>
 #include "DataReader.h"
 #include "FPMLayout.h"
 #include "FPMPattern.h"
 #include "FPMTempEdge.h"
+#include "FPMMemory.h"
+#include "FPMReplay.h"
 #include "Plot.h"
 //#include "FPMGraph.h"
 using namespace FPM;
@@ -21,6 +26,17 @@ int WIDTH_DIFF;
 int HEIGHT_DIFF;
 int GRAPH_EDGE_DIFF;
 int POLY_EDGE_DIFF;
+int CLUSTER_DIFF;
+const char *EMIT_FILE = NULL;
+const char *PLUGIN_FILE = NULL;
+int ANCHOR_MODE = 0;
+int GRAPH_THREADS = 0;
+int MATCH_THREADS = 0;
+int QUEUE_SIZE = 64;
+std::vector<int> TARGET_LAYERS(1, FPM_DEFAULT_LAYER);
+const char *CHECKPOINT_FILE = NULL;
+int RESUME_MODE = 0;
+double CAPTURE_MS = 0;
 
 int main(int argc, char **argv)
 {
@@ -33,6 +49,7 @@ int main(int argc, char **argv)
   HEIGHT_DIFF = 0;
   GRAPH_EDGE_DIFF = 100;
   POLY_EDGE_DIFF = 150;
+  CLUSTER_DIFF = 50;
 
   string inFileName = "",trainingFile = "",outputFileName = "MatchResult.txt";
   bool testFlag = true;
@@ -42,6 +59,10 @@ int main(int argc, char **argv)
     cout << "help:-txt trainingFileName" << endl;	
     cout << "help:-out outputFileName" << endl;
     cout << "help:[-train]" << endl;
+    cout << "help:[-emit matchers.cpp] [-plugin matchers.so] [-anchor]" << endl;
+    cout << "help:[-match_threads n] [-graph_threads n] [-queue size]" << endl;
+    cout << "help:[-layers 10,11,...] [-checkpoint file] [-resume]" << endl;
+    cout << "help:[-capture ms] [-replay fpm_replay_0.txt]" << endl;
     cout << "Example:fpm2.exe -in MX_BenchMark1.oas -txt1 training1.txt -txt2 training2.txt -out MatchResult.txt -train " << endl;
     return 0;
   }
@@ -71,6 +92,88 @@ int main(int argc, char **argv)
       cout<<"POLY_EDGE_DIFF: "<<POLY_EDGE_DIFF<<endl;
     }
 
+    if (strcmp(argv[i], "-cluster") == 0)
+    {
+      CLUSTER_DIFF = atoi(argv[++i]);
+      cout<<"CLUSTER_DIFF: "<<CLUSTER_DIFF<<endl;
+    }
+
+    //write specialized block matchers / use a plugin built from them
+    if (strcmp(argv[i], "-emit") == 0)
+    {
+      EMIT_FILE = argv[++i];
+    }
+    if (strcmp(argv[i], "-plugin") == 0)
+    {
+      PLUGIN_FILE = argv[++i];
+    }
+    //match only around shapes the blocks are anchored on
+    if (strcmp(argv[i], "-anchor") == 0)
+    {
+      ANCHOR_MODE = 1;
+    }
+    //log finished windows, -resume skips the ones an earlier run logged
+    if (strcmp(argv[i], "-checkpoint") == 0)
+    {
+      CHECKPOINT_FILE = argv[++i];
+    }
+    if (strcmp(argv[i], "-resume") == 0)
+    {
+      RESUME_MODE = 1;
+    }
+    //dump VF2 calls slower than ms / rerun one dumped call and exit
+    if (strcmp(argv[i], "-capture") == 0)
+    {
+      CAPTURE_MS = atof(argv[++i]);
+    }
+    if (strcmp(argv[i], "-replay") == 0)
+    {
+      return replayMatch(argv[++i]) == 0 ? 0 : -1;
+    }
+    //pipelined window matching, 0 match threads matches window by window
+    if (strcmp(argv[i], "-match_threads") == 0)
+    {
+      MATCH_THREADS = atoi(argv[++i]);
+      cout<<"MATCH_THREADS: "<<MATCH_THREADS<<endl;
+    }
+    if (strcmp(argv[i], "-graph_threads") == 0)
+    {
+      GRAPH_THREADS = atoi(argv[++i]);
+      cout<<"GRAPH_THREADS: "<<GRAPH_THREADS<<endl;
+    }
+    if (strcmp(argv[i], "-queue") == 0)
+    {
+      QUEUE_SIZE = atoi(argv[++i]);
+      cout<<"QUEUE_SIZE: "<<QUEUE_SIZE<<endl;
+    }
+    //target layers matched in one pass, each by its own library
+    if (strcmp(argv[i], "-layers") == 0)
+    {
+      TARGET_LAYERS.clear();
+      char *list = argv[++i];
+      for (char *p = strtok(list, ","); p != NULL; p = strtok(NULL, ","))
+      {
+        char *end;
+        long layer = strtol(p, &end, 10);
+        if (*end != '\0' || layer < 0 || layer > INT_MAX)
+        {
+          cerr << "Error in arguments:bad layer \"" << p << "\" in -layers" << endl;
+          cerr << "usage:-layers n[,n...]" << endl;
+          exit(-1);
+        }
+        if (find(TARGET_LAYERS.begin(), TARGET_LAYERS.end(), (int)layer) != TARGET_LAYERS.end())
+        {
+          cerr << "Error in arguments:layer " << layer << " given twice in -layers" << endl;
+          cerr << "usage:-layers n[,n...]" << endl;
+          exit(-1);
+        }
+        TARGET_LAYERS.push_back((int)layer);
+      }
+      if (TARGET_LAYERS.empty())
+        TARGET_LAYERS.push_back(FPM_DEFAULT_LAYER);
+      cout<<"TARGET_LAYERS: "<<TARGET_LAYERS.size()<<endl;
+    }
+
     if (strcmp(argv[i], "-out") == 0)
     {
     	outputFileName = argv[++i];
@@ -99,6 +202,16 @@ int main(int argc, char **argv)
   	cerr << "usage:-txt trainingFileName" << endl;
   	exit(-1);
   }
+  if (RESUME_MODE && CHECKPOINT_FILE == NULL) {
+  	cerr << "Error in arguments:-resume needs a checkpoint file" << endl;
+  	cerr << "usage:-checkpoint file -resume" << endl;
+  	exit(-1);
+  }
+  if (TARGET_LAYERS.size() > 1 && (EMIT_FILE != NULL || PLUGIN_FILE != NULL)) {
+  	cerr << "Error in arguments:-emit and -plugin need a single target layer" << endl;
+  	cerr << "usage:-layers n -emit matchers.cpp" << endl;
+  	exit(-1);
+  }
 
   
 //  FPMLayout fl;
@@ -128,6 +241,7 @@ int main(int argc, char **argv)
 
   for(int k=0;k<trainingSet.size();k++)
   {
+     FPMMemScope mem(FPM_MEM_READ);
      cout<<trainingSet[k]<<endl;
      tempLayout.clear();
      DataReader::ReadOASIS(trainingSet[k],tempLayout);
@@ -145,15 +259,21 @@ int main(int argc, char **argv)
   
   FPMLayout testlayout;
   testlayout.setOutputFileName(outputFileName);
+  testlayout.setInputFileName(inFileName);
   
   testlayout.clear();
-  DataReader::ReadOASIS(inFileName, testlayout);
+  {
+    FPMMemScope mem(FPM_MEM_READ);
+    DataReader::ReadOASIS(inFileName, testlayout);
+  }
+  printMemStat("after reading");
   
   //construct pattern vector
   std::vector<FPMPattern> record_patterns;
   std::vector<FPMPattern> good_patterns;
   for(int i = 0;i < layoutVector.size();++i)
   {
+     FPMMemScope mem(FPM_MEM_PATTERN);
      layoutVector[i].createPatterns();
      
      printf("Layout %d: Before pattern rotation and symmetry, total %d patterns\n", i, layoutVector[i].getPatterns().size());
@@ -173,7 +293,15 @@ int main(int argc, char **argv)
   */
   
   //testlayout.createSubLayouts();
-  testlayout.createSubLayouts(testFlag);
+  //in anchor mode the windows are built by test() from the compiled library,
+  //the pipeline clips them while the first ones are already matched
+  {
+    FPMMemScope mem(FPM_MEM_CLIP);
+    if ((ANCHOR_MODE || MATCH_THREADS > 0) && testFlag)
+      testlayout.storeCoreRects();
+    else
+      testlayout.createSubLayouts(testFlag);
+  }
   testlayout.test(record_patterns,true);
   /*
   cout<<good_patterns.size();
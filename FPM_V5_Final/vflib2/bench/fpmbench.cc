@@ -0,0 +1,436 @@
+/*-------------------------------------------------------
+ * fpmbench.cc
+ * Micro-benchmark of the matching engines.
+ *
+ * Two kinds of workloads are timed:
+ *  - FPM-like block vs window graphs. A window is a grid of
+ *    rectangles; its nodes are the rectangle sides, ring
+ *    edges of weight 0 join consecutive sides of a
+ *    rectangle, and sweep edges join each side to the
+ *    nearest facing side of the same orientation whose
+ *    projection overlaps it, weighted by their distance
+ *    (upper to lower, right to left), as FPM builds its
+ *    graphs. A block is the induced graph on the sides of
+ *    a few neighbouring rectangles, in shuffled node order,
+ *    compared with an edge weight tolerance.
+ *  - gene.cc random isomorphic pairs.
+ * For each engine it reports the time to the first match,
+ * the time to visit all the matches (at most VISIT_MAX),
+ * the number of states and the states per second.
+ *
+ * New engines are added to the engines[] table.
+ *
+ * A run stops early, marked "budget", once it created
+ * -budget states or ran for -limit seconds.
+ *
+ * Usage: fpmbench [-seed n] [-tol n] [-budget states]
+ *                 [-limit seconds] [-engine name]
+ ------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <vector>
+#include <algorithm>
+
+#include "argraph.h"
+#include "argedit.h"
+#include "gene.h"
+#include "match.h"
+#include "sd_state.h"
+#include "ull_state.h"
+#include "ull_sub_state.h"
+#include "vf_state.h"
+#include "vf_sub_state.h"
+#include "vf_mono_state.h"
+#include "vf2_state.h"
+#include "vf2_sub_state.h"
+#include "vf2_mono_state.h"
+
+using namespace std;
+
+
+/* Same cap on visited matches as the FPM visitor */
+#define VISIT_MAX   30000
+
+/* Rectangle grid of the FPM-like windows, in layout units.
+ * Sides are 60..259 long and facing sides at least
+ * MIN_SPACE apart, as in the hotspot layouts */
+#define PITCH       400
+#define MIN_SIDE    60
+#define SIDE_RANGE  200
+#define MIN_SPACE   50
+
+
+static long state_count;
+static long pair_count;
+static long state_budget=2000000;
+static double time_limit=2;
+static double deadline;
+static bool out_of_budget;
+
+
+static double wallTime()
+  { struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec*1e-6;
+  }
+
+
+/*----------------------------------------------------------
+ * class Counted<S>
+ * Wraps an engine state and counts the states it creates
+ * and the candidate pairs it checks. Once the budget is
+ * spent no pair is feasible any more, so the search
+ * unwinds.
+ ---------------------------------------------------------*/
+template <class S>
+class Counted: public S
+  { public:
+      Counted(const S &state): S(state) {}
+      bool IsFeasiblePair(node_id n1, node_id n2)
+        { pair_count++;
+          if (state_count>=state_budget || wallTime()>deadline)
+            out_of_budget=true;
+          if (out_of_budget)
+            return false;
+          return S::IsFeasiblePair(n1, n2);
+        }
+      State *Clone()
+        { state_count++;
+          return new Counted<S>(*this);
+        }
+  };
+
+
+enum { BENCH_SUB, BENCH_ISO };
+
+struct Engine
+  { const char *name;
+    int kind;     /* BENCH_ISO engines need graphs of equal size */
+    State *(*make)(Graph *g1, Graph *g2);
+  };
+
+static State *makeVF2Sub(Graph *g1, Graph *g2)
+  { return new Counted<VF2SubState>(VF2SubState(g1, g2)); }
+static State *makeVF2SubSorted(Graph *g1, Graph *g2)
+  { return new Counted<VF2SubState>(VF2SubState(g1, g2, true)); }
+static State *makeVFSub(Graph *g1, Graph *g2)
+  { return new Counted<VFSubState>(VFSubState(g1, g2)); }
+static State *makeUllSub(Graph *g1, Graph *g2)
+  { return new Counted<UllSubState>(UllSubState(g1, g2)); }
+static State *makeVF2Mono(Graph *g1, Graph *g2)
+  { return new Counted<VF2MonoState>(VF2MonoState(g1, g2)); }
+static State *makeVFMono(Graph *g1, Graph *g2)
+  { return new Counted<VFMonoState>(VFMonoState(g1, g2)); }
+static State *makeVF2(Graph *g1, Graph *g2)
+  { return new Counted<VF2State>(VF2State(g1, g2)); }
+static State *makeVF(Graph *g1, Graph *g2)
+  { return new Counted<VFState>(VFState(g1, g2)); }
+static State *makeUll(Graph *g1, Graph *g2)
+  { return new Counted<UllState>(UllState(g1, g2)); }
+static State *makeSD(Graph *g1, Graph *g2)
+  { return new Counted<SDState>(SDState(g1, g2)); }
+
+static Engine engines[]=
+  { { "vf2sub",    BENCH_SUB, makeVF2Sub },
+    { "vf2sub-s",  BENCH_SUB, makeVF2SubSorted },
+    { "vfsub",     BENCH_SUB, makeVFSub },
+    { "ullsub",    BENCH_SUB, makeUllSub },
+    { "vf2mono",   BENCH_SUB, makeVF2Mono },
+    { "vfmono",    BENCH_SUB, makeVFMono },
+    { "vf2",       BENCH_ISO, makeVF2 },
+    { "vf",        BENCH_ISO, makeVF },
+    { "ull",       BENCH_ISO, makeUll },
+    { "sd",        BENCH_ISO, makeSD },
+  };
+
+static const int engine_num=sizeof(engines)/sizeof(engines[0]);
+
+
+/*----------------------------------------------------------
+ * Edge comparator of the blocks, as FPM's EdgeComparator
+ ---------------------------------------------------------*/
+class WeightComparator: public AttrComparator
+  { public:
+      WeightComparator(int tol) { tolerance=tol; }
+      virtual bool compatible(void *pa, void *pb)
+        { return abs(*(int *)pa - *(int *)pb) <= tolerance; }
+    private:
+      int tolerance;
+  };
+
+
+/*----------------------------------------------------------
+ * Edge list of a benchmark graph. The weights are the
+ * edge attributes of the ARGraph built from it, so it must
+ * outlive that graph.
+ ---------------------------------------------------------*/
+struct EdgeList
+  { int n;
+    vector<int> from, to, weight;
+  };
+
+struct Rect
+  { int x1, y1, x2, y2; };
+
+/* A rectangle side: a horizontal one lies at c=y from lo
+ * to hi on x, a vertical one at c=x from lo to hi on y */
+struct Side
+  { bool horizontal;
+    int c, lo, hi;
+  };
+
+
+static int randRange(int n)
+  { return (int)(rand()/((double)RAND_MAX+1)*n);
+  }
+
+static void generateWindow(int rect_num, vector<Rect> &rects)
+  { int cols=(int)ceil(sqrt((double)rect_num));
+    rects.clear();
+    for(int i=0; i<rect_num; i++)
+      { int w=MIN_SIDE+randRange(SIDE_RANGE);
+        int h=MIN_SIDE+randRange(SIDE_RANGE);
+        Rect r;
+        r.x1=(i%cols)*PITCH+randRange(PITCH-w-MIN_SPACE+1);
+        r.y1=(i/cols)*PITCH+randRange(PITCH-h-MIN_SPACE+1);
+        r.x2=r.x1+w;
+        r.y2=r.y1+h;
+        rects.push_back(r);
+      }
+  }
+
+/*----------------------------------------------------------
+ * Builds the FPM-like graph of the rectangles. Sides of
+ * rectangle i are the nodes 4i..4i+3, bottom, right, top
+ * and left.
+ ---------------------------------------------------------*/
+static void buildEdges(vector<Rect> &rects, EdgeList &e)
+  { vector<Side> sides;
+    int i, j, k;
+    for(i=0; i<(int)rects.size(); i++)
+      { Rect &r=rects[i];
+        Side s[4]={ { true,  r.y1, r.x1, r.x2 },
+                    { false, r.x2, r.y1, r.y2 },
+                    { true,  r.y2, r.x1, r.x2 },
+                    { false, r.x1, r.y1, r.y2 } };
+        for(k=0; k<4; k++)
+          sides.push_back(s[k]);
+      }
+    e.n=sides.size();
+    e.from.clear();
+    e.to.clear();
+    e.weight.clear();
+
+    /* Rings */
+    for(i=0; i<e.n; i++)
+      { e.from.push_back(i);
+        e.to.push_back(i%4==3? i-3: i+1);
+        e.weight.push_back(0);
+      }
+
+    /* Sweep edges to the nearest overlapping side below
+     * (horizontal) or on the left (vertical) */
+    for(i=0; i<e.n; i++)
+      for(j=0; j<e.n; j++)
+        { Side &a=sides[i], &b=sides[j];
+          if (a.horizontal!=b.horizontal || a.c<=b.c ||
+              a.hi<=b.lo || b.hi<=a.lo)
+            continue;
+          int lo=max(a.lo, b.lo), hi=min(a.hi, b.hi);
+          bool hidden=false;
+          for(k=0; k<e.n && !hidden; k++)
+            { Side &s=sides[k];
+              hidden= s.horizontal==a.horizontal && s.c<a.c && s.c>b.c
+                      && s.lo<hi && lo<s.hi;
+            }
+          if (!hidden)
+            { e.from.push_back(i);
+              e.to.push_back(j);
+              e.weight.push_back(a.c-b.c);
+            }
+        }
+  }
+
+/*----------------------------------------------------------
+ * Extracts the induced graph on the sides of the block_num
+ * rectangles nearest to a random one, with the nodes
+ * shuffled.
+ ---------------------------------------------------------*/
+static void extractBlock(vector<Rect> &rects, EdgeList &window,
+                         int block_num, EdgeList &block)
+  { int i, seed=randRange(rects.size());
+    vector< pair<long,int> > by_dist;
+    for(i=0; i<(int)rects.size(); i++)
+      { long dx=(rects[i].x1+rects[i].x2)-(rects[seed].x1+rects[seed].x2);
+        long dy=(rects[i].y1+rects[i].y2)-(rects[seed].y1+rects[seed].y2);
+        by_dist.push_back(make_pair(dx*dx+dy*dy, i));
+      }
+    sort(by_dist.begin(), by_dist.end());
+
+    vector<int> id(window.n, -1);
+    block.n=0;
+    for(i=0; i<block_num && i<(int)by_dist.size(); i++)
+      for(int k=0; k<4; k++)
+        id[by_dist[i].second*4+k]=block.n++;
+    vector<int> shuffle(block.n);
+    for(i=0; i<block.n; i++)
+      shuffle[i]=i;
+    for(i=block.n-1; i>0; i--)
+      swap(shuffle[i], shuffle[randRange(i+1)]);
+
+    block.from.clear();
+    block.to.clear();
+    block.weight.clear();
+    for(i=0; i<(int)window.from.size(); i++)
+      if (id[window.from[i]]>=0 && id[window.to[i]]>=0)
+        { block.from.push_back(shuffle[id[window.from[i]]]);
+          block.to.push_back(shuffle[id[window.to[i]]]);
+          block.weight.push_back(window.weight[i]);
+        }
+  }
+
+/* tolerance<0 leaves the edges uncompared */
+static Graph *buildGraph(EdgeList &e, int tolerance)
+  { ARGEdit edit;
+    int i;
+    for(i=0; i<e.n; i++)
+      edit.InsertNode(NULL);
+    for(i=0; i<(int)e.from.size(); i++)
+      edit.InsertEdge(e.from[i], e.to[i], &e.weight[i]);
+    ARGraph<void,int> *g=new ARGraph<void,int>(&edit);
+    if (tolerance>=0)
+      g->SetEdgeComparator(new WeightComparator(tolerance));
+    return g;
+  }
+
+
+static bool countVisitor(int n, node_id ni1[], node_id ni2[], void *usr_data)
+  { int *count=(int *)usr_data;
+    return ++*count>=VISIT_MAX;
+  }
+
+static void runEngine(Engine &eng, const char *workload, Graph *g1, Graph *g2)
+  { int n;
+    node_id *c1=new node_id[g1->NodeCount()];
+    node_id *c2=new node_id[g1->NodeCount()];
+
+    state_count=pair_count=0;
+    out_of_budget=false;
+    double start=wallTime();
+    deadline=start+time_limit;
+    State *s0=eng.make(g1, g2);
+    bool found=match(s0, &n, c1, c2);
+    double first_ms=(wallTime()-start)*1000;
+    bool first_cut=out_of_budget;
+    delete s0;
+
+    int count=0;
+    state_count=pair_count=0;
+    out_of_budget=false;
+    start=wallTime();
+    deadline=start+time_limit;
+    s0=eng.make(g1, g2);
+    match(s0, countVisitor, &count);
+    double all_ms=(wallTime()-start)*1000;
+    delete s0;
+
+    char first[32];
+    if (found)
+      sprintf(first, "%.3f", first_ms);
+    else
+      strcpy(first, first_cut? "budget": "none");
+    printf("%-9s %-14s %5d %5d %10s %10.3f %7d %10ld %11ld %8.2f%s\n",
+           eng.name, workload, g1->NodeCount(), g2->NodeCount(),
+           first, all_ms, count, state_count, pair_count,
+           all_ms>0? state_count/all_ms/1000: 0.0,
+           out_of_budget? " budget": "");
+    delete[] c1;
+    delete[] c2;
+  }
+
+static void printHeader(const char *title)
+  { printf("\n%s\n", title);
+    printf("%-9s %-14s %5s %5s %10s %10s %7s %10s %11s %8s\n",
+           "engine", "workload", "g1", "g2", "first ms", "all ms",
+           "matches", "states", "pairs", "Mst/s");
+  }
+
+static bool selected(Engine &eng, const char *only)
+  { return only==NULL || strcmp(eng.name, only)==0;
+  }
+
+
+int main(int argc, char **argv)
+  { int seed=1, tolerance=100;
+    const char *only=NULL;
+    int i, e;
+
+    for(i=1; i<argc; i++)
+      { if (strcmp(argv[i], "-seed")==0 && i+1<argc)
+          seed=atoi(argv[++i]);
+        else if (strcmp(argv[i], "-tol")==0 && i+1<argc)
+          tolerance=atoi(argv[++i]);
+        else if (strcmp(argv[i], "-budget")==0 && i+1<argc)
+          state_budget=atol(argv[++i]);
+        else if (strcmp(argv[i], "-limit")==0 && i+1<argc)
+          time_limit=atof(argv[++i]);
+        else if (strcmp(argv[i], "-engine")==0 && i+1<argc)
+          only=argv[++i];
+        else
+          { fprintf(stderr, "usage: %s [-seed n] [-tol n] [-budget states] [-limit seconds] [-engine name]\n",
+                    argv[0]);
+            fprintf(stderr, "engines:");
+            for(e=0; e<engine_num; e++)
+              fprintf(stderr, " %s", engines[e].name);
+            fprintf(stderr, "\n");
+            return 1;
+          }
+      }
+    srand(seed);
+    printf("seed %d, edge tolerance %d, budget %ld states or %.1f s\n",
+           seed, tolerance, state_budget, time_limit);
+
+    /* FPM-like blocks against windows of increasing size */
+    static const int window_rects[]={ 16, 64, 256 };
+    static const int block_rects[]={ 2, 4, 8 };
+    printHeader("FPM block vs window");
+    for(int w=0; w<3; w++)
+      { vector<Rect> rects;
+        EdgeList window;
+        generateWindow(window_rects[w], rects);
+        buildEdges(rects, window);
+        Graph *target=buildGraph(window, -1);
+        for(int b=0; b<3; b++)
+          { EdgeList block;
+            extractBlock(rects, window, block_rects[b], block);
+            Graph *sub=buildGraph(block, tolerance);
+            char workload[32];
+            sprintf(workload, "%dr/%dr", block_rects[b], window_rects[w]);
+            for(e=0; e<engine_num; e++)
+              if (engines[e].kind==BENCH_SUB && selected(engines[e], only))
+                runEngine(engines[e], workload, sub, target);
+            delete sub;
+          }
+        delete target;
+      }
+
+    /* gene.cc random isomorphic pairs, 2 edges per node */
+    static const int gene_nodes[]={ 20, 50, 100, 200 };
+    printHeader("gene.cc isomorphic pairs");
+    for(int g=0; g<4; g++)
+      { Graph *g1, *g2;
+        Generate(gene_nodes[g], gene_nodes[g]*2, &g1, &g2);
+        char workload[32];
+        sprintf(workload, "gene%d", gene_nodes[g]);
+        for(e=0; e<engine_num; e++)
+          if (selected(engines[e], only))
+            runEngine(engines[e], workload, g1, g2);
+        delete g1;
+        delete g2;
+      }
+    return 0;
+  }